@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+"""Generates a lo script that keeps making and dropping values: long strings
+assigned over and over, arrays, and funS calls whose locals fill a fresh
+map each time, for comparing the allocators.
+
+    python3 bench/gen_alloc.py OUTDIR [--lines 200000]
+    time ./build/lomake --allocator=system OUTDIR/alloc.lo > /dev/null
+    time ./build/lomake --allocator=lo --stats OUTDIR/alloc.lo > /dev/null
+    time ./build/lomake --allocator=lo --auto-parallel --jobs 4 OUTDIR/alloc.lo > /dev/null
+"""
+import argparse
+import os
+import random
+
+
+def program(lines):
+    rnd = random.Random(7)
+    out = ["loc s = str(\"\")!", "loc n = int(0)!"]
+    out.append("funS str pad(str: w, i: k): {")
+    for i in range(12):
+        out.append("    loc f%d = str(\"field %d of a record that does not fit inline\")!" % (i, i))
+    out.append("    return w!")
+    out.append("}")
+    for i in range(lines):
+        r = rnd.random()
+        if r < 0.3:
+            out.append("s = \"%s\"!" % ("value %d " % i * rnd.randint(2, 12)))
+        elif r < 0.45:
+            out.append("loc v%d = arr(%s)!" % (i % 50, ", ".join(str(rnd.randint(0, 999)) for _ in range(8))))
+        elif r < 0.55:
+            out.append("n = %d!" % i)
+        else:
+            out.append("print-- f-pad(s, %d)!" % i)
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("outdir")
+    ap.add_argument("--lines", type=int, default=200000)
+    args = ap.parse_args()
+
+    os.makedirs(args.outdir, exist_ok=True)
+    with open(os.path.join(args.outdir, "alloc.lo"), "w") as f:
+        f.write("\n".join(program(args.lines)) + "\n")
+
+
+if __name__ == "__main__":
+    main()
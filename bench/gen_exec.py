@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Generates call-heavy and arithmetic-heavy lo scripts for comparing the
+execution engines.
+
+    python3 bench/gen_exec.py OUTDIR [--lines 1000000]
+    time ./build/lomake OUTDIR/calls.lo > /dev/null
+    time ./build/lomake --engine=closure OUTDIR/calls.lo > /dev/null
+    time ./build/lomake OUTDIR/arith.lo > /dev/null
+    time ./build/lomake --engine=closure OUTDIR/arith.lo > /dev/null
+
+--stats also reports the size of the compiled code, the allocations it took
+and the peak memory of the process:
+
+    ./build/lomake --stats OUTDIR/calls.lo > /dev/null
+"""
+import argparse
+import os
+import random
+
+
+def calls(lines):
+    out = [
+        "loc x = int(20)!",
+        "loc y = int(22)!",
+        "funS i add(i: a, i: b): {",
+        "    loc t = int(2 * 3)!",
+        "    return a + b!",
+        "}",
+        "funS i same(i: a): {",
+        "    return a!",
+        "}",
+    ]
+    for i in range(lines):
+        out.append("print-- f-add(x, y)!" if i % 3 else "print-- f-same(y)!")
+    return out
+
+
+def arith(lines, rng):
+    out = ["loc x = int(0)!", "loc y = int(1)!", "loc s = str(\"a\")!"]
+    while len(out) < lines:
+        r = rng.random()
+        if r < 0.4:
+            out.append("x = %d %s %d!" % (rng.randint(0, 999), rng.choice("+-*/%"), rng.randint(1, 99)))
+        elif r < 0.6:
+            out.append("loc v%d = int(%d * %d)!" % (len(out), rng.randint(0, 999), rng.randint(0, 999)))
+        elif r < 0.9:
+            out.append("if- x >> y the")
+            out.append("    y = %d!" % rng.randint(0, 999))
+            out.append("elif- x === %d the" % rng.randint(0, 99))
+            out.append("    s = \"b\"!")
+            out.append("end--")
+        else:
+            out.append("print-- x!")
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("outdir")
+    ap.add_argument("--lines", type=int, default=1000000)
+    args = ap.parse_args()
+
+    os.makedirs(args.outdir, exist_ok=True)
+    rng = random.Random(1)
+    for name, lines in (("calls.lo", calls(args.lines)), ("arith.lo", arith(args.lines, rng))):
+        with open(os.path.join(args.outdir, name), "w") as f:
+            f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
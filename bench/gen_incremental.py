@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+"""Generates a lo script with one parameter that only part of the program
+depends on, for timing --incremental reruns after a --set change.
+
+    python3 bench/gen_incremental.py OUTDIR [--lines 200000] [--dependent 0.1]
+    time ./build/lomake --set p=1 OUTDIR/params.lo > /dev/null
+    ./build/lomake --set p=1 --incremental OUTDIR/params.cache OUTDIR/params.lo > /dev/null
+    time ./build/lomake --set p=2 --incremental OUTDIR/params.cache OUTDIR/params.lo > /dev/null
+
+--stats reports how many units were replayed from the cache.
+"""
+import argparse
+import os
+import random
+
+
+def program(lines, dependent, rng):
+    out = [
+        "loc p = int(1)!",
+        "loc x = int(20)!",
+        "loc y = int(22)!",
+        "funS i add(i: a, i: b): {",
+        "    loc t = int(2 * 3)!",
+        "    return a + b!",
+        "}",
+    ]
+    while len(out) < lines:
+        if rng.random() < dependent:
+            out.append("print-- f-add(p, %d)!" % rng.randint(0, 999))
+        else:
+            out.append("print-- f-add(x, y)!")
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("outdir")
+    ap.add_argument("--lines", type=int, default=200000)
+    ap.add_argument("--dependent", type=float, default=0.1)
+    args = ap.parse_args()
+
+    os.makedirs(args.outdir, exist_ok=True)
+    with open(os.path.join(args.outdir, "params.lo"), "w") as f:
+        f.write("\n".join(program(args.lines, args.dependent, random.Random(1))) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""Generates a long lo script that reads a line of input per statement and
+prints some of them back, and the input to feed it, for timing --read-ahead
+against blocking reads. Both the loader and input-- read ahead; drop the
+page cache first (echo 3 > /proc/sys/vm/drop_caches) to time cold reads.
+
+    python3 bench/gen_input.py OUTDIR [--lines 200000] [--width 200]
+    time ./build/lomake OUTDIR/input.lo < OUTDIR/input.txt > /dev/null
+    time ./build/lomake --read-ahead=uring --stats OUTDIR/input.lo < OUTDIR/input.txt > /dev/null
+    time cat OUTDIR/input.txt | ./build/lomake --read-ahead=thread OUTDIR/input.lo > /dev/null
+"""
+import argparse
+import os
+import random
+
+
+def program(lines):
+    rnd = random.Random(3)
+    out = ["loc s = str(\"\")!", "loc n = int(0)!"]
+    for i in range(lines):
+        if rnd.random() < 0.8:
+            out.append("s = input-- str- \"\"!")
+        else:
+            out.append("n = input-- i- \"\"!")
+        if i % 100 == 0:
+            out.append("print-- s!")
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("outdir")
+    ap.add_argument("--lines", type=int, default=200000)
+    ap.add_argument("--width", type=int, default=200)
+    args = ap.parse_args()
+
+    os.makedirs(args.outdir, exist_ok=True)
+    script = program(args.lines)
+    with open(os.path.join(args.outdir, "input.lo"), "w") as f:
+        f.write("\n".join(script) + "\n")
+    rnd = random.Random(4)
+    with open(os.path.join(args.outdir, "input.txt"), "w") as f:
+        for line in script:
+            if "input-- i-" in line:
+                f.write("%d\n" % rnd.randint(0, 10 ** 9))
+            elif "input--" in line:
+                f.write(("word%d " % rnd.randint(0, 999)) * (args.width // 8) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+"""Generates a lo script whose run time goes into funS calls, for --memo.
+Every call site passes the input and a different literal, so a run computes
+each result once and a second run with the same input finds them all.
+
+    python3 bench/gen_memo.py OUTDIR [--calls 5000] [--body 40]
+    time ./build/lomake OUTDIR/memo.lo < OUTDIR/input.txt > /dev/null
+    ./build/lomake --memo OUTDIR/lo.memo OUTDIR/memo.lo < OUTDIR/input.txt > /dev/null
+    time ./build/lomake --memo OUTDIR/lo.memo --stats OUTDIR/memo.lo < OUTDIR/input.txt > /dev/null
+
+Several lomake processes may share OUTDIR/lo.memo at the same time.
+"""
+import argparse
+import os
+
+
+def program(calls, body):
+    out = [
+        "loc x = int(0)!",
+        "x = input-- i- \"\"!",
+        "funS i work(i: p, i: q): {",
+    ]
+    for i in range(body):
+        out.append("    loc t%d = int(%d)!" % (i, i))
+    out.append("    return p * q!")
+    out.append("}")
+    for c in range(calls):
+        out.append("print-- f-work(x, %d)!" % c)
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("outdir")
+    ap.add_argument("--calls", type=int, default=5000)
+    ap.add_argument("--body", type=int, default=40)
+    args = ap.parse_args()
+
+    os.makedirs(args.outdir, exist_ok=True)
+    with open(os.path.join(args.outdir, "memo.lo"), "w") as f:
+        f.write("\n".join(program(args.calls, args.body)) + "\n")
+    with open(os.path.join(args.outdir, "input.txt"), "w") as f:
+        f.write("12\n")
+
+
+if __name__ == "__main__":
+    main()
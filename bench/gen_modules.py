@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+"""Generates a synthetic multi-module lo program for compile-time benchmarks.
+
+    python3 bench/gen_modules.py OUTDIR [--files 500] [--lines 1000000]
+    time ./build/lomake --jobs 1 OUTDIR/main.lo
+    time ./build/lomake OUTDIR/main.lo
+"""
+import argparse
+import os
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("outdir")
+    ap.add_argument("--files", type=int, default=500)
+    ap.add_argument("--lines", type=int, default=1000000)
+    args = ap.parse_args()
+
+    os.makedirs(args.outdir, exist_ok=True)
+    per_file = args.lines // args.files
+    funcs_per_file = max(1, per_file // 4)  # header, loc, return, closing brace
+
+    with open(os.path.join(args.outdir, "main.lo"), "w") as main_lo:
+        for f in range(args.files):
+            name = "mod%03d.lo" % f
+            with open(os.path.join(args.outdir, name), "w") as mod:
+                for i in range(funcs_per_file):
+                    mod.write("funS i m%d_f%d(i: a, i: b): {\n" % (f, i))
+                    mod.write("    loc t = int(%d * 2)!\n" % i)
+                    mod.write("    return a + b!\n")
+                    mod.write("}\n")
+            main_lo.write('import "%s"!\n' % name)
+        main_lo.write("loc x = int(20)!\n")
+        main_lo.write("loc y = int(22)!\n")
+        for f in range(0, args.files, max(1, args.files // 10)):
+            main_lo.write("print-- f-m%d_f0(x, y)!\n" % f)
+
+
+if __name__ == "__main__":
+    main()
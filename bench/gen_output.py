@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+"""Generates a lo script that mostly prints: literals, variables and funS
+results, with a little arithmetic in between, for timing --async-output
+against a slow reader and --output=jsonl|binary against text.
+
+    python3 bench/gen_output.py OUTDIR [--lines 200000]
+    time ./build/lomake OUTDIR/output.lo | (sleep 1; cat) > /dev/null
+    time ./build/lomake --async-output --stats OUTDIR/output.lo | (sleep 1; cat) > /dev/null
+    time ./build/lomake --output=binary --stats OUTDIR/output.lo > /dev/null
+"""
+import argparse
+import os
+import random
+
+
+def program(lines):
+    rnd = random.Random(5)
+    out = ["loc n = int(0)!", "loc s = str(\"a line of output\")!"]
+    out.append("funS i twice(i: k): {")
+    out.append("    return k * 2!")
+    out.append("}")
+    for i in range(lines):
+        r = rnd.random()
+        if r < 0.3:
+            out.append("print-- \"line %d of the report\"!" % i)
+        elif r < 0.5:
+            out.append("print-- s!")
+        elif r < 0.7:
+            out.append("print-- f-twice(%d)!" % i)
+        elif r < 0.9:
+            out.append("n = n + %d!" % rnd.randint(1, 9))
+        else:
+            out.append("print-- n!")
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("outdir")
+    ap.add_argument("--lines", type=int, default=200000)
+    args = ap.parse_args()
+
+    os.makedirs(args.outdir, exist_ok=True)
+    with open(os.path.join(args.outdir, "output.lo"), "w") as f:
+        f.write("\n".join(program(args.lines)) + "\n")
+
+
+if __name__ == "__main__":
+    main()
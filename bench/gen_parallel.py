@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+"""Generates a lo script that is a long list of independent funS calls, with
+a variable update every few calls, for --auto-parallel.
+
+    python3 bench/gen_parallel.py OUTDIR [--calls 20000] [--body 40]
+    time ./build/lomake OUTDIR/parallel.lo > /dev/null
+    time ./build/lomake --auto-parallel --stats OUTDIR/parallel.lo > /dev/null
+
+Both runs print the same; --stats shows how many calls ran on the pool and
+the parallelism reached.
+"""
+import argparse
+import os
+
+
+def program(calls, body):
+    out = ["loc x = int(1)!", "loc y = int(2)!"]
+    for name, op in (("mul", "*"), ("add", "+"), ("sub", "-")):
+        out.append("funS i %s(i: p, i: q): {" % name)
+        for i in range(body):
+            out.append("    loc t%d = int(%d)!" % (i, i))
+        out.append("    return p %s q!" % op)
+        out.append("}")
+    for c in range(calls):
+        if c % 10 == 9:
+            out.append("x = %d!" % c)
+        out.append("print-- f-%s(%s, %d)!" % (("mul", "add", "sub")[c % 3], "xy"[c % 2], c))
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("outdir")
+    ap.add_argument("--calls", type=int, default=20000)
+    ap.add_argument("--body", type=int, default=40)
+    args = ap.parse_args()
+
+    os.makedirs(args.outdir, exist_ok=True)
+    with open(os.path.join(args.outdir, "parallel.lo"), "w") as f:
+        f.write("\n".join(program(args.calls, args.body)) + "\n")
+
+
+if __name__ == "__main__":
+    main()
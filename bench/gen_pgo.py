@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+"""Generates a branch-heavy lo script for profile-guided optimization. Every
+if-/elif- chain tests the input against disjoint ranges, and the branch the
+input takes is the last one tested.
+
+    python3 bench/gen_pgo.py OUTDIR [--chains 20000] [--arms 8]
+    ./build/lomake --profile-out OUTDIR/pgo.prof OUTDIR/pgo.lo < OUTDIR/input.txt > /dev/null
+    time ./build/lomake --optimize OUTDIR/pgo.lo < OUTDIR/input.txt > /dev/null
+    time ./build/lomake --profile-use OUTDIR/pgo.prof OUTDIR/pgo.lo < OUTDIR/input.txt > /dev/null
+
+The profile only applies to the source it was recorded on; regenerate it
+after changing pgo.lo.
+"""
+import argparse
+import os
+
+
+def program(chains, arms):
+    hot = arms * 10  # the input, above every arm but the last
+    out = [
+        "loc x = int(0)!",
+        "loc n = int(0)!",
+        "x = input-- i- \"\"!",
+        "funS i step(i: a, i: b): {",
+        "    return a + b!",
+        "}",
+    ]
+    for c in range(chains):
+        for a in range(arms - 1):
+            out.append("%s x === %d the" % ("if-" if a == 0 else "elif-", a * 10 + c % 7))
+            out.append("    n = %d!" % a)
+        out.append("elif- x >> %d the" % ((arms - 1) * 10))
+        out.append("    n = %d!" % (arms - 1))
+        out.append("end--")
+        if c % 100 == 0:
+            out.append("print-- f-step(x, %d)!" % c)
+    return out, hot
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("outdir")
+    ap.add_argument("--chains", type=int, default=20000)
+    ap.add_argument("--arms", type=int, default=8)
+    args = ap.parse_args()
+
+    os.makedirs(args.outdir, exist_ok=True)
+    lines, hot = program(args.chains, args.arms)
+    with open(os.path.join(args.outdir, "pgo.lo"), "w") as f:
+        f.write("\n".join(lines) + "\n")
+    with open(os.path.join(args.outdir, "input.txt"), "w") as f:
+        f.write("%d\n" % hot)
+
+
+if __name__ == "__main__":
+    main()
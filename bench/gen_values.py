@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""Generates a lo script that hands a few long values to funS over and over
+and keeps reassigning them, so each call binds arguments and snapshots
+globals that are kilobytes long.
+
+    python3 bench/gen_values.py OUTDIR [--lines 100000] [--width 4000]
+    time ./build/lomake OUTDIR/values.lo > /dev/null
+    time ./build/lomake --auto-parallel --jobs 4 OUTDIR/values.lo > /dev/null
+"""
+import argparse
+import os
+import random
+
+
+def program(lines, width):
+    rnd = random.Random(11)
+    out = []
+    for i in range(4):
+        out.append("loc s%d = str(\"%s\")!" % (i, ("chunk %d " % i) * (width // 8)))
+    out.append("funS str first(str: a, str: b, i: k): {")
+    out.append("    loc c = str(a)!")
+    out.append("    loc d = str(b)!")
+    out.append("    return c!")
+    out.append("}")
+    out.append("funS i pick(str: a, i: k): {")
+    out.append("    return k!")
+    out.append("}")
+    for i in range(lines):
+        r = rnd.random()
+        if r < 0.05:
+            out.append("s%d = \"%s\"!" % (rnd.randrange(4), ("line %d " % i) * (width // 8)))
+        elif r < 0.15:
+            out.append("print-- f-first(s%d, s%d, %d)!" % (rnd.randrange(4), rnd.randrange(4), i))
+        else:
+            out.append("print-- f-pick(s%d, %d)!" % (rnd.randrange(4), i))
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("outdir")
+    ap.add_argument("--lines", type=int, default=100000)
+    ap.add_argument("--width", type=int, default=4000)
+    args = ap.parse_args()
+
+    os.makedirs(args.outdir, exist_ok=True)
+    with open(os.path.join(args.outdir, "values.lo"), "w") as f:
+        f.write("\n".join(program(args.lines, args.width)) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,251 +1,272 @@
 // main.cpp
+#include <charconv>
+#include <chrono>
 #include <iostream>
-#include <fstream>
-#include <sstream>
-#include <unordered_map>
+#include <limits>
+#include <memory>
+#include <set>
 #include <string>
 #include <vector>
-#include <stack>
-#include <map>
-#include <regex>
-#include "src/h/variable.h"
-#include "src/h/function.h"
-#include "src/h/utils.h"
-#include "src/h/evaluator.h"
-#include "src/h/executor.h"
+#include <sys/types.h>
+#include "src/h/closure.h"
+#include "src/h/context.h"
+#include "src/h/debugger.h"
+#include "src/h/error.h"
+#include "src/h/alloc.h"
+#include "src/h/incremental.h"
+#include "src/h/memo.h"
+#include "src/h/output.h"
+#include "src/h/parallel.h"
+#include "src/h/readahead.h"
+#include "src/h/module.h"
+#include "src/h/compiler.h"
+#include "src/h/interpreter.h"
+#include "src/h/ir.h"
+#include "src/h/lsp.h"
+#include "src/h/profile.h"
+#include "src/h/repl.h"
+#include "src/h/specialize.h"
+#include "src/h/stats.h"
+#include "src/h/threadpool.h"
 
-struct Context {
-    std::map<std::string, FunctionDef> functions;
-    std::unordered_map<std::string, Variable> variables;
-};
-
-struct IfState {
-    bool matched;
-    bool skipping; // true — we skip body
-};
-
-static std::regex locRegex(R"(^loc\s+(\w+)\s*=\s*(int|str|bool|arr)\((.*)\)\s*!$)");
-static std::regex assignRegex(R"(^(\w+)\s*=\s*(.+)\!$)");
-static std::regex inputRegex(R"(^(\w+)\s*=\s*input--\s*(i|str)-\s*\"([^\"]*)\"!$)");
-static std::regex funRegex(R"(^funS\s+(\w+)\s+(\w+)\(([^)]*)\):\s*\{$)");
-static std::regex returnRegex(R"(^return\s+(.*)!$)");
-static std::regex printRegex(R"(^print--\s*(?:(\"([^\"]*)\")|(\w+)|f-(\w+)\(([^)]*)\))!$)");
-// groups: 2 = literal text, 3 = variable, 4 = func name, 5 = func args
-
-void errorAndExit(int lineno, const std::string &msg) {
-    std::cerr << "Error at line " << lineno << ": " << msg << std::endl;
-    exit(1);
-}
-
-bool startsWith(const std::string &s, const std::string &p) {
-    return s.size() >= p.size() && s.compare(0, p.size(), p) == 0;
+static void usage() {
+    std::cerr << "Usage: lomake [--jobs N] [--engine=switch|closure] [--optimize [--specialize-budget N]] [--stats]"
+                 " [--profile-out FILE | --profile-use FILE]\n"
+                 "              [--set NAME=VALUE]... [--incremental FILE | --auto-parallel] [--memo FILE [--memo-size MB]]\n"
+                 "              [--allocator=system|lo] [--async-output] [--read-ahead=uring|thread]\n"
+                 "              [--output=text|jsonl|binary] <file.lo>\n"
+                 "       lomake [--optimize] --dump-ir <file.lo>\n"
+                 "       lomake [--jobs N] --check <file.lo>...\n"
+                 "       lomake --repl\n"
+                 "       lomake --lsp\n"
+                 "       lomake --debug <file.lo>\n";
 }
 
-void processLoc(Context &ctx, const std::smatch &m, int lineno) {
-    std::string name = m[1];
-    std::string type = m[2];
-    std::string raw = trim(m[3]);
-    if (type == "str") {
-        if (raw.size() >= 2 && raw.front() == '"' && raw.back() == '"') {
-            raw = raw.substr(1, raw.size() - 2);
-        }
-        ctx.variables[name] = {"str", raw};
-    } else if (type == "int") {
-        std::string val = evalExpression(raw); // we assume that evalExpression returns a string representation of int
-        ctx.variables[name] = {"int", val};
-    } else if (type == "bool") {
-        std::string val = trim(raw);
-        if (val == "true" || val == "1") ctx.variables[name] = {"bool", "true"};
-        else if (val == "false" || val == "0") ctx.variables[name] = {"bool", "false"};
-        else errorAndExit(lineno, "Invalid bool value: " + val);
-    } else if (type == "arr") {
-        std::string rawList = trim(raw);
-        std::vector<std::string> elements;
-        std::stringstream ss(rawList);
-        std::string item;
-        while (std::getline(ss, item, ',')) {
-            item = trim(item);
-            if (item.size() >= 2 && item.front() == '"' && item.back() == '"')
-                item = item.substr(1, item.size() - 2);
-            elements.push_back(item);
-        }
-        std::ostringstream os;
-        for (size_t i = 0; i < elements.size(); ++i) {
-            if (i) os << ",";
-            os << elements[i];
-        }
-        ctx.variables[name] = {"arr", os.str()};
-        
-    } else {
-        errorAndExit(lineno, "Unknown type for loc: " + type);
-    }
+// Parses a whole number in [min, max]; anything else is a usage error.
+static bool parseCount(const std::string &arg, unsigned long long min, unsigned long long max,
+                       unsigned long long &out) {
+    auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), out);
+    return error == std::errc() && end == arg.data() + arg.size() && out >= min && out <= max;
 }
 
-void processAssign(Context &ctx, const std::smatch &m, int lineno) {
-    std::string name = m[1];
-    if (!ctx.variables.count(name)) errorAndExit(lineno, "Undefined variable: " + name);
-    std::string rhs = trim(m[2]);
-    auto &var = ctx.variables[name];
-    if (var.type == "int") var.value = evalExpression(rhs);
-    else if (var.type == "bool") {
-        rhs = trim(rhs);
-        if (rhs == "true" || rhs == "1") var.value = "true";
-        else if (rhs == "false" || rhs == "0") var.value = "false";
-        else errorAndExit(lineno, "Invalid bool assignment: " + rhs);
-    } else {
-        if (rhs.size() >= 2 && rhs.front() == '"' && rhs.back() == '"') rhs = rhs.substr(1, rhs.size() - 2);
-        var.value = rhs;
+// Compiles and statically checks every file without running any of them.
+static int checkFiles(const std::vector<std::string> &paths, unsigned jobs) {
+    std::vector<std::vector<Diagnostic>> diagnostics;
+    loadModuleGraphs(paths, true, true, jobs, diagnostics);
+    size_t errors = 0;
+    for (const auto &fileDiags : diagnostics) {
+        for (const auto &diag : fileDiags) std::cerr << formatDiagnostic(diag, "") << std::endl;
+        errors += fileDiags.size();
     }
+    return errors ? 1 : 0;
 }
 
-void processInput(Context &ctx, const std::smatch &m, int lineno) {
-    std::string name = m[1], type = m[2], prompt = m[3];
-    std::cout << prompt;
-    std::string input;
-    std::getline(std::cin, input);
-    if (type == "i") {
-        try { std::stoll(input); ctx.variables[name] = {"int", input}; }
-        catch (...) { errorAndExit(lineno, "Invalid input for int: " + input); }
-    } else ctx.variables[name] = {"str", input};
+// Adds the code of `mod`, its functions and its imports to stats.
+static void countModules(const Module *mod, std::set<const Module *> &seen) {
+    if (!seen.insert(mod).second) return;
+    countCode(mod->code);
+    for (const auto &[name, func] : mod->functions) countCode(func.code);
+    for (const Module *dep : mod->imports) countModules(dep, seen);
 }
 
-void processPrint(Context &ctx, const std::smatch &m, int lineno) {
-    if (m[2].matched) {
-        // literal
-        std::cout << m[2].str() << std::endl;
-    } else if (m[3].matched) {
-        // variable
-        std::string var = m[3];
-        if (!ctx.variables.count(var)) { std::cerr << "Undefined variable: " << var << std::endl; return; }
-        auto &v = ctx.variables[var];
-        if (v.type == "arr") {
-            std::stringstream ss(v.value);
-            std::string item;
-            std::vector<std::string> vals;
-            while (std::getline(ss, item, ',')) vals.push_back(trim(item));
-            std::cout << "[";
-            for (size_t i = 0; i < vals.size(); ++i) {
-                std::cout << vals[i];
-                if (i != vals.size() - 1) std::cout << ", ";
-            }
-            std::cout << "]" << std::endl;
+int main(int argc, char* argv[]) {
+    unsigned jobs = ThreadPool::defaultThreads();
+    bool check = false;
+    bool debug = false;
+    bool showStats = false;
+    bool closures = false;
+    bool optimize = false;
+    bool dump = false;
+    size_t specializeBudget = 256; // statements of funS clones
+    std::string profileOut, profileUse;
+    std::vector<std::pair<std::string, std::string>> settings;
+    std::string incremental;
+    bool autoParallel = false;
+    bool asyncOutput = false;
+    ReadBackend reads = ReadBackend::Blocking;
+    OutputFormat format = OutputFormat::Text;
+    AllocatorKind allocator = AllocatorKind::System;
+    std::string memo;
+    size_t memoMb = 64;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc) {
+            unsigned long long n;
+            if (!parseCount(argv[++i], 1, std::numeric_limits<unsigned>::max(), n)) { usage(); return 1; }
+            jobs = static_cast<unsigned>(n);
+        } else if (arg == "--check") {
+            check = true;
+        } else if (arg == "--debug") {
+            debug = true;
+        } else if (arg == "--stats") {
+            showStats = true;
+        } else if (arg == "--optimize") {
+            optimize = true;
+        } else if (arg == "--specialize-budget" && i + 1 < argc) {
+            unsigned long long n;
+            if (!parseCount(argv[++i], 0, std::numeric_limits<size_t>::max(), n)) { usage(); return 1; }
+            specializeBudget = static_cast<size_t>(n);
+        } else if (arg == "--profile-out" && i + 1 < argc) {
+            profileOut = argv[++i];
+        } else if (arg == "--profile-use" && i + 1 < argc) {
+            profileUse = argv[++i];
+        } else if (arg == "--set" && i + 1 < argc && std::string(argv[i + 1]).find('=') != std::string::npos) {
+            std::string setting = argv[++i];
+            size_t eq = setting.find('=');
+            settings.emplace_back(setting.substr(0, eq), setting.substr(eq + 1));
+        } else if (arg == "--incremental" && i + 1 < argc) {
+            incremental = argv[++i];
+        } else if (arg == "--auto-parallel") {
+            autoParallel = true;
+        } else if (arg == "--async-output") {
+            asyncOutput = true;
+        } else if (arg == "--output=text" || arg == "--output=jsonl" || arg == "--output=binary") {
+            format = arg == "--output=jsonl" ? OutputFormat::Jsonl
+                     : arg == "--output=binary" ? OutputFormat::Binary : OutputFormat::Text;
+        } else if (arg == "--read-ahead=uring" || arg == "--read-ahead=thread") {
+            reads = arg == "--read-ahead=uring" ? ReadBackend::Uring : ReadBackend::Thread;
+        } else if (arg == "--memo" && i + 1 < argc) {
+            memo = argv[++i];
+        } else if (arg == "--memo-size" && i + 1 < argc) {
+            // the size in bytes must fit the file's off_t
+            unsigned long long n;
+            if (!parseCount(argv[++i], 1, std::numeric_limits<off_t>::max() >> 20, n)) { usage(); return 1; }
+            memoMb = static_cast<size_t>(n);
+        } else if (arg == "--dump-ir") {
+            dump = true;
+        } else if (arg == "--allocator=system" || arg == "--allocator=lo") {
+            allocator = arg == "--allocator=lo" ? AllocatorKind::Lo : AllocatorKind::System;
+        } else if (arg == "--engine=switch" || arg == "--engine=closure") {
+            closures = arg == "--engine=closure";
+        } else if (arg == "--repl") {
+            return runRepl();
+        } else if (arg == "--lsp") {
+            return runLanguageServer();
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage();
+            return 1;
         } else {
-            std::cout << v.value << std::endl;
+            paths.push_back(arg);
         }
-    } else if (m[4].matched) {
-        std::string fname = m[4];
-        std::string argsStr = m[5];
-        std::vector<std::string> args;
-        std::stringstream ss(argsStr);
-        std::string a;
-        while (std::getline(ss, a, ',')) args.push_back(trim(a));
-        if (!ctx.functions.count(fname)) errorAndExit(lineno, "Undefined function: " + fname);
-        std::string res = executeFunction(ctx.functions[fname], args, ctx.functions, ctx.variables);
-        std::cout << res << std::endl;
-    } else errorAndExit(lineno, "Bad print expression");
-}
-
-int main(int argc, char* argv[]) {
-    if (argc < 2) { std::cerr << "Usage: lomake <file.lo>\n"; return 1; }
-    std::ifstream file(argv[1]);
-    if (!file) { std::cerr << "Failed to open file\n"; return 1; }
-    std::vector<std::string> lines;
-    std::string line;
-    while (std::getline(file, line)) lines.push_back(trim(line));
-
-    Context ctx;
-    bool inFunction = false;
-    FunctionDef currentFunc;
-    std::string currentFuncName;
-    std::stack<IfState> ifStack;
+    }
+    if (check && !paths.empty()) return checkFiles(paths, jobs);
+    if (paths.size() != 1 || (!profileOut.empty() && !profileUse.empty()) ||
+        ((!incremental.empty() || autoParallel) && (debug || !profileOut.empty())) ||
+        (!incremental.empty() && autoParallel) || ((asyncOutput || format != OutputFormat::Text) && debug)) {
+        usage();
+        return 1;
+    }
+    const std::string &path = paths.front();
+    if (!selectAllocator(allocator)) std::cerr << "Using the system allocator: cannot reserve memory" << std::endl;
+    outputFormat = format; // before loading: compile-time evaluation folds prints
+    if (reads != ReadBackend::Blocking) {
+        readBackend = reads;
+        readStdinAhead();
+    }
 
-    for (size_t i = 0; i < lines.size(); ++i) {
-        const std::string &ln = lines[i];
-        if (ln.empty()) continue;
-        std::smatch match;
+    Profile recording(sourceFingerprint(path)), profile(sourceFingerprint(path));
+    if (!profileOut.empty()) {
+        std::string error;
+        recording.merge(profileOut, error); // a stale or missing profile starts over
+        activeProfile = &recording;
+    }
+    bool profiled = false;
+    if (!profileUse.empty()) {
+        std::string error;
+        profiled = profile.merge(profileUse, error);
+        if (!profiled) std::cerr << "Ignoring profile: " << error << std::endl;
+        else optimize = stats.profiled = true;
+    }
 
-        if (inFunction) {
-            if (ln == "}") {
-                ctx.functions[currentFuncName] = currentFunc;
-                inFunction = false;
-            } else {
-                currentFunc.body.push_back(ln);
-            }
-            continue;
+    using Clock = std::chrono::steady_clock;
+    auto msSince = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    auto started = Clock::now();
+    std::vector<Diagnostic> diagnostics;
+    // a folded print-- call would never reach the debugger's breakpoints
+    Module *root = loadModuleGraph(path, true, jobs, diagnostics, !debug);
+    stats.compileMs = msSince(started);
+    if (root->failed) { std::cerr << "Failed to open file\n"; return 1; }
+    if (!diagnostics.empty()) {
+        for (const auto &diag : diagnostics) std::cerr << formatDiagnostic(diag, root->path) << std::endl;
+        return 1;
+    }
+    for (const auto &[name, value] : settings) {
+        std::string error;
+        if (!setGlobal(*root, name, value, error)) {
+            std::cerr << "Cannot --set " << name << ": " << error << std::endl;
+            return 1;
         }
+    }
 
-        if (std::regex_match(ln, match, funRegex)) {
-            inFunction = true;
-            currentFuncName = match[2];
-            currentFunc.returnType = match[1];
-            currentFunc.body.clear();
-            currentFunc.params.clear();
-            std::string paramStr = match[3];
-            std::stringstream ss(paramStr);
-            std::string p;
-            while (std::getline(ss, p, ',')) {
-                p = trim(p);
-                if (p.empty()) continue;
-                size_t colon = p.find(':');
-                if (colon != std::string::npos) {
-                    std::string type = trim(p.substr(0, colon));
-                    std::string name = trim(p.substr(colon + 1));
-                    currentFunc.params.emplace_back(type, name);
-                } else {
-                    // If the parameter has no type, you can decide by default or fail
-                    currentFunc.params.emplace_back(std::string("var"), trim(p));
-                }
-            }
-            continue;
+    // the debugger steps through the code as written
+    if (dump || (optimize && !debug)) {
+        if (optimize) specializeCalls(*root, specializeBudget, profiled ? &profile : nullptr);
+        IrProgram ir = buildIr(root->code);
+        std::string error = verifyIr(ir);
+        if (error.empty() && optimize) {
+            optimizeIr(ir);
+            error = verifyIr(ir);
         }
-
-        // if / elif / end handling
-        if (startsWith(ln, "if-")) {
-            // simple parse: if- a >> b the
-            std::smatch m2;
-            std::regex ifRe(R"(if-\s*(\w+)\s*(>>|<<|===)\s*(\w+)\s*the)");
-            if (std::regex_match(ln, m2, ifRe)) {
-                bool res = evaluateCondition(ctx.variables, m2[1], m2[2], m2[3]);
-                ifStack.push({res, !res});
-            } else errorAndExit(i+1, "Malformed if condition");
-            continue;
-        } else if (startsWith(ln, "elif-")) {
-            if (ifStack.empty()) errorAndExit(i+1, "elif without if");
-            IfState top = ifStack.top(); ifStack.pop();
-            if (top.matched) {
-                // earlier branch matched — remain skipping
-                ifStack.push({true, true});
-            } else {
-                std::smatch m2;
-                std::regex elifRe(R"(elif-\s*(\w+)\s*(>>|<<|===)\s*(\w+)\s*the)");
-                if (!std::regex_match(ln, m2, elifRe)) errorAndExit(i+1, "Malformed elif");
-                bool res = evaluateCondition(ctx.variables, m2[1], m2[2], m2[3]);
-                ifStack.push({res, !res});
-            }
-            continue;
-        } else if (ln == "end--") {
-            if (ifStack.empty()) errorAndExit(i+1, "end-- without if");
-            ifStack.pop();
-            continue;
+        if (dump) {
+            dumpIr(ir, std::cout);
+            if (!error.empty()) { std::cerr << "Invalid IR: " << error << std::endl; return 1; }
+            return 0;
         }
+        if (!error.empty()) std::cerr << "Invalid IR, running unoptimized: " << error << std::endl;
+        else lowerIr(ir, *root);
+    }
 
-        // if we're inside a skipping if body -> ignore line
-        if (!ifStack.empty() && ifStack.top().skipping) continue;
+    if (profiled && !debug) applyProfile(*root, profile);
 
-        // simple constructs
-        if (std::regex_match(ln, match, locRegex)) {
-            processLoc(ctx, match, i+1);
-        } else if (std::regex_match(ln, match, inputRegex)) {
-            processInput(ctx, match, i+1);
-        } else if (std::regex_match(ln, match, assignRegex)) {
-            processAssign(ctx, match, i+1);
-        } else if (std::regex_match(ln, match, printRegex)) {
-            processPrint(ctx, match, i+1);
+    if (showStats) {
+        std::set<const Module *> seen;
+        countModules(root, seen);
+    }
+
+    Context ctx;
+    ctx.sourcePath = root->path;
+    ctx.functions = root->functions;
+    MemoTable memoTable;
+    if (!memo.empty() && !debug) {
+        std::string error;
+        if (memoTable.open(memo, memoMb << 20, error)) {
+            assignMemoIds(*root, ctx.functions);
+            activeMemo = &memoTable;
         } else {
-            std::cerr << "Syntax error at line " << i+1 << ": " << ln << std::endl;
-            return 1;
+            std::cerr << "Not memoizing: " << error << std::endl;
         }
     }
-
-    return 0;
-}
\ No newline at end of file
+    std::unique_ptr<Debugger> debugger;
+    if (debug) {
+        debugger = std::make_unique<Debugger>(ctx, *root);
+        activeDebugger = debugger.get();
+        debugger->start();
+    }
+    std::unique_ptr<AsyncOutput> output;
+    if (asyncOutput) output = std::make_unique<AsyncOutput>();
+    int status = 0;
+    started = Clock::now();
+    try {
+        // the debugger and the profiler trap through runCode's dispatch, so
+        // they keep that engine; --incremental and --auto-parallel run their
+        // blocks with it too
+        if (!incremental.empty()) runIncremental(ctx, root->code, incremental, graphFingerprint(*root));
+        else if (autoParallel) runParallel(ctx, root->code, jobs);
+        else if (closures && !debug && !activeProfile) runClosureCode(ctx, root->code);
+        else runCode(ctx, root->code);
+    } catch (const LoError &e) {
+        std::cerr << formatError(e) << std::endl;
+        status = 1;
+    }
+    stats.runMs = msSince(started);
+    if (activeProfile) {
+        recording.finishRun(ctx.functions);
+        std::string error;
+        if (!recording.save(profileOut, error)) std::cerr << "Cannot save profile: " << error << std::endl;
+    }
+    if (showStats) printStats(std::cerr);
+    return status;
+}
@@ -0,0 +1,242 @@
+#include "h/alloc.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+namespace {
+
+const size_t spanSize = 64 << 10;
+const size_t regionSize = size_t(16) << 30; // address space only; spans are touched as they are carved
+const size_t spanCount = regionSize / spanSize;
+const size_t largest = 1024;
+const unsigned classCount = 28;
+
+// 16-byte steps up to 256, then 64-byte steps up to 1024.
+size_t classSize(unsigned c) {
+    return c < 16 ? (c + 1) * 16 : 256 + (c - 15) * 64;
+}
+
+unsigned classOf(size_t size) {
+    if (size <= 256) return size ? static_cast<unsigned>((size - 1) / 16) : 0;
+    return 15 + static_cast<unsigned>((size - 256 + 63) / 64);
+}
+
+// Blocks moved to or from the shared lists at a time.
+unsigned batchOf(unsigned c) {
+    size_t n = 4096 / classSize(c);
+    return n < 8 ? 8 : static_cast<unsigned>(n);
+}
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+std::atomic<bool> loActive{false};
+char* region = nullptr;
+std::atomic<size_t> spansUsed{0};
+std::atomic<size_t> transfers{0};
+unsigned char spanClass[spanCount];
+
+// Blocks threads gave back, per class.
+struct Shared {
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    FreeBlock* head = nullptr;
+
+    void lock() {
+        while (busy.test_and_set(std::memory_order_acquire)) {}
+    }
+    void unlock() { busy.clear(std::memory_order_release); }
+};
+Shared shared[classCount];
+
+// Plain data, so it needs no construction before the first allocation of
+// a thread; Flusher empties it when the thread exits.
+struct Cache {
+    FreeBlock* head[classCount];
+    unsigned count[classCount];
+    bool started;
+    bool gone; // past its thread's exit: blocks go straight to the shared lists
+};
+thread_local Cache cache;
+
+void giveBack(unsigned c, FreeBlock* first, FreeBlock* last) {
+    Shared& s = shared[c];
+    s.lock();
+    last->next = s.head;
+    s.head = first;
+    s.unlock();
+    transfers.fetch_add(1, std::memory_order_relaxed);
+}
+
+struct Flusher {
+    ~Flusher() {
+        for (unsigned c = 0; c < classCount; ++c) {
+            FreeBlock* first = cache.head[c];
+            if (!first) continue;
+            FreeBlock* last = first;
+            while (last->next) last = last->next;
+            giveBack(c, first, last);
+            cache.head[c] = nullptr;
+            cache.count[c] = 0;
+        }
+        cache.gone = true;
+    }
+};
+thread_local Flusher flusher;
+
+bool inRegion(void* p) {
+    return region && static_cast<char*>(p) >= region && static_cast<char*>(p) < region + regionSize;
+}
+
+// Fills the thread's list for class `c` from the shared list, or from a
+// new span when that is empty.
+void refill(unsigned c) {
+    if (!cache.started) {
+        cache.started = true;
+        (void)&flusher; // registers the flush at thread exit
+    }
+    Shared& s = shared[c];
+    s.lock();
+    FreeBlock* first = s.head;
+    FreeBlock* last = nullptr;
+    unsigned taken = 0;
+    for (FreeBlock* b = first; b && taken < batchOf(c); b = b->next, ++taken) last = b;
+    if (last) {
+        s.head = last->next;
+        last->next = nullptr;
+    }
+    s.unlock();
+    if (taken) {
+        transfers.fetch_add(1, std::memory_order_relaxed);
+        cache.head[c] = first;
+        cache.count[c] = taken;
+        return;
+    }
+
+    size_t span = spansUsed.fetch_add(1, std::memory_order_relaxed);
+    if (span >= spanCount) return;
+    spanClass[span] = static_cast<unsigned char>(c);
+    char* base = region + span * spanSize;
+    size_t size = classSize(c), blocks = spanSize / size;
+    for (size_t i = blocks; i-- > 0;) {
+        auto* b = reinterpret_cast<FreeBlock*>(base + i * size);
+        b->next = cache.head[c];
+        cache.head[c] = b;
+    }
+    cache.count[c] = static_cast<unsigned>(blocks);
+}
+
+void* allocate(size_t size) {
+    if (!loActive.load(std::memory_order_relaxed) || size > largest || cache.gone)
+        return std::malloc(size ? size : 1);
+    unsigned c = classOf(size);
+    if (!cache.head[c]) {
+        refill(c);
+        if (!cache.head[c]) return std::malloc(size); // the region is used up
+    }
+    FreeBlock* b = cache.head[c];
+    cache.head[c] = b->next;
+    --cache.count[c];
+    return b;
+}
+
+void release(void* p) {
+    if (!inRegion(p)) {
+        std::free(p);
+        return;
+    }
+    unsigned c = spanClass[(static_cast<char*>(p) - region) / spanSize];
+    auto* b = static_cast<FreeBlock*>(p);
+    if (cache.gone) {
+        b->next = nullptr;
+        giveBack(c, b, b);
+        return;
+    }
+    b->next = cache.head[c];
+    cache.head[c] = b;
+    unsigned batch = batchOf(c);
+    if (++cache.count[c] <= 2 * batch) return;
+    // keep the blocks freed last, which are the likeliest to be in cache
+    FreeBlock* keepLast = b;
+    for (unsigned i = 1; i < batch; ++i) keepLast = keepLast->next;
+    FreeBlock* first = keepLast->next;
+    FreeBlock* last = first;
+    while (last->next) last = last->next;
+    keepLast->next = nullptr;
+    cache.count[c] = batch;
+    giveBack(c, first, last);
+}
+
+}
+
+bool selectAllocator(AllocatorKind kind) {
+    if (kind == AllocatorKind::System) {
+        loActive = false;
+        return true;
+    }
+    if (!region) {
+        void* at = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                        -1, 0);
+        if (at == MAP_FAILED) return false;
+        region = static_cast<char*>(at);
+    }
+    loActive = true;
+    return true;
+}
+
+bool loAllocatorActive() {
+    return loActive;
+}
+
+size_t loAllocatorSpans() {
+    size_t used = spansUsed.load();
+    return used < spanCount ? used : spanCount;
+}
+
+size_t loAllocatorTransfers() {
+    return transfers.load();
+}
+
+void* operator new(size_t size) {
+    if (void* p = allocate(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    if (void* p = allocate(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p) noexcept {
+    release(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    release(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    release(p);
+}
@@ -0,0 +1,264 @@
+#include "h/checker.h"
+#include "h/utils.h"
+#include <cctype>
+#include <regex>
+#include <set>
+#include <unordered_map>
+
+namespace {
+
+std::regex identRegex(R"([A-Za-z_]\w*)");
+std::regex stringLiteralRegex(R"("[^"]*")");
+
+size_t skipDigits(const std::string& s, size_t i) {
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9') ++i;
+    return i;
+}
+
+size_t skipSpaces(const std::string& s, size_t i) {
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t')) ++i;
+    return i;
+}
+
+// What evalExpression turns into an int: -?\d+ or \d+ op \d+. Hand-rolled
+// because the LSP server runs it over every statement on each edit.
+bool isIntValue(const std::string& s) {
+    size_t i = (!s.empty() && s[0] == '-') ? 1 : 0;
+    size_t end = skipDigits(s, i);
+    if (end == i) return false;
+    if (end == s.size()) return true;
+    if (i == 1) return false;
+    i = skipSpaces(s, end);
+    if (i == s.size() || std::string("+-*/%^").find(s[i]) == std::string::npos) return false;
+    i = skipSpaces(s, i + 1);
+    end = skipDigits(s, i);
+    return end != i && end == s.size();
+}
+
+bool isIdentifier(const std::string& s) {
+    if (s.empty() || !(std::isalpha(static_cast<unsigned char>(s[0])) || s[0] == '_')) return false;
+    for (char c : s) {
+        if (!(std::isalnum(static_cast<unsigned char>(c)) || c == '_')) return false;
+    }
+    return true;
+}
+
+bool isBoolValue(const std::string& s) {
+    return s == "true" || s == "false" || s == "1" || s == "0";
+}
+
+const FunctionDef* lookupInScope(const Module& mod, const std::string& name, std::set<const Module*>& seen) {
+    if (!seen.insert(&mod).second) return nullptr;
+    auto it = mod.functions.find(name);
+    if (it != mod.functions.end()) return &it->second;
+    for (const Module* dep : mod.imports) {
+        if (!dep || dep->failed) continue;
+        if (const FunctionDef* def = lookupInScope(*dep, name, seen)) return def;
+    }
+    return nullptr;
+}
+
+}
+
+CodeChecker::CodeChecker(const std::string& path, FunctionLookup lookup, std::vector<Diagnostic>& out)
+    : path(path), lookup(std::move(lookup)), out(out) {}
+
+void CodeChecker::checkCode(const Code& code, int lineOffset) {
+    offset = lineOffset;
+    for (const Stmt& st : code) checkStmt(st);
+}
+
+void CodeChecker::error(int lineno, const std::string& msg) {
+    out.push_back({path, lineno + offset, msg});
+}
+
+void CodeChecker::setOuterScope(VariableLookup outerVars, bool natives) {
+    outer = std::move(outerVars);
+    hasNatives = natives;
+}
+
+const std::string* CodeChecker::typeOf(const std::string& name) const {
+    auto it = vars.find(name);
+    if (it != vars.end()) return &it->second;
+    return outer ? outer(name) : nullptr;
+}
+
+bool CodeChecker::requireVar(const Stmt& st, const std::string& name) {
+    if (typeOf(name)) return true;
+    error(st.line(), "Undefined variable: " + name);
+    return false;
+}
+
+void CodeChecker::checkStmt(const Stmt& st) {
+    switch (st.kind()) {
+        case StmtKind::Loc: {
+            const std::string& name = st.str(0);
+            const std::string& type = st.str(1);
+            const std::string& raw = st.str(2);
+            if (typeOf(name)) error(st.line(), "Duplicate variable: " + name);
+            if (type == "int" && !isIntValue(raw)) error(st.line(), "Invalid int value: " + raw);
+            if (type == "bool" && !isBoolValue(raw)) error(st.line(), "Invalid bool value: " + raw);
+            vars[name] = type;
+            break;
+        }
+        case StmtKind::Const: {
+            // values are validated when constants are folded; unfolded code
+            // (the LSP server) only gets declarations and calls checked
+            const std::string& name = st.str(0);
+            if (typeOf(name)) error(st.line(), "Duplicate variable: " + name);
+            const std::string& raw = st.str(2);
+            if (startsWith(raw, "f-")) {
+                size_t paren = raw.find('(');
+                std::string fname = raw.substr(2, paren == std::string::npos ? std::string::npos : paren - 2);
+                if (!lookup(fname)) error(st.line(), "Undefined function: " + fname);
+            }
+            vars[name] = st.str(1);
+            break;
+        }
+        case StmtKind::Input:
+            vars[st.str(0)] = st.str(1) == "i" ? "int" : "str";
+            break;
+        case StmtKind::Assign: {
+            if (!requireVar(st, st.str(0))) break;
+            const std::string& type = *typeOf(st.str(0));
+            const std::string& rhs = st.str(1);
+            if (type == "int" && !isIntValue(rhs)) error(st.line(), "Invalid int value: " + rhs);
+            if (type == "bool" && !isBoolValue(rhs)) error(st.line(), "Invalid bool assignment: " + rhs);
+            break;
+        }
+        case StmtKind::PrintVar:
+            requireVar(st, st.str(0));
+            break;
+        case StmtKind::PrintCall:
+            checkCall(st);
+            break;
+        case StmtKind::If:
+        case StmtKind::Try:
+            subjects.emplace_back();
+            branches.push_back({vars, {}});
+            if (st.kind() == StmtKind::If) checkCondition(st);
+            break;
+        case StmtKind::Elif:
+            nextBranch();
+            checkCondition(st);
+            break;
+        case StmtKind::Match: {
+            subjects.push_back(st.str(0));
+            branches.push_back({vars, {}});
+            if (!requireVar(st, st.str(0))) break;
+            const std::string& type = *typeOf(st.str(0));
+            if (type != "int" && type != "str") error(st.line(), "Cannot match " + type + " variable " + st.str(0));
+            break;
+        }
+        case StmtKind::Case: {
+            nextBranch();
+            const std::string* type = subjects.empty() ? nullptr : typeOf(subjects.back());
+            std::string caseType = st.str(0).front() == '"' ? "str" : "int";
+            if (type && (*type == "int" || *type == "str") && *type != caseType)
+                error(st.line(), "Comparing " + *type + " with " + caseType + " is always false");
+            break;
+        }
+        case StmtKind::End:
+            if (!subjects.empty()) subjects.pop_back();
+            if (!branches.empty()) {
+                // after the block, whatever some branch declared is known
+                nextBranch();
+                vars = std::move(branches.back().merged);
+                branches.pop_back();
+            }
+            break;
+        case StmtKind::UseNative:
+            // never dlopen while checking; calls may resolve to the module
+            hasNatives = true;
+            break;
+        case StmtKind::Return:
+            error(st.line(), "return outside of funS");
+            break;
+        case StmtKind::Catch:
+            nextBranch();
+            if (st.argCount()) vars[st.str(0)] = "str";
+            break;
+        case StmtKind::PrintText:
+        case StmtKind::Import:
+        case StmtKind::Trap:
+            break;
+    }
+}
+
+// Only one branch of a block runs, so each starts from what was declared
+// before the block; the finished branch's declarations are set aside.
+void CodeChecker::nextBranch() {
+    if (branches.empty()) return;
+    Branches& b = branches.back();
+    b.merged.insert(vars.begin(), vars.end());
+    vars = b.entry;
+}
+
+void CodeChecker::checkCall(const Stmt& st) {
+    const std::string& fname = st.str(0);
+    size_t argc = st.argCount() - 1;
+    for (size_t i = 1; i < st.argCount(); ++i) {
+        const std::string& arg = st.str(i);
+        if (isIdentifier(arg)) requireVar(st, arg);
+    }
+    const FunctionDef* func = lookup(fname);
+    if (!func) {
+        if (!hasNatives) error(st.line(), "Undefined function: " + fname);
+        return;
+    }
+    if (argc != func->params.size())
+        error(st.line(), "Wrong argument count for " + fname + ": expected " +
+                       std::to_string(func->params.size()) + ", got " + std::to_string(argc));
+}
+
+void CodeChecker::checkCondition(const Stmt& st) {
+    const std::string& lhs = st.str(0);
+    const std::string& rhs = st.str(2);
+    if (!requireVar(st, lhs)) return;
+    const std::string& type = *typeOf(lhs);
+    const std::string* rhsType = typeOf(rhs);
+    if (type != "int" && type != "str") {
+        error(st.line(), "Cannot compare " + type + " variable " + lhs);
+    } else if (rhsType) {
+        if (*rhsType != type) error(st.line(), "Comparing " + type + " with " + *rhsType + " is always false");
+    } else if (type == "int" && !isIntValue(rhs)) {
+        error(st.line(), "Undefined variable: " + rhs);
+    }
+}
+
+void checkFunction(const std::string& path, const FunctionDef& func, std::vector<Diagnostic>& out, int lineOffset) {
+    auto error = [&](int lineno, const std::string& msg) { out.push_back({path, lineno + lineOffset, msg}); };
+    std::set<std::string> names;
+    for (const auto& p : func.params) names.insert(p.second);
+    std::set<int> compiled;
+    for (const Stmt& st : func.code) compiled.insert(st.line());
+
+    for (size_t i = 0; i < func.body.size(); ++i) {
+        int lineno = func.line + 1 + static_cast<int>(i);
+        if (!func.body[i].empty() && !compiled.count(lineno))
+            error(lineno, "Unsupported statement in funS: " + func.body[i]);
+    }
+    for (const Stmt& st : func.code) {
+        if (st.kind() == StmtKind::Loc) {
+            if (st.str(1) == "int" && !isIntValue(trim(st.str(2))))
+                error(st.line(), "Invalid int value: " + st.str(2));
+            names.insert(st.str(0));
+        } else if (st.kind() == StmtKind::Return) {
+            std::string expr = std::regex_replace(st.str(0), stringLiteralRegex, "");
+            for (std::sregex_iterator it(expr.begin(), expr.end(), identRegex), end; it != end; ++it) {
+                if (!names.count(it->str())) error(st.line(), "Undefined variable: " + it->str());
+            }
+        }
+    }
+}
+
+void checkModule(Module& mod) {
+    std::vector<Diagnostic> found;
+    CodeChecker checker(mod.path, [&mod](const std::string& name) {
+        std::set<const Module*> seen;
+        return lookupInScope(mod, name, seen);
+    }, found);
+    checker.checkCode(mod.code);
+    for (const auto& [name, func] : mod.functions) checkFunction(mod.path, func, found);
+    mod.diagnostics.insert(mod.diagnostics.end(), found.begin(), found.end());
+}
@@ -0,0 +1,367 @@
+#include "h/closure.h"
+#include "h/error.h"
+#include "h/evaluator.h"
+#include "h/executor.h"
+#include "h/interpreter.h"
+#include "h/jumptable.h"
+#include "h/module.h"
+#include "h/output.h"
+#include "h/quicken.h"
+#include "h/utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+
+namespace {
+
+using Op = std::function<void(Context &)>;
+using Cond = std::function<bool(Context &)>;
+
+// A run of ops in Program::ops. Blocks are laid out child-first, so a
+// node's children are already in place when the node is built.
+struct Block {
+    uint32_t begin = 0, end = 0;
+};
+
+struct Branch {
+    Cond cond;
+    Block body;
+};
+
+// if-/elif- chain or match-; its branches are a run in Program::branches
+struct Chain {
+    Stmt head;
+    std::string subject; // variable a jump table selects on
+    uint32_t first = 0, count = 0;
+    std::unordered_map<size_t, Block> targets; // jump-table target -> body of the branch starting there
+};
+
+struct Try {
+    Stmt handler;
+    Block body, recover;
+};
+
+// funS whose body reduces to reading its return operands (see ReturnShape).
+// Each operand is a literal, a param or a loc whose value is fixed.
+struct CompiledFunction {
+    enum class Source { Literal, Param, Loc };
+    bool direct = false;
+    char op = 0;
+    Source source[2] = {Source::Literal, Source::Literal};
+    size_t param[2] = {0, 0};
+    long long literal[2] = {0, 0};
+    std::string loc[2];
+};
+
+// args are st.arg(1..)
+struct Call {
+    Stmt st;
+    const FunctionDef *func = nullptr; // a funS found once stays in ctx.functions
+    const CompiledFunction *compiled = nullptr;
+};
+
+// loc with a value computed at compile time
+struct Binding {
+    std::string name;
+    Variable var;
+};
+
+class Program {
+public:
+    explicit Program(const Code &code) : code(code) {
+        ops.reserve(code.size());
+        lines.reserve(code.size());
+        main = compileRange(0, code.size());
+    }
+
+    void run(Context &ctx) { runBlock(ctx, main); }
+
+private:
+    void runBlock(Context &ctx, Block block) {
+        uint32_t i = block.begin;
+        try {
+            for (; i < block.end; ++i) ops[i](ctx);
+        } catch (LoError &e) {
+            if (!e.line) e.line = lines[i];
+            throw;
+        }
+    }
+
+    // Nested ranges are compiled while this one is still collecting, so
+    // its ops wait on the `pending` stack and are moved into place at the end.
+    Block compileRange(uint32_t begin, uint32_t end) {
+        size_t mark = pending.size();
+        for (uint32_t pc = begin; pc < end;) {
+            int line = code[pc].line();
+            Op op = compileAt(pc);
+            if (op) pending.emplace_back(std::move(op), line);
+        }
+        Block block{static_cast<uint32_t>(ops.size()), static_cast<uint32_t>(ops.size() + pending.size() - mark)};
+        for (size_t i = mark; i < pending.size(); ++i) {
+            ops.push_back(std::move(pending[i].first));
+            lines.push_back(pending[i].second);
+        }
+        pending.resize(mark);
+        return block;
+    }
+
+    // Compiles the statement or block at pc and moves pc past it.
+    Op compileAt(uint32_t &pc) {
+        Stmt st = code[pc];
+        switch (st.kind()) {
+            case StmtKind::If: return compileChain(pc);
+            case StmtKind::Match: return compileMatch(pc);
+            case StmtKind::Try: return compileTry(pc);
+            default: break;
+        }
+        ++pc;
+        switch (st.kind()) {
+            case StmtKind::Loc: return compileLoc(st);
+            case StmtKind::Assign:
+                return [st](Context &ctx) {
+                    if (!quickAssign(ctx.variables, st)) processAssign(ctx, st);
+                };
+            case StmtKind::Input: return [st](Context &ctx) { processInput(ctx, st); };
+            case StmtKind::PrintText:
+                return [text = st.arg(0)](Context &) { printValue("str", text); };
+            case StmtKind::PrintVar:
+                return [st](Context &ctx) {
+                    if (const Variable *v = quickLoad(ctx.variables, st)) printValue(v->type, v->value.view());
+                    else processPrint(ctx, st, StmtKind::PrintVar);
+                };
+            case StmtKind::PrintCall: {
+                calls.push_back({st});
+                return [this, call = &calls.back()](Context &ctx) { runCall(ctx, *call); };
+            }
+            case StmtKind::Import: return [st](Context &ctx) { processImport(ctx, st); };
+            case StmtKind::UseNative: return [st](Context &ctx) { processUseNative(ctx, st); };
+            case StmtKind::Const:
+                return [st](Context &) { raiseError(ErrorCode::Syntax, st.line(), "const was not evaluated"); };
+            case StmtKind::Return:
+                return [st](Context &) { raiseError(ErrorCode::Syntax, st.line(), "return outside of funS"); };
+            default:
+                // end--, and branch heads only reached through their block
+                return nullptr;
+        }
+    }
+
+    // loc values that cannot fail are computed here, once
+    Op compileLoc(Stmt st) {
+        std::string type = st.str(1), raw = st.str(2);
+        Variable var{type, raw};
+        if (type == "str") {
+            var.value = stripQuotes(raw);
+        } else if (type == "int") {
+            try {
+                var.value = evalExpression(raw);
+            } catch (const LoError &) {
+                return [st](Context &ctx) { processLoc(ctx, st); };
+            }
+        } else if (type == "bool") {
+            std::string val = trim(raw);
+            if (val == "true" || val == "1") var.value = "true";
+            else if (val == "false" || val == "0") var.value = "false";
+            else return [st](Context &ctx) { processLoc(ctx, st); };
+        } else {
+            return [st](Context &ctx) { processLoc(ctx, st); };
+        }
+        bindings.push_back({st.str(0), std::move(var)});
+        return [&b = bindings.back()](Context &ctx) { ctx.variables[b.name] = b.var; };
+    }
+
+    // Compiles the branches headed at `head` (linked by `next`) into the
+    // chain; like ops, they wait on a stack while nested chains compile.
+    Chain &compileBranches(Stmt st, uint32_t head, StmtKind kind) {
+        chains.push_back({st, st.str(0), 0, 0, {}});
+        Chain &chain = chains.back();
+        size_t mark = pendingBranches.size();
+        std::vector<uint32_t> starts;
+        for (uint32_t b = head;;) {
+            Stmt h = code[b];
+            Block body = compileRange(b + 1, h.next());
+            if (st.table()) chain.targets.emplace(b + 1, body);
+            pendingBranches.push_back({[h](Context &ctx) { return quickCondition(ctx.variables, h); }, body});
+            starts.push_back(b);
+            b = h.next();
+            if (b >= code.size() || code[b].kind() != kind) break;
+        }
+        if (st.table() && !st.table()->testOrder().empty()) {
+            // tested in the order a profile ranked them (see profile.h)
+            std::vector<Branch> ordered;
+            for (uint32_t b : st.table()->testOrder()) {
+                size_t i = std::find(starts.begin(), starts.end(), b) - starts.begin();
+                ordered.push_back(std::move(pendingBranches[mark + i]));
+            }
+            std::move(ordered.begin(), ordered.end(), pendingBranches.begin() + mark);
+        }
+        chain.first = static_cast<uint32_t>(branches.size());
+        chain.count = static_cast<uint32_t>(pendingBranches.size() - mark);
+        for (size_t i = mark; i < pendingBranches.size(); ++i) branches.push_back(std::move(pendingBranches[i]));
+        pendingBranches.resize(mark);
+        return chain;
+    }
+
+    void runBranches(Context &ctx, const Chain &chain) {
+        for (uint32_t i = chain.first; i < chain.first + chain.count; ++i) {
+            if (branches[i].cond(ctx)) return runBlock(ctx, branches[i].body);
+        }
+    }
+
+    Op compileChain(uint32_t &pc) {
+        Stmt st = code[pc];
+        Chain &chain = compileBranches(st, pc, StmtKind::Elif);
+        pc = st.end() + 1;
+        if (!st.table()) return [this, &chain](Context &ctx) { runBranches(ctx, chain); };
+        return [this, &chain](Context &ctx) {
+            uint32_t target;
+            if (!chain.head.table()->select(ctx.variables, chain.subject, target)) return runBranches(ctx, chain);
+            auto it = chain.targets.find(target);
+            if (it != chain.targets.end()) runBlock(ctx, it->second);
+        };
+    }
+
+    Op compileMatch(uint32_t &pc) {
+        Stmt st = code[pc];
+        Chain &chain = compileBranches(st, st.next(), StmtKind::Case);
+        pc = st.end() + 1;
+        return [this, &chain](Context &ctx) {
+            Stmt st = chain.head;
+            auto var = ctx.variables.find(chain.subject);
+            if (var == ctx.variables.end())
+                raiseError(ErrorCode::UndefinedVariable, st.line(), "Undefined variable: " + chain.subject);
+            uint32_t target;
+            if (!st.table()->select(ctx.variables, chain.subject, target))
+                raiseError(ErrorCode::InvalidValue, st.line(), "Invalid integer: " + var->second.value);
+            auto it = chain.targets.find(target);
+            if (it != chain.targets.end()) runBlock(ctx, it->second);
+        };
+    }
+
+    Op compileTry(uint32_t &pc) {
+        Stmt st = code[pc];
+        Block body = compileRange(pc + 1, st.next());
+        Block recover = compileRange(st.next() + 1, st.end());
+        tries.push_back({code[st.next()], body, recover});
+        pc = st.end() + 1;
+        return [this, &t = tries.back()](Context &ctx) {
+            bool caught = false;
+            try {
+                runBlock(ctx, t.body);
+            } catch (const LoError &e) {
+                if (t.handler.argCount()) ctx.variables[t.handler.str(0)] = {"str", e.what()};
+                caught = true;
+            }
+            if (caught) runBlock(ctx, t.recover);
+        };
+    }
+
+    const CompiledFunction &compileFunction(const FunctionDef &func) {
+        auto [it, fresh] = functions.try_emplace(&func);
+        CompiledFunction &cf = it->second;
+        if (!fresh) return cf;
+        const Code &body = func.code;
+        uint32_t ret = 0;
+        while (ret < body.size() && body[ret].kind() != StmtKind::Return) ++ret;
+        ReturnShape shape;
+        if (ret == body.size() || !matchReturnShape(func, body[ret].str(0), shape)) return cf;
+        std::unordered_map<std::string, std::string> locs;
+        try {
+            for (uint32_t s = 0; s < ret; ++s) locs[body[s].str(0)] = quickLocValue(body[s]);
+        } catch (const LoError &) {
+            return cf; // the generic call reports it
+        }
+        for (int i = 0; i < (shape.op ? 2 : 1); ++i) {
+            const std::string &name = shape.operand[i];
+            if (name.empty()) {
+                cf.literal[i] = shape.literal[i];
+                continue;
+            }
+            if (locs.count(name)) {
+                cf.source[i] = CompiledFunction::Source::Loc;
+                cf.loc[i] = locs[name];
+                continue;
+            }
+            size_t p = func.params.size();
+            while (p > 0 && func.params[p - 1].second != name) --p;
+            if (p == 0) return cf; // a loc after return: the name stays as text
+            cf.source[i] = CompiledFunction::Source::Param;
+            cf.param[i] = p - 1;
+        }
+        cf.op = shape.op;
+        cf.direct = true;
+        return cf;
+    }
+
+    // Binds argument `i` the way executeFunction does: a name that is not
+    // an earlier param takes the global's value.
+    static std::string_view argument(Context &ctx, const FunctionDef &func, const Call &call, size_t i) {
+        std::string_view value = call.st.arg(i + 1);
+        if (value.front() == '"') return value;
+        for (size_t j = 0; j < i; ++j) {
+            if (func.params[j].second == value) return value;
+        }
+        auto global = ctx.variables.find(std::string(value));
+        return global != ctx.variables.end() ? global->second.value.view() : value;
+    }
+
+    // false when the operands do not hold the ints the shape was made for
+    static bool callDirect(Context &ctx, const CompiledFunction &cf, const FunctionDef &func, const Call &call,
+                           std::string &out) {
+        long long value[2] = {cf.literal[0], cf.literal[1]};
+        for (int i = 0; i < (cf.op ? 2 : 1); ++i) {
+            if (cf.source[i] == CompiledFunction::Source::Literal) continue;
+            std::string_view text = cf.source[i] == CompiledFunction::Source::Loc
+                                        ? std::string_view(cf.loc[i])
+                                        : argument(ctx, func, call, cf.param[i]);
+            if (!parseQuickInt(text, value[i], !cf.op)) return false;
+            if (!cf.op) {
+                out = std::string(text);
+                return true;
+            }
+        }
+        out = std::to_string(applyOperator(value[0], cf.op, value[1]));
+        return true;
+    }
+
+    void runCall(Context &ctx, Call &call) {
+        Stmt st = call.st;
+        if (!call.func) call.func = findFunction(ctx, st.str(0));
+        if (!call.func) return processPrint(ctx, st, StmtKind::PrintCall);
+        if (!call.compiled) call.compiled = &compileFunction(*call.func);
+        std::string res;
+        if (!call.compiled->direct || st.argCount() - 1 < call.func->params.size() ||
+            !callDirect(ctx, *call.compiled, *call.func, call, res)) {
+            std::vector<std::string> args = st.args(1);
+            try {
+                res = executeFunction(*call.func, args, ctx.functions, ctx.variables);
+            } catch (LoError &e) {
+                if (!e.line) e.line = st.line();
+                e.stack.push_back({sourceName(*call.func, st.str(0)), st.line()});
+                throw;
+            }
+        }
+        printValue(call.func->returnType, res);
+    }
+
+    const Code &code;
+    std::vector<Op> ops;
+    std::vector<int> lines; // per op, for errors raised below statement level
+    std::vector<Branch> branches;
+    Block main;
+    std::vector<std::pair<Op, int>> pending;
+    std::vector<Branch> pendingBranches;
+    // node payloads; deques keep the addresses the ops hold
+    std::deque<Binding> bindings;
+    std::deque<Chain> chains;
+    std::deque<Try> tries;
+    std::deque<Call> calls;
+    std::unordered_map<const FunctionDef *, CompiledFunction> functions;
+};
+
+}
+
+void runClosureCode(Context &ctx, const Code &code) {
+    Program(code).run(ctx);
+}
@@ -0,0 +1,339 @@
+#include "h/compiler.h"
+#include "h/generic.h"
+#include "h/jumptable.h"
+#include "h/utils.h"
+#include <algorithm>
+#include <regex>
+#include <set>
+#include <sstream>
+
+namespace {
+
+std::regex locRegex(R"(^loc\s+(\w+)\s*=\s*(int|str|bool|arr)\((.*)\)\s*!$)");
+std::regex constRegex(R"(^const\s+(\w+)\s*=\s*(int|str|bool)\((.*)\)\s*!$)");
+std::regex assignRegex(R"(^(\w+)\s*=\s*(.+)\!$)");
+std::regex inputRegex(R"(^(\w+)\s*=\s*input--\s*(i|str)-\s*\"([^\"]*)\"!$)");
+std::regex importRegex(R"(^import\s+\"([^\"]+)\"\s*!$)");
+std::regex useNativeRegex(R"(^use\s+native\s+\"([^\"]+)\"\s*!$)");
+std::regex printRegex(R"(^print--\s*(?:(\"([^\"]*)\")|(\w+)|f-(\w+)\(([^)]*)\))!$)");
+// groups: 2 = literal text, 3 = variable, 4 = func name, 5 = func args
+std::regex ifRegex(R"(if-\s*(\w+)\s*(>>|<<|===)\s*(\w+)\s*the)");
+std::regex elifRegex(R"(elif-\s*(\w+)\s*(>>|<<|===)\s*(\w+)\s*the)");
+std::regex catchRegex(R"(^catch-\s*(\w*)$)");
+std::regex matchRegex(R"(^match-\s*(\w+)\s*the$)");
+std::regex caseRegex(R"(^case-\s*(-?\d+|\"[^\"]*\")$)");
+
+// function bodies only understand int/str locals and return
+std::regex funLocRegex(R"(^loc\s+(\w+)\s*=\s*(int|str|[A-Z]\w*)\(([^)]*)\)\s*!$)");
+std::regex returnRegex(R"(^return\s+(.*)!$)");
+
+// Shorter if-/elif- chains are cheaper to test one by one.
+const size_t jumpTableMin = 4;
+
+// Functions are compiled in batches so tiny bodies do not drown in task overhead.
+const size_t functionBatch = 256;
+
+std::vector<std::string> splitArgs(const std::string& argsStr) {
+    std::vector<std::string> args;
+    std::stringstream ss(argsStr);
+    std::string a;
+    while (std::getline(ss, a, ',')) args.push_back(trim(a));
+    return args;
+}
+
+// a capture group as a view into the line it matched
+std::string_view view(const std::ssub_match& m) {
+    return m.length() ? std::string_view(&*m.first, m.length()) : std::string_view();
+}
+
+bool isNumber(const std::string& s) {
+    return !s.empty() && s.find_first_not_of("0123456789") == std::string::npos;
+}
+
+struct OpenBlock {
+    StmtKind kind;                // If, Try or Match
+    std::vector<uint32_t> branches; // if- and its elif-s, try- and its catch-, or match- and its case-s
+    int line;
+};
+
+class ModuleCompiler {
+public:
+    // Chunks after the first (the REPL) run against variables declared by
+    // earlier chunks, which this compiler never sees.
+    ModuleCompiler(Module& mod, bool allowCode, bool continued)
+        : mod(mod), allowCode(allowCode), continued(continued) {}
+
+    void compileLine(const std::string& ln, int lineno) {
+        std::smatch match;
+        if (!openBlocks.empty() && openBlocks.back().kind == StmtKind::Match && openBlocks.back().branches.size() == 1 &&
+            !startsWith(ln, "case-") && ln != "end--")
+            return error(lineno, "Expected case- after match-");
+        if (startsWith(ln, "if-")) {
+            if (!std::regex_match(ln, match, ifRegex)) return error(lineno, "Malformed if condition");
+            openBlocks.push_back({StmtKind::If, {mod.code.size()}, lineno});
+            emit(StmtKind::If, lineno, {view(match[1]), view(match[2]), view(match[3])});
+        } else if (startsWith(ln, "elif-")) {
+            if (openBlocks.empty() || openBlocks.back().kind != StmtKind::If) return error(lineno, "elif without if");
+            if (!std::regex_match(ln, match, elifRegex)) return error(lineno, "Malformed elif");
+            addBranch();
+            emit(StmtKind::Elif, lineno, {view(match[1]), view(match[2]), view(match[3])});
+        } else if (ln == "try-") {
+            openBlocks.push_back({StmtKind::Try, {mod.code.size()}, lineno});
+            emit(StmtKind::Try, lineno, {});
+        } else if (startsWith(ln, "catch-")) {
+            if (openBlocks.empty() || openBlocks.back().kind != StmtKind::Try || openBlocks.back().branches.size() > 1)
+                return error(lineno, "catch- without try-");
+            if (!std::regex_match(ln, match, catchRegex)) return error(lineno, "Malformed catch");
+            addBranch();
+            if (match[1].length()) emit(StmtKind::Catch, lineno, {view(match[1])});
+            else emit(StmtKind::Catch, lineno, {});
+        } else if (startsWith(ln, "match-")) {
+            if (!std::regex_match(ln, match, matchRegex)) return error(lineno, "Malformed match");
+            openBlocks.push_back({StmtKind::Match, {mod.code.size()}, lineno});
+            emit(StmtKind::Match, lineno, {view(match[1])});
+        } else if (startsWith(ln, "case-")) {
+            if (openBlocks.empty() || openBlocks.back().kind != StmtKind::Match) return error(lineno, "case- without match-");
+            if (!std::regex_match(ln, match, caseRegex)) return error(lineno, "Malformed case");
+            addBranch();
+            emit(StmtKind::Case, lineno, {view(match[1])});
+        } else if (ln == "end--") {
+            if (openBlocks.empty()) return error(lineno, "end-- without if");
+            if (openBlocks.back().kind == StmtKind::Try && openBlocks.back().branches.size() < 2)
+                error(openBlocks.back().line, "try- without catch-");
+            if (openBlocks.back().kind == StmtKind::Match && openBlocks.back().branches.size() < 2)
+                error(openBlocks.back().line, "match- without case-");
+            closeBlock(mod.code.size());
+            emit(StmtKind::End, lineno, {});
+        } else if (std::regex_match(ln, match, importRegex)) {
+            std::string path = canonicalPath(resolveImportPath(mod.path, match[1]));
+            mod.importPaths.push_back({path, lineno});
+            emit(StmtKind::Import, lineno, {path});
+        } else if (!allowCode) {
+            error(lineno, "only funS definitions and imports are allowed in a module");
+        } else if (std::regex_match(ln, match, useNativeRegex)) {
+            // a bare name is left to the dlopen search path
+            std::string path = match[1];
+            if (path.find('/') != std::string::npos) path = canonicalPath(resolveImportPath(mod.path, path));
+            emit(StmtKind::UseNative, lineno, {path});
+        } else if (std::regex_match(ln, match, constRegex)) {
+            if (!openBlocks.empty()) return error(lineno, "const must be declared outside blocks");
+            emit(StmtKind::Const, lineno, {view(match[1]), view(match[2]), trim(match[3])});
+        } else if (std::regex_match(ln, match, locRegex)) {
+            emit(StmtKind::Loc, lineno, {view(match[1]), view(match[2]), trim(match[3])});
+        } else if (std::regex_match(ln, match, inputRegex)) {
+            emit(StmtKind::Input, lineno, {view(match[1]), view(match[2]), view(match[3])});
+        } else if (std::regex_match(ln, match, assignRegex)) {
+            emit(StmtKind::Assign, lineno, {view(match[1]), trim(match[2])});
+        } else if (std::regex_match(ln, match, printRegex)) {
+            if (match[2].matched) {
+                emit(StmtKind::PrintText, lineno, {view(match[2])});
+            } else if (match[3].matched) {
+                emit(StmtKind::PrintVar, lineno, {view(match[3])});
+            } else {
+                std::vector<std::string> args = splitArgs(match[5]);
+                args.insert(args.begin(), match[4]);
+                emit(StmtKind::PrintCall, lineno, args);
+            }
+        } else {
+            mod.diagnostics.push_back({mod.path, lineno, "Syntax error: " + ln});
+        }
+    }
+
+    void finish() {
+        while (!openBlocks.empty()) {
+            StmtKind kind = openBlocks.back().kind;
+            error(openBlocks.back().line, kind == StmtKind::Try     ? "Missing end-- for try-"
+                                          : kind == StmtKind::Match ? "Missing end-- for match-"
+                                                                    : "Missing end-- for if-");
+            closeBlock(mod.code.size());
+        }
+        for (const auto& [open, endIndex] : chains) lowerChain(open, endIndex);
+    }
+
+private:
+    template <class Args>
+    void emit(StmtKind kind, int lineno, const Args& args) {
+        if (kind == StmtKind::Loc || kind == StmtKind::Const || kind == StmtKind::Input ||
+            (kind == StmtKind::Catch && args.size()))
+            declared.emplace(*args.begin());
+        mod.code.add(kind, lineno, args);
+    }
+
+    void emit(StmtKind kind, int lineno, std::initializer_list<std::string_view> args) {
+        emit<std::initializer_list<std::string_view>>(kind, lineno, args);
+    }
+
+    void error(int lineno, const std::string& msg) {
+        mod.diagnostics.push_back({mod.path, lineno, msg});
+    }
+
+    // links the previous branch of the innermost block to the statement about to be emitted
+    void addBranch() {
+        auto& open = openBlocks.back();
+        mod.code.setNext(open.branches.back(), mod.code.size());
+        open.branches.push_back(mod.code.size());
+    }
+
+    void closeBlock(uint32_t endIndex) {
+        auto& open = openBlocks.back();
+        mod.code.setNext(open.branches.back(), endIndex);
+        for (uint32_t b : open.branches) mod.code.setEnd(b, endIndex);
+        if (open.kind == StmtKind::Match) buildMatchTable(open, endIndex);
+        else if (open.kind == StmtKind::If && open.branches.size() >= jumpTableMin) chains.emplace_back(open, endIndex);
+        openBlocks.pop_back();
+    }
+
+    void buildMatchTable(const OpenBlock& open, uint32_t endIndex) {
+        auto table = std::make_shared<JumpTable>(endIndex);
+        std::set<std::string> seen;
+        for (size_t i = 1; i < open.branches.size(); ++i) {
+            Stmt c = mod.code[open.branches[i]];
+            std::string label = c.str(0);
+            bool text = label.front() == '"';
+            long long value = 0;
+            if (!text) {
+                try { value = std::stoll(label); }
+                catch (...) { error(c.line(), "Malformed case"); continue; }
+            }
+            std::string key = text ? label : std::to_string(value);
+            if (!seen.insert(key).second) error(c.line(), "Duplicate case " + label);
+            if (text) table->addString(stripQuotes(label), open.branches[i] + 1);
+            else table->addInt(value, open.branches[i] + 1);
+        }
+        table->build();
+        mod.code.setTable(open.branches.front(), std::move(table));
+    }
+
+    // `if- x === a the ... elif- x === b the ...` on a single variable
+    // dispatches through a table instead of comparing branch by branch. Runs
+    // once the whole module is known: a case word only needs a runtime check
+    // if a variable of that name is declared somewhere.
+    void lowerChain(const OpenBlock& open, uint32_t endIndex) {
+        std::string_view subject = mod.code[open.branches.front()].arg(0);
+        for (uint32_t b : open.branches) {
+            Stmt st = mod.code[b];
+            if (st.arg(1) != "===" || st.arg(0) != subject || st.arg(2) == subject) return;
+        }
+        auto table = std::make_shared<JumpTable>(endIndex);
+        std::vector<std::string> words;
+        for (uint32_t b : open.branches) {
+            std::string label = mod.code[b].str(2);
+            if (continued || declared.count(label)) words.push_back(label);
+            table->addString(label, b + 1);
+            long long value = 0;
+            bool number = isNumber(label);
+            if (number) {
+                try { value = std::stoll(label); }
+                catch (...) { number = false; }
+            }
+            if (number) table->addInt(value, b + 1);
+            else table->rejectInts();
+        }
+        table->guardNames(std::move(words));
+        table->build();
+        mod.code.setTable(open.branches.front(), std::move(table));
+    }
+
+    Module& mod;
+    bool allowCode;
+    bool continued;
+    std::vector<OpenBlock> openBlocks;
+    std::vector<std::pair<OpenBlock, uint32_t>> chains; // candidates for lowerChain
+    std::set<std::string> declared;
+};
+
+// Every statement comes from one line and its arguments from that line's
+// text (import paths aside), so the lines bound the arrays of the code.
+void reserveFor(Code& code, const std::vector<std::string>& lines) {
+    size_t args = 0, bytes = 0;
+    for (const auto& l : lines) {
+        args += std::max<size_t>(3, std::count(l.begin(), l.end(), ',') + 2);
+        bytes += l.size();
+    }
+    code.reserve(lines.size(), args, bytes);
+}
+
+// A funS loc may have a type variable of its own function as its type.
+bool declaresType(const FunctionDef& func, const std::string& type) {
+    return type == "int" || type == "str" || isTypeVariable(func, type);
+}
+
+}
+
+void compileFunction(FunctionDef& func) {
+    func.code.clear();
+    reserveFor(func.code, func.body);
+    for (size_t i = 0; i < func.body.size(); ++i) {
+        const std::string& line = func.body[i];
+        int lineno = func.line + 1 + static_cast<int>(i);
+        std::smatch match;
+        if (startsWith(line, "loc") && std::regex_match(line, match, funLocRegex) && declaresType(func, match[2])) {
+            func.code.add(StmtKind::Loc, lineno, {view(match[1]), view(match[2]), view(match[3])});
+        } else if (startsWith(line, "return") && std::regex_match(line, match, returnRegex)) {
+            func.code.add(StmtKind::Return, lineno, {view(match[1])});
+        }
+    }
+}
+
+void compileModule(Module& mod, const std::vector<std::string>& lines, bool allowCode, ThreadPool* pool,
+                   int firstLine) {
+    ModuleCompiler compiler(mod, allowCode, firstLine > 1);
+    reserveFor(mod.code, lines);
+    std::vector<FunctionDef*> functions;
+    bool inFunction = false;
+    std::string funcName;
+    FunctionDef func;
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::string ln = trim(lines[i]);
+        int lineno = static_cast<int>(i) + firstLine;
+        if (inFunction) {
+            if (ln == "}") {
+                auto res = mod.functions.insert_or_assign(funcName, std::move(func));
+                if (res.second) functions.push_back(&res.first->second);
+                inFunction = false;
+            } else {
+                func.body.push_back(ln);
+            }
+            continue;
+        }
+        if (ln.empty()) continue;
+        if (parseFunctionHeader(ln, funcName, func)) {
+            func.line = lineno;
+            inFunction = true;
+            continue;
+        }
+        compiler.compileLine(ln, lineno);
+    }
+    if (inFunction) mod.diagnostics.push_back({mod.path, func.line, "Unterminated funS " + funcName});
+    compiler.finish();
+
+    // mod.functions is complete here, so batches only touch their own entries.
+    for (size_t start = 0; start < functions.size(); start += functionBatch) {
+        size_t stop = std::min(start + functionBatch, functions.size());
+        std::vector<FunctionDef*> batch(functions.begin() + start, functions.begin() + stop);
+        auto job = [batch] {
+            for (FunctionDef* f : batch) compileFunction(*f);
+        };
+        if (pool) pool->submit(job);
+        else job();
+    }
+}
+
+void BlockTracker::feed(const std::string& ln) {
+    if (inFunction) {
+        if (ln == "}") inFunction = false;
+        return;
+    }
+    std::string name;
+    FunctionDef header;
+    if (startsWith(ln, "funS") && parseFunctionHeader(ln, name, header)) inFunction = true;
+    else if (startsWith(ln, "if-") || startsWith(ln, "match-") || ln == "try-") ++depth;
+    else if (ln == "end--" && depth > 0) --depth;
+}
+
+std::string formatDiagnostic(const Diagnostic& diag, const std::string& rootPath) {
+    std::string where = "line " + std::to_string(diag.line);
+    if (diag.file != rootPath) where = diag.line ? diag.file + ":" + std::to_string(diag.line) : diag.file;
+    return "Error at " + where + ": " + diag.message;
+}
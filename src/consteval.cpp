@@ -0,0 +1,205 @@
+#include "h/consteval.h"
+#include "h/compiler.h"
+#include "h/error.h"
+#include "h/evaluator.h"
+#include "h/executor.h"
+#include "h/output.h"
+#include "h/utils.h"
+#include <cctype>
+#include <regex>
+#include <set>
+
+namespace {
+
+std::regex callRegex(R"(^f-(\w+)\(([^)]*)\)$)");
+
+// statements plus return substitutions per compile-time call
+const long long constEvalBudget = 100000;
+
+bool isIntLiteral(const std::string& s) {
+    size_t start = !s.empty() && s[0] == '-' ? 1 : 0;
+    return s.size() > start && s.find_first_not_of("0123456789", start) == std::string::npos;
+}
+
+bool isQuoted(const std::string& s) {
+    return s.size() >= 2 && s.front() == '"' && s.back() == '"';
+}
+
+class ConstFolder {
+public:
+    ConstFolder(Module& mod, ConstTable& consts, const std::map<std::string, FunctionDef>* extra, bool foldCalls)
+        : mod(mod), consts(consts), extra(extra), foldCalls(foldCalls) {
+        for (const Stmt& st : mod.code) {
+            if (st.kind() == StmtKind::Loc || st.kind() == StmtKind::Input || st.kind() == StmtKind::Catch) {
+                if (st.argCount()) variables.insert(st.str(0));
+            }
+        }
+    }
+
+    void run() {
+        for (Stmt st : mod.code) {
+            switch (st.kind()) {
+                case StmtKind::Const:
+                    foldConst(st);
+                    break;
+                case StmtKind::Loc:
+                case StmtKind::Assign:
+                case StmtKind::Input:
+                    if (consts.count(st.str(0)))
+                        error(st.line(), (st.kind() == StmtKind::Loc ? "Cannot redeclare const "
+                                                                     : "Cannot assign to const ") + st.str(0));
+                    break;
+                case StmtKind::PrintVar: {
+                    auto it = consts.find(st.str(0));
+                    if (it != consts.end() && printFoldable(it->second.type))
+                        mod.code.replace(st.index(), StmtKind::PrintText, {it->second.value});
+                    break;
+                }
+                case StmtKind::PrintCall:
+                    if (foldCalls) foldPrintCall(st);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+private:
+    enum class Outcome { Done, Failed, OverBudget };
+
+    void error(int lineno, const std::string& msg) {
+        mod.diagnostics.push_back({mod.path, lineno, msg});
+    }
+
+    // what executeFunction would see for this argument at run time
+    bool constantArg(const std::string& arg) const {
+        if (consts.count(arg) || isQuoted(arg)) return true;
+        return isIntLiteral(arg) && !variables.count(arg);
+    }
+
+    const FunctionDef* compiled(const std::string& name) {
+        auto done = cache.find(name);
+        if (done != cache.end()) return &done->second;
+        const FunctionDef* def = nullptr;
+        auto it = mod.functions.find(name);
+        if (it != mod.functions.end()) def = &it->second;
+        else if (extra && extra->count(name)) def = &extra->at(name);
+        if (!def) return nullptr;
+        // the module's own copy may still be compiling on another thread
+        FunctionDef copy;
+        copy.returnType = def->returnType;
+        copy.params = def->params;
+        copy.typeParams = def->typeParams;
+        copy.body = def->body;
+        copy.line = def->line;
+        copy.instanceOf = def->instanceOf;
+        compileFunction(copy);
+        return &(cache[name] = std::move(copy));
+    }
+
+    Outcome call(const FunctionDef& func, const std::vector<std::string>& args, std::string& result) {
+        static const std::map<std::string, FunctionDef> none;
+        long long steps = constEvalBudget;
+        try {
+            result = executeFunction(func, args, none, consts, &steps);
+            return Outcome::Done;
+        } catch (const StepBudgetExceeded&) {
+            return Outcome::OverBudget;
+        } catch (const LoError& e) {
+            result = e.what();
+            return Outcome::Failed;
+        }
+    }
+
+    void foldPrintCall(Stmt st) {
+        std::vector<std::string> args = st.args(1);
+        for (const auto& arg : args) {
+            if (!constantArg(arg)) return;
+        }
+        const FunctionDef* func = compiled(st.str(0));
+        if (!func || !printFoldable(func->returnType)) return;
+        std::string result;
+        // failures are left to run time, where they are reported with a call stack
+        if (call(*func, args, result) == Outcome::Done) mod.code.replace(st.index(), StmtKind::PrintText, {result});
+    }
+
+    // int expressions may use earlier int constants
+    std::string substituteConsts(const std::string& raw) const {
+        std::string out;
+        for (size_t i = 0; i < raw.size();) {
+            if (std::isalpha(static_cast<unsigned char>(raw[i])) || raw[i] == '_') {
+                size_t j = i;
+                while (j < raw.size() && (std::isalnum(static_cast<unsigned char>(raw[j])) || raw[j] == '_')) ++j;
+                std::string word = raw.substr(i, j - i);
+                auto it = consts.find(word);
+                out += it != consts.end() ? it->second.value.str() : word;
+                i = j;
+            } else {
+                out += raw[i++];
+            }
+        }
+        return out;
+    }
+
+    void foldConst(Stmt st) {
+        const std::string name = st.str(0), type = st.str(1);
+        std::string raw = st.str(2);
+        if (consts.count(name)) error(st.line(), "Cannot redeclare const " + name);
+        std::string value;
+        std::smatch match;
+        if (std::regex_match(raw, match, callRegex)) {
+            std::string fname = match[1];
+            std::vector<std::string> args;
+            std::string argList = match[2];
+            for (size_t start = 0; !trim(argList).empty() && start <= argList.size();) {
+                size_t comma = argList.find(',', start);
+                args.push_back(trim(argList.substr(start, comma - start)));
+                if (comma == std::string::npos) break;
+                start = comma + 1;
+            }
+            for (const auto& arg : args) {
+                if (!constantArg(arg)) return error(st.line(), "Not a constant argument: " + arg);
+            }
+            const FunctionDef* func = compiled(fname);
+            if (!func) return error(st.line(), "Undefined function: " + fname);
+            if (!func->instanceOf.empty()) {
+                // report the call as written
+                raw.replace(2, fname.size(), func->instanceOf);
+                fname = func->instanceOf;
+            }
+            switch (call(*func, args, value)) {
+                case Outcome::Done: break;
+                case Outcome::Failed: return error(st.line(), value);
+                case Outcome::OverBudget:
+                    return error(st.line(), "Evaluating f-" + fname + " exceeded " + std::to_string(constEvalBudget) +
+                                          " steps");
+            }
+            if (type == "str") value = "\"" + value + "\"";
+        } else {
+            value = type == "int" ? evalExpression(substituteConsts(raw)) : raw;
+            auto ref = consts.find(raw);
+            if (type != "int" && ref != consts.end())
+                value = ref->second.type == "str" ? "\"" + ref->second.value + "\"" : ref->second.value.str();
+        }
+        if ((type == "int" && !isIntLiteral(value)) || (type == "str" && !isQuoted(value)) ||
+            (type == "bool" && value != "true" && value != "false" && value != "1" && value != "0"))
+            return error(st.line(), "Not a constant " + type + " value: " + raw);
+        if (type == "bool") value = value == "true" || value == "1" ? "true" : "false";
+
+        mod.code.replace(st.index(), StmtKind::Loc, {name, type, value});
+        consts[name] = {type, type == "str" ? value.substr(1, value.size() - 2) : value};
+    }
+
+    Module& mod;
+    ConstTable& consts;
+    const std::map<std::string, FunctionDef>* extra;
+    bool foldCalls;
+    std::set<std::string> variables; // names runtime code can declare
+    std::map<std::string, FunctionDef> cache;
+};
+
+}
+
+void foldConstants(Module& mod, ConstTable& consts, const std::map<std::string, FunctionDef>* extra, bool foldCalls) {
+    ConstFolder(mod, consts, extra, foldCalls).run();
+}
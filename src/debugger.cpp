@@ -0,0 +1,271 @@
+#include "h/debugger.h"
+#include "h/utils.h"
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+Debugger* activeDebugger = nullptr;
+
+StmtKind debugTrap(const Stmt& st, const FunctionDef* func, const std::unordered_map<std::string, Variable>* locals) {
+    return activeDebugger->trap(st, func, locals);
+}
+
+namespace {
+
+// elif-/case-/catch-/end-- are jump targets the executors inspect by kind,
+// so they are never trapped; breakpoints on them move to the next statement.
+bool trappable(const Stmt& st) {
+    return st.kind() != StmtKind::Elif && st.kind() != StmtKind::Case && st.kind() != StmtKind::Catch &&
+           st.kind() != StmtKind::End;
+}
+
+// Statements are reached through const views, but every Code the debugger
+// traps belongs to the root module or ctx.functions, both mutable.
+void setKind(const Stmt& st, StmtKind kind) {
+    const_cast<Code&>(st.code()).setKind(st.index(), kind);
+}
+
+bool isNumber(const std::string& s) {
+    return !s.empty() && s.find_first_not_of("0123456789") == std::string::npos;
+}
+
+// Imported functions are normally linked on first call. The debugger links
+// them up front so breakpoints and stepping can reach their code.
+void linkAll(Context& ctx, const Module* mod, std::set<const Module*>& seen) {
+    if (!mod || !seen.insert(mod).second) return;
+    for (const auto& [name, func] : mod->functions) {
+        if (!ctx.functions.count(name)) ctx.functions[name] = func;
+    }
+    for (const Module* dep : mod->imports) linkAll(ctx, dep, seen);
+}
+
+}
+
+Debugger::Debugger(Context& ctx, Module& root) : ctx(ctx), root(root) {
+    std::ifstream file(root.path);
+    std::string line;
+    while (std::getline(file, line)) source.push_back(line);
+
+    std::set<const Module*> seen{&root};
+    for (const Module* dep : root.imports) linkAll(ctx, dep, seen);
+
+    for (Stmt st : root.code) {
+        if (st.kind() == StmtKind::PrintCall) callSites.push_back(st);
+    }
+    reinstall();
+}
+
+void Debugger::start() {
+    std::cout << "lomake debugger: " << root.path << " (type 'help' for commands)" << std::endl;
+    std::string line;
+    for (;;) {
+        std::cout << "(lodb) " << std::flush;
+        if (!std::getline(std::cin, line)) return;
+        if (command(trim(line))) return;
+    }
+}
+
+StmtKind Debugger::trap(const Stmt& st, const FunctionDef* func,
+                        const std::unordered_map<std::string, Variable>* locals) {
+    const Stmt& key = st;
+    StmtKind kind = original.at(key);
+    if (func) {
+        if (func != currentFunc) {
+            currentFuncName.clear();
+            for (const auto& [name, def] : ctx.functions) {
+                if (&def == func) currentFuncName = name;
+            }
+        }
+        currentFunc = func;
+        currentLocals = locals;
+    } else {
+        callSiteLine = kind == StmtKind::PrintCall ? st.line() : 0;
+        currentFunc = nullptr;
+        currentLocals = nullptr;
+    }
+    currentLine = st.line();
+
+    bool stop = breakpoints.count(key) || mode == Mode::Step ||
+                ((mode == Mode::Next || mode == Mode::Finish) && !func);
+    if (stop) {
+        if (breakpoints.count(key)) std::cout << "Breakpoint " << breakpoints[key] << ", ";
+        prompt(st);
+    }
+    return kind;
+}
+
+void Debugger::prompt(const Stmt& st) {
+    if (currentFunc) std::cout << "in f-" << currentFuncName << ", ";
+    std::cout << "line " << st.line() << ":" << std::endl;
+    showLine(st.line());
+    std::string line;
+    for (;;) {
+        std::cout << "(lodb) " << std::flush;
+        if (!std::getline(std::cin, line)) {
+            // no more commands: let the program finish undisturbed
+            breakpoints.clear();
+            setMode(Mode::Continue);
+            return;
+        }
+        if (command(trim(line))) return;
+    }
+}
+
+bool Debugger::command(const std::string& line) {
+    std::istringstream in(line);
+    std::string cmd, arg;
+    in >> cmd >> arg;
+    if (cmd.empty()) return false;
+
+    if (cmd == "c" || cmd == "continue" || cmd == "r" || cmd == "run") {
+        setMode(Mode::Continue);
+        return true;
+    } else if (cmd == "s" || cmd == "step") {
+        setMode(Mode::Step);
+        return true;
+    } else if (cmd == "n" || cmd == "next") {
+        // functions cannot call functions, so inside one next is a step
+        setMode(currentFunc ? Mode::Step : Mode::Next);
+        return true;
+    } else if (cmd == "finish") {
+        if (!currentFunc) {
+            std::cout << "not inside a function" << std::endl;
+            return false;
+        }
+        setMode(Mode::Finish);
+        return true;
+    } else if (cmd == "b" || cmd == "break") {
+        breakAt(arg);
+    } else if (cmd == "d" || cmd == "delete") {
+        deleteBreakpoint(arg);
+    } else if (cmd == "info") {
+        for (const auto& [st, name] : breakpoints)
+            std::cout << "breakpoint " << name << " at line " << st.line() << std::endl;
+    } else if (cmd == "p" || cmd == "print") {
+        printVariable(arg);
+    } else if (cmd == "locals") {
+        if (!currentLocals) std::cout << "not inside a function" << std::endl;
+        else for (const auto& [name, var] : *currentLocals)
+            std::cout << name << " = " << var.type << "(" << var.value << ")" << std::endl;
+    } else if (cmd == "globals") {
+        for (const auto& [name, var] : ctx.variables)
+            std::cout << name << " = " << var.type << "(" << var.value << ")" << std::endl;
+    } else if (cmd == "bt" || cmd == "backtrace") {
+        printBacktrace();
+    } else if (cmd == "l" || cmd == "list") {
+        int from = std::max(1, currentLine - 3);
+        for (int l = from; l <= currentLine + 3 && l <= static_cast<int>(source.size()); ++l) {
+            std::cout << (l == currentLine ? "=> " : "   ") << l << "\t" << source[l - 1] << std::endl;
+        }
+    } else if (cmd == "q" || cmd == "quit") {
+        std::exit(0);
+    } else if (cmd == "h" || cmd == "help") {
+        std::cout << "run/continue (c), step (s), next (n), finish, break (b) LINE|FUNC, delete (d) LINE|FUNC,\n"
+                     "info, print (p) NAME, locals, globals, backtrace (bt), list (l), quit (q)" << std::endl;
+    } else {
+        std::cout << "unknown command: " << cmd << std::endl;
+    }
+    return false;
+}
+
+void Debugger::breakAt(const std::string& where) {
+    std::optional<Stmt> target;
+    if (isNumber(where)) {
+        int line = std::stoi(where);
+        auto consider = [&](Stmt st) {
+            if (trappable(st) && st.line() >= line && (!target || st.line() < target->line())) target = st;
+        };
+        for (Stmt st : root.code) consider(st);
+        for (const auto& [name, unused] : root.functions) {
+            for (Stmt st : ctx.functions[name].code) consider(st);
+        }
+    } else if (ctx.functions.count(where)) {
+        auto& code = ctx.functions[where].code;
+        if (code.empty()) {
+            std::cout << "f-" << where << " has no statements" << std::endl;
+            return;
+        }
+        target = code.front();
+    }
+    if (!target) {
+        std::cout << "no statement at " << where << std::endl;
+        return;
+    }
+    breakpoints[*target] = where;
+    reinstall();
+    std::cout << "breakpoint " << where << " at line " << target->line() << std::endl;
+}
+
+void Debugger::deleteBreakpoint(const std::string& where) {
+    for (auto it = breakpoints.begin(); it != breakpoints.end(); ++it) {
+        if (it->second == where) {
+            breakpoints.erase(it);
+            reinstall();
+            return;
+        }
+    }
+    std::cout << "no breakpoint " << where << std::endl;
+}
+
+void Debugger::printVariable(const std::string& name) const {
+    const Variable* var = nullptr;
+    if (currentLocals && currentLocals->count(name)) var = &currentLocals->at(name);
+    else if (ctx.variables.count(name)) var = &ctx.variables.at(name);
+    if (!var) std::cout << "no variable " << name << std::endl;
+    else std::cout << name << " = " << var->type << "(" << var->value << ")" << std::endl;
+}
+
+void Debugger::printBacktrace() const {
+    int frame = 0;
+    if (currentFunc) {
+        std::cout << "#" << frame++ << " f-" << currentFuncName << " at line " << currentLine << std::endl;
+        if (callSiteLine) std::cout << "#" << frame++ << " main at line " << callSiteLine << std::endl;
+    } else {
+        std::cout << "#" << frame++ << " main at line " << currentLine << std::endl;
+    }
+}
+
+void Debugger::showLine(int line) const {
+    if (line >= 1 && line <= static_cast<int>(source.size()))
+        std::cout << "=> " << line << "\t" << trim(source[line - 1]) << std::endl;
+}
+
+void Debugger::setMode(Mode next) {
+    mode = next;
+    reinstall();
+}
+
+// Brings the set of trapped statements in line with the breakpoints and the
+// current stepping mode, restoring every statement that no longer needs it.
+void Debugger::reinstall() {
+    std::set<Stmt> wanted;
+    for (const auto& [st, name] : breakpoints) wanted.insert(st);
+    wanted.insert(callSites.begin(), callSites.end());
+    if (mode != Mode::Continue) {
+        for (Stmt st : root.code) wanted.insert(st);
+    }
+    if (mode == Mode::Step) {
+        for (auto& [name, func] : ctx.functions) {
+            for (Stmt st : func.code) wanted.insert(st);
+        }
+    }
+
+    for (auto it = original.begin(); it != original.end();) {
+        if (!wanted.count(it->first)) {
+            setKind(it->first, it->second);
+            it = original.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (const Stmt& st : wanted) install(st);
+}
+
+void Debugger::install(const Stmt& st) {
+    if (original.count(st) || !trappable(st)) return;
+    original[st] = st.kind();
+    setKind(st, StmtKind::Trap);
+}
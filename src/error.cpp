@@ -0,0 +1,12 @@
+#include "h/error.h"
+
+void raiseError(ErrorCode code, int lineno, const std::string& msg) {
+    throw LoError(code, lineno, msg);
+}
+
+std::string formatError(const LoError& err) {
+    std::string out = "Error at line " + std::to_string(err.line) + ": " + err.what();
+    for (const auto& frame : err.stack)
+        out += "\n    in f-" + frame.function + " called at line " + std::to_string(frame.line);
+    return out;
+}
@@ -1,7 +1,9 @@
 #include "h/evaluator.h"
 #include "h/utils.h"
-#include <regex>
+#include "h/error.h"
+#include <cctype>
 #include <cmath>
+#include <cstring>
 
 bool evaluateCondition(const std::unordered_map<std::string, Variable>& vars,
                       const std::string& lhs,
@@ -42,28 +44,48 @@ long long safeStoll(const std::string& s) {
     try {
         return std::stoll(s);
     } catch (...) {
-        throw std::runtime_error("Invalid integer: " + s);
+        raiseError(ErrorCode::InvalidValue, 0, "Invalid integer: " + s);
     }
 }
 
-std::string evalExpression(const std::string& expr) {
-    std::smatch match;
-    std::regex mathRegex(R"(^(\d+)\s*([\+\-\*/%\^])\s*(\d+)$)");
-    if (std::regex_match(expr, match, mathRegex)) {
-        long long left = safeStoll(match[1]);
-        char op = match[2].str()[0];
-        long long right = safeStoll(match[3]);
-
-        long long result = 0;
-        switch (op) {
-            case '+': result = left + right; break;
-            case '-': result = left - right; break;
-            case '*': result = left * right; break;
-            case '/': result = right != 0 ? left / right : 0; break;
-            case '%': result = right != 0 ? left % right : 0; break;
-            case '^': result = std::pow(left, right); break;
-        }
-        return std::to_string(result);
+long long applyOperator(long long left, char op, long long right) {
+    switch (op) {
+        case '+': return left + right;
+        case '-': return left - right;
+        case '*': return left * right;
+        case '/': return right != 0 ? left / right : 0;
+        case '%': return right != 0 ? left % right : 0;
+        case '^': return std::pow(left, right);
     }
-    return expr;
+    return 0;
+}
+
+namespace {
+
+size_t skipDigits(const std::string& s, size_t i) {
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9') ++i;
+    return i;
+}
+
+size_t skipSpaces(const std::string& s, size_t i) {
+    while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) ++i;
+    return i;
+}
+
+}
+
+// Accepts exactly ^(\d+)\s*([+\-*\/%^])\s*(\d+)$, scanned by hand: this runs for
+// every int loc and assignment, and a regex match costs more than the rest
+// of the statement.
+std::string evalExpression(const std::string& expr) {
+    size_t leftEnd = skipDigits(expr, 0);
+    if (leftEnd == 0) return expr;
+    size_t opPos = skipSpaces(expr, leftEnd);
+    if (opPos == expr.size() || expr[opPos] == '\0' || !std::strchr("+-*/%^", expr[opPos])) return expr;
+    size_t rightBegin = skipSpaces(expr, opPos + 1);
+    size_t rightEnd = skipDigits(expr, rightBegin);
+    if (rightEnd == rightBegin || rightEnd != expr.size()) return expr;
+    long long left = safeStoll(expr.substr(0, leftEnd));
+    long long right = safeStoll(expr.substr(rightBegin));
+    return std::to_string(applyOperator(left, expr[opPos], right));
 }
\ No newline at end of file
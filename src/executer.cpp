@@ -1,44 +1,107 @@
 #include "h/executor.h"
 #include "h/evaluator.h"
 #include "h/utils.h"
-#include <regex>
+#include "h/error.h"
+#include "h/debugger.h"
+#include "h/quicken.h"
+#include "h/specialize.h"
+#include "h/memo.h"
+#include "h/stats.h"
+
+namespace {
+
+std::string runBody(const FunctionDef& func, std::unordered_map<std::string, Variable>& localVars,
+                    long long* steps);
+
+}
 
 std::string executeFunction(const FunctionDef& func,
                            const std::vector<std::string>& args,
                            const std::map<std::string, FunctionDef>& functions,
-                           const std::unordered_map<std::string, Variable>& globalVars) {
+                           const std::unordered_map<std::string, Variable>& globalVars,
+                           long long* steps) {
+    if (args.size() < func.params.size())
+        raiseError(ErrorCode::WrongArgCount, 0, "Wrong argument count: expected " +
+                   std::to_string(func.params.size()) + ", got " + std::to_string(args.size()));
     std::unordered_map<std::string, Variable> localVars;
     for (size_t i = 0; i < func.params.size(); ++i) {
-        std::string value = args[i];
-        if (value.front() != '"' && localVars.count(value) == 0 && globalVars.count(value)) {
-            value = globalVars.at(value).value;
-        }
-        localVars[func.params[i].second] = { func.params[i].first, value };
+        const std::string& arg = args[i];
+        auto global = arg.front() != '"' && localVars.count(arg) == 0 ? globalVars.find(arg) : globalVars.end();
+        // a global is shared, not copied
+        localVars[func.params[i].second] = { func.params[i].first, global != globalVars.end() ? global->second.value : Text(arg) };
+    }
+    if (func.generic) {
+        std::vector<std::string> values;
+        for (const auto& param : func.params) values.push_back(localVars[param.second].value);
+        if (!specializationHolds(func, values))
+            return executeFunction(*func.generic, genericArgs(func, args), functions, globalVars, steps);
     }
 
-    for (const auto& line : func.body) {
-        std::smatch match;
-        std::regex locRegex(R"(^loc\s+(\w+)\s*=\s*(int|str)\(([^)]*)\)\s*!$)");
-        std::regex returnRegex(R"(^return\s+(.*)!$)");
-
-        if (std::regex_match(line, match, locRegex)) {
-            std::string name = match[1], type = match[2], val = match[3];
-            if (type == "str" && val.front() == '"' && val.back() == '"')
-                val = val.substr(1, val.size() - 2);
-            else if (type == "int")
-                val = evalExpression(val);
-            localVars[name] = {type, val};
-        } else if (std::regex_match(line, match, returnRegex)) {
-            std::string ret = match[1];
-            for (const auto& [name, var] : localVars) {
-                size_t pos;
-                while ((pos = ret.find(name)) != std::string::npos) {
-                    ret.replace(pos, name.length(), var.value);
+    // compile-time evaluation and the debugger want the body to run
+    if (!activeMemo || !func.memoId || steps || activeDebugger) return runBody(func, localVars, steps);
+    std::vector<std::string> values;
+    for (const auto& param : func.params) values.push_back(localVars[param.second].value);
+    std::string key = memoKey(func, values), result;
+    // --auto-parallel workers count too
+    if (activeMemo->find(key, result)) {
+        __atomic_fetch_add(&stats.memoHits, 1, __ATOMIC_RELAXED);
+        return result;
+    }
+    __atomic_fetch_add(&stats.memoMisses, 1, __ATOMIC_RELAXED);
+    result = runBody(func, localVars, steps);
+    activeMemo->insert(key, result);
+    return result;
+}
+
+namespace {
+
+std::string runBody(const FunctionDef& func, std::unordered_map<std::string, Variable>& localVars,
+                    long long* steps) {
+    auto step = [steps] {
+        if (steps && --*steps < 0) throw StepBudgetExceeded{};
+    };
+    for (Stmt st : func.code) {
+        step();
+        StmtKind kind = st.kind();
+    dispatch:
+        switch (kind) {
+            case StmtKind::Loc: {
+                std::string name = st.str(0), type = st.str(1);
+                if (!steps) {
+                    localVars[name] = {type, quickLocValue(st)};
+                    break;
                 }
+                std::string val = st.str(2);
+                if (type == "str" && val.front() == '"' && val.back() == '"')
+                    val = val.substr(1, val.size() - 2);
+                else if (type == "int")
+                    val = evalExpression(val);
+                localVars[name] = {type, val};
+                break;
             }
-            return evalExpression(ret);
+            case StmtKind::Return: {
+                // compile-time evaluation runs on private copies; leave them unquickened
+                std::string ret;
+                if (!steps && quickReturn(func, st, localVars, ret)) return ret;
+                ret = st.str(0);
+                for (const auto& [name, var] : localVars) {
+                    size_t pos;
+                    while ((pos = ret.find(name)) != std::string::npos) {
+                        step();
+                        ret.replace(pos, name.length(), var.value);
+                    }
+                }
+                return evalExpression(ret);
+            }
+            case StmtKind::Trap:
+                kind = debugTrap(st, &func, &localVars);
+                goto dispatch;
+            default:
+                break;
         }
     }
 
     return "";
-}
\ No newline at end of file
+}
+
+}
@@ -0,0 +1,237 @@
+#include "h/generic.h"
+#include "h/compiler.h"
+#include "h/stats.h"
+#include "h/utils.h"
+#include <algorithm>
+#include <functional>
+#include <regex>
+#include <set>
+
+namespace {
+
+using FunctionMap = std::map<std::string, FunctionDef>;
+
+std::regex callRegex(R"(^f-(\w+)\(([^)]*)\)$)");
+std::regex typedLocRegex(R"(^(loc\s+\w+\s*=\s*)(\w+)(\(.*)$)");
+
+bool isIntLiteral(const std::string& s) {
+    size_t start = !s.empty() && s[0] == '-' ? 1 : 0;
+    return s.size() > start && s.find_first_not_of("0123456789", start) == std::string::npos;
+}
+
+bool isQuoted(const std::string& s) {
+    return s.size() >= 2 && s.front() == '"' && s.back() == '"';
+}
+
+// A funS a call resolves to and the map holding it, where its instances go.
+struct Found {
+    FunctionMap* owner = nullptr;
+    const FunctionDef* def = nullptr;
+};
+
+Found findInModule(const Module* mod, const std::string& name, std::set<const Module*>& seen) {
+    if (!mod || mod->failed || !seen.insert(mod).second) return {};
+    auto& functions = const_cast<Module*>(mod)->functions;
+    auto it = functions.find(name);
+    if (it != functions.end()) return {&functions, &it->second};
+    for (const Module* dep : mod->imports) {
+        Found found = findInModule(dep, name, seen);
+        if (found.def) return found;
+    }
+    return {};
+}
+
+class Monomorphizer {
+public:
+    using Lookup = std::function<Found(const std::string&)>;
+
+    Monomorphizer(Module& mod, Lookup lookup) : mod(mod), lookup(std::move(lookup)) {}
+
+    void declare(const std::string& name, const std::string& type) {
+        auto [it, fresh] = types.emplace(name, type);
+        if (!fresh && it->second != type) it->second.clear(); // depends on the path taken
+    }
+
+    void run() {
+        for (Stmt st : mod.code) {
+            switch (st.kind()) {
+                case StmtKind::Loc:
+                    declare(st.str(0), st.str(1));
+                    break;
+                case StmtKind::Const:
+                    rewriteConst(st);
+                    declare(st.str(0), st.str(1));
+                    break;
+                case StmtKind::Input:
+                    declare(st.str(0), st.str(1) == "i" ? "int" : "str");
+                    break;
+                case StmtKind::Catch:
+                    if (st.argCount()) declare(st.str(0), "str");
+                    break;
+                case StmtKind::PrintCall: {
+                    std::vector<std::string> args = st.args();
+                    std::string name = instanceFor(st.line(), args.front(), {args.begin() + 1, args.end()});
+                    if (name.empty()) break;
+                    args.front() = name;
+                    mod.code.replace(st.index(), StmtKind::PrintCall, args);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+private:
+    void error(int lineno, const std::string& msg) {
+        mod.diagnostics.push_back({mod.path, lineno, msg});
+    }
+
+    void rewriteConst(Stmt st) {
+        std::smatch match;
+        std::string raw = st.str(2);
+        if (!std::regex_match(raw, match, callRegex)) return;
+        std::vector<std::string> args;
+        std::string argList = match[2];
+        for (size_t start = 0; !trim(argList).empty() && start <= argList.size();) {
+            size_t comma = argList.find(',', start);
+            args.push_back(trim(argList.substr(start, comma - start)));
+            if (comma == std::string::npos) break;
+            start = comma + 1;
+        }
+        std::string name = instanceFor(st.line(), match[1], args);
+        if (name.empty()) return;
+        std::string call = "f-" + name + "(";
+        for (size_t i = 0; i < args.size(); ++i) call += (i ? ", " : "") + args[i];
+        mod.code.replace(st.index(), StmtKind::Const, {st.str(0), st.str(1), call + ")"});
+    }
+
+    // What executeFunction binds argument `i` to, typed from the
+    // declarations seen so far; empty when that is not known.
+    std::string argType(const FunctionDef& func, const std::vector<std::string>& args, size_t i) const {
+        const std::string& arg = args[i];
+        if (isQuoted(arg)) return "str";
+        for (size_t j = 0; j < i; ++j) {
+            if (func.params[j].second == arg) return ""; // bound to the text, not the variable
+        }
+        auto it = types.find(arg);
+        if (it != types.end()) return it->second;
+        if (isIntLiteral(arg)) return "int";
+        if (arg == "true" || arg == "false") return "bool";
+        return "";
+    }
+
+    // The instance a call of `fname` goes to; empty when the call stays as
+    // it is or cannot be instantiated.
+    std::string instanceFor(int lineno, const std::string& fname, const std::vector<std::string>& args) {
+        Found found = lookup(fname);
+        if (!found.def || !isGeneric(*found.def)) return "";
+        const FunctionDef& func = *found.def;
+        if (args.size() < func.params.size()) return ""; // run time reports the count
+        std::map<std::string, std::string> binding;
+        std::vector<std::string> order;
+        for (size_t i = 0; i < func.params.size(); ++i) {
+            const std::string& var = func.params[i].first;
+            if (!isTypeVariable(func, var)) continue;
+            std::string type = argType(func, args, i);
+            if (type.empty()) {
+                error(lineno, "Cannot infer " + var + " of f-" + fname + " from argument " + args[i]);
+                return "";
+            }
+            auto [it, fresh] = binding.emplace(var, type);
+            if (fresh) order.push_back(var);
+            else if (it->second != type) {
+                error(lineno, "Conflicting types for " + var + " in f-" + fname + ": " + it->second + " and " + type);
+                return "";
+            }
+        }
+        for (const auto& var : func.typeParams) {
+            if (binding.count(var)) continue;
+            error(lineno, "Cannot infer " + var + " of f-" + fname + ": no parameter has that type");
+            return "";
+        }
+        for (size_t i = 0; i < func.body.size(); ++i) {
+            std::smatch match;
+            if (!std::regex_match(func.body[i], match, typedLocRegex) || !binding.count(match[2])) continue;
+            const std::string& type = binding.at(match[2]);
+            if (type != "int" && type != "str") {
+                error(lineno, "Cannot instantiate f-" + fname + " with " + match[2].str() + " = " + type +
+                                  ": funS locals are int or str");
+                return "";
+            }
+        }
+
+        std::string name = fname;
+        for (const auto& var : order) name += "__" + binding.at(var);
+        for (;; name += "_") {
+            auto it = found.owner->find(name);
+            if (it != found.owner->end()) {
+                // made for another call already, unless the name is taken
+                if (it->second.instanceOf == fname && lookup(name).def == &it->second) return name;
+            } else if (!lookup(name).def) {
+                break;
+            }
+        }
+
+        FunctionDef inst;
+        auto concrete = [&binding](const std::string& type) {
+            auto it = binding.find(type);
+            return it == binding.end() ? type : it->second;
+        };
+        inst.returnType = concrete(func.returnType);
+        for (const auto& [type, pname] : func.params) inst.params.emplace_back(concrete(type), pname);
+        for (const auto& line : func.body) {
+            std::smatch match;
+            if (std::regex_match(line, match, typedLocRegex) && binding.count(match[2]))
+                inst.body.push_back(match[1].str() + binding.at(match[2]) + match[3].str());
+            else
+                inst.body.push_back(line);
+        }
+        inst.line = func.line;
+        inst.instanceOf = fname;
+        compileFunction(inst);
+        found.owner->emplace(name, std::move(inst));
+        ++stats.instances;
+        return name;
+    }
+
+    Module& mod;
+    Lookup lookup;
+    std::map<std::string, std::string> types; // declared so far; empty: more than one type
+};
+
+}
+
+bool isTypeVariable(const FunctionDef& func, const std::string& type) {
+    return std::find(func.typeParams.begin(), func.typeParams.end(), type) != func.typeParams.end();
+}
+
+bool isGeneric(const FunctionDef& func) {
+    return !func.typeParams.empty();
+}
+
+void instantiateGenerics(Module& mod) {
+    Monomorphizer(mod, [&mod](const std::string& name) {
+        std::set<const Module*> seen;
+        return findInModule(&mod, name, seen);
+    }).run();
+}
+
+void instantiateGenerics(Module& chunk, FunctionMap& functions,
+                         const std::unordered_map<std::string, Variable>& variables,
+                         const std::vector<const Module*>& imports) {
+    Monomorphizer mono(chunk, [&](const std::string& name) -> Found {
+        for (FunctionMap* map : {&chunk.functions, &functions}) {
+            auto it = map->find(name);
+            if (it != map->end()) return {map, &it->second};
+        }
+        std::set<const Module*> seen;
+        for (const Module* mod : imports) {
+            Found found = findInModule(mod, name, seen);
+            if (found.def) return found;
+        }
+        return {};
+    });
+    for (const auto& [name, var] : variables) mono.declare(name, var.type);
+    mono.run();
+}
@@ -0,0 +1,25 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <cstddef>
+
+// The allocator behind operator new. Lo values are strings and hash map
+// nodes, almost all of them under a kilobyte, so --allocator=lo serves
+// those from size classes: 64 KB spans of one class carved out of a single
+// reserved region, with a free list per class for each thread. A thread
+// hands blocks back to the shared lists in batches once it holds too many,
+// and all of them when it exits. Larger blocks, and every block under the
+// default --allocator=system, come from malloc; frees tell the two apart by
+// address, so memory allocated before the switch is freed where it came
+// from.
+enum class AllocatorKind { System, Lo };
+
+// Switches new allocations to `kind`; false when the region for lo cannot
+// be reserved, which leaves the system allocator in place.
+bool selectAllocator(AllocatorKind kind);
+
+bool loAllocatorActive();
+size_t loAllocatorSpans();     // carved so far
+size_t loAllocatorTransfers(); // batches moved between threads and the shared lists
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef CHECKER_H
+#define CHECKER_H
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "diagnostic.h"
+#include "function.h"
+#include "module.h"
+
+using FunctionLookup = std::function<const FunctionDef*(const std::string&)>;
+// Type of a variable declared before the checked code, or nullptr.
+using VariableLookup = std::function<const std::string*(const std::string&)>;
+
+// Checks top-level code. Declarations carry over between checkCode calls,
+// so a program can be fed piece by piece (the LSP server does that with
+// its cached blocks). Line numbers are shifted by `lineOffset`.
+class CodeChecker {
+public:
+    CodeChecker(const std::string& path, FunctionLookup lookup, std::vector<Diagnostic>& out);
+
+    void checkCode(const Code& code, int lineOffset = 0);
+
+    // Declarations made by code that is not fed to this checker; used when
+    // only a slice of a program is rechecked.
+    void setOuterScope(VariableLookup outerVars, bool natives);
+
+private:
+    void checkStmt(const Stmt& st);
+    void checkCall(const Stmt& st);
+    void checkCondition(const Stmt& st);
+    void nextBranch();
+    const std::string* typeOf(const std::string& name) const;
+    bool requireVar(const Stmt& st, const std::string& name);
+    void error(int lineno, const std::string& msg);
+
+    std::string path;
+    FunctionLookup lookup;
+    std::vector<Diagnostic>& out;
+    std::unordered_map<std::string, std::string> vars;
+    VariableLookup outer;
+    std::vector<std::string> subjects; // per open block: the match- variable, empty for if-/try-
+    struct Branches {
+        std::unordered_map<std::string, std::string> entry;  // declared before the block
+        std::unordered_map<std::string, std::string> merged; // declared by finished branches
+    };
+    std::vector<Branches> branches; // per open block
+    bool hasNatives = false;
+    int offset = 0;
+};
+
+// A function body only depends on itself, so its findings can be cached.
+void checkFunction(const std::string& path, const FunctionDef& func, std::vector<Diagnostic>& out,
+                   int lineOffset = 0);
+
+// Static checks on compiled code; findings are appended to mod.diagnostics.
+// Never executes anything, so it is safe on untrusted scripts.
+void checkModule(Module& mod);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef CLOSURE_H
+#define CLOSURE_H
+
+#include <vector>
+#include "context.h"
+#include "statement.h"
+
+// Alternative to runCode (--engine=closure). The compiled statements are
+// turned once into a tree of pre-bound callables: each node holds its
+// operands already resolved and owns its child blocks directly, so running
+// the program is a chain of indirect calls with no dispatch on kinds.
+// Behaviour, output and errors are the same as runCode's; the debugger
+// works only with runCode.
+void runClosureCode(Context &ctx, const Code &code);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <string>
+#include <vector>
+#include "function.h"
+#include "module.h"
+#include "threadpool.h"
+
+// Compiles a function body into executable statements.
+void compileFunction(FunctionDef& func);
+
+// Splits `lines` into function definitions and top-level code of `mod`,
+// resolving if-/elif-/end-- jumps. Top-level statements other than imports
+// are rejected unless `allowCode`. Function bodies are compiled on `pool`
+// when one is given, otherwise inline. `firstLine` numbers lines[0], so
+// chunks of a longer input (the REPL) keep their real line numbers.
+void compileModule(Module& mod, const std::vector<std::string>& lines, bool allowCode, ThreadPool* pool,
+                   int firstLine = 1);
+
+// Tracks whether the lines fed so far form complete top-level units: a
+// statement, a whole if-/try- block or a whole funS definition.
+class BlockTracker {
+public:
+    void feed(const std::string& trimmedLine);
+    bool complete() const { return !inFunction && depth == 0; }
+
+private:
+    bool inFunction = false;
+    int depth = 0;
+};
+
+std::string formatDiagnostic(const Diagnostic& diag, const std::string& rootPath);
+
+#endif
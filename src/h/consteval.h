@@ -0,0 +1,24 @@
+#ifndef CONSTEVAL_H
+#define CONSTEVAL_H
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include "function.h"
+#include "module.h"
+#include "variable.h"
+
+// Constants declared so far; the REPL carries them from chunk to chunk.
+using ConstTable = std::unordered_map<std::string, Variable>;
+
+// Evaluates `const` declarations and turns them into plain loc statements
+// holding literals. print-- calls of funS with constant arguments and
+// print-- of constants are replaced by their output. Calls get a step
+// budget; one that runs out is left for run time (or reported, for a
+// const). funS are looked up in `mod` and then in `extra`. Problems are
+// appended to mod.diagnostics. Without `foldCalls` print-- calls are kept,
+// so the debugger still stops inside the funS.
+void foldConstants(Module& mod, ConstTable& consts, const std::map<std::string, FunctionDef>* extra = nullptr,
+                   bool foldCalls = true);
+
+#endif
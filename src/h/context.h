@@ -0,0 +1,22 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include "variable.h"
+#include "function.h"
+#include "native.h"
+
+struct Module;
+
+struct Context {
+    std::map<std::string, FunctionDef> functions;
+    std::unordered_map<std::string, Variable> variables;
+    NativeTable natives;
+    std::vector<const Module*> imports;
+    std::string sourcePath;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "context.h"
+#include "module.h"
+#include "statement.h"
+
+// Source-level debugger. Breakpoints are installed by swapping the kind of
+// the affected statements to StmtKind::Trap; the executors only reach the
+// debugger through that case of their dispatch switch, so a normal run
+// never pays for it.
+class Debugger {
+public:
+    Debugger(Context& ctx, Module& root);
+
+    // Interactive prompt before the program starts.
+    void start();
+
+    StmtKind trap(const Stmt& st, const FunctionDef* func, const std::unordered_map<std::string, Variable>* locals);
+
+private:
+    enum class Mode { Continue, Step, Next, Finish };
+
+    void prompt(const Stmt& st);
+    bool command(const std::string& line); // true resumes execution
+    void breakAt(const std::string& where);
+    void deleteBreakpoint(const std::string& where);
+    void printVariable(const std::string& name) const;
+    void printBacktrace() const;
+    void showLine(int line) const;
+    void setMode(Mode mode);
+    void reinstall();
+    void install(const Stmt& st);
+
+    Context& ctx;
+    Module& root;
+    std::vector<std::string> source;
+    std::map<Stmt, StmtKind> original;        // statements currently trapped
+    std::map<Stmt, std::string> breakpoints;  // statement -> how the user named it
+    std::vector<Stmt> callSites;              // trapped to keep the backtrace current
+    Mode mode = Mode::Continue;
+
+    // where execution is stopped
+    int callSiteLine = 0;                     // top-level f- call being executed, 0 if none
+    const FunctionDef* currentFunc = nullptr;
+    std::string currentFuncName;
+    const std::unordered_map<std::string, Variable>* currentLocals = nullptr;
+    int currentLine = 0;
+};
+
+extern Debugger* activeDebugger;
+
+// Entry point for the Trap case of the executors; returns the kind to run.
+StmtKind debugTrap(const Stmt& st, const FunctionDef* func, const std::unordered_map<std::string, Variable>* locals);
+
+#endif
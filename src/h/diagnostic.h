@@ -0,0 +1,12 @@
+#ifndef DIAGNOSTIC_H
+#define DIAGNOSTIC_H
+
+#include <string>
+
+struct Diagnostic {
+    std::string file;
+    int line;
+    std::string message;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef ERROR_H
+#define ERROR_H
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+enum class ErrorCode {
+    InvalidValue,
+    UndefinedVariable,
+    UndefinedFunction,
+    WrongArgCount,
+    BadInput,
+    NativeModule,
+    Import,
+    Syntax
+};
+
+struct CallFrame {
+    std::string function;
+    int line; // line of the call site
+};
+
+// Runtime error raised by lo code. Errors unwind through C++ exception
+// tables, so statements that do not fail pay nothing for being catchable.
+struct LoError : std::runtime_error {
+    ErrorCode code;
+    int line;                    // 0 when raised below statement level
+    std::vector<CallFrame> stack; // innermost call first
+
+    LoError(ErrorCode code, int line, const std::string& message)
+        : std::runtime_error(message), code(code), line(line) {}
+};
+
+[[noreturn]] void raiseError(ErrorCode code, int lineno, const std::string& msg);
+
+std::string formatError(const LoError& err);
+
+#endif
@@ -10,6 +10,8 @@ bool evaluateCondition(const std::unordered_map<std::string, Variable>& vars,
                       const std::string& op,
                       const std::string& rhsRaw);
 std::string evalExpression(const std::string& expr);
+// one of + - * / % ^ as evalExpression applies it; division by zero gives 0
+long long applyOperator(long long left, char op, long long right);
 
 long long safeStoll(const std::string& s);
 
@@ -8,9 +8,15 @@
 #include "variable.h"
 #include "function.h"
 
+// Thrown when a call runs out of the steps it was given.
+struct StepBudgetExceeded {};
+
+// `steps`, when given, is decremented per statement and per substitution
+// in return; compile-time evaluation uses it so it cannot hang.
 std::string executeFunction(const FunctionDef& func,
                            const std::vector<std::string>& args,
                            const std::map<std::string, FunctionDef>& functions,
-                           const std::unordered_map<std::string, Variable>& globalVars);
+                           const std::unordered_map<std::string, Variable>& globalVars,
+                           long long* steps = nullptr);
 
 #endif
\ No newline at end of file
@@ -1,13 +1,41 @@
 #ifndef FUNCTION_H
 #define FUNCTION_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
+#include "statement.h"
 
 struct FunctionDef {
     std::string returnType;
     std::vector<std::pair<std::string, std::string>> params;
+    std::vector<std::string> typeParams; // type variables of a generic (see generic.h)
     std::vector<std::string> body;
+    Code code;
+    int line = 0;
+
+    // Set on a clone made by specializeCalls (see specialize.h): the int
+    // literals folded into its returns and the function it came from. The
+    // clone runs only while no argument value contains one of `locals`,
+    // which keeps the order of return substitutions irrelevant; any other
+    // call goes to `generic` with the literals put back.
+    const FunctionDef* generic = nullptr;
+    std::string genericName;
+    std::vector<std::pair<size_t, std::string>> bound; // param index in generic, literal
+    std::vector<std::string> locals;
+
+    // Set on an instance of a generic funS (see generic.h): the generic's name.
+    std::string instanceOf;
+
+    // Identity of the compiled function for --memo (see memo.h); 0 until set.
+    uint64_t memoId = 0;
 };
 
-#endif
\ No newline at end of file
+// The name call sites wrote for `func`, called as `called`; error call
+// stacks show it rather than the names of clones and instances.
+inline const std::string& sourceName(const FunctionDef& func, const std::string& called) {
+    if (func.generic) return func.genericName;
+    return func.instanceOf.empty() ? called : func.instanceOf;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef GENERIC_H
+#define GENERIC_H
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include "function.h"
+#include "module.h"
+#include "variable.h"
+
+// Generic funS: the type variables are declared after the name
+// (`funS T first<T>(T: a, T: b): {`) and may be used as param types, as
+// the return type and as loc types in the body; any other type name keeps
+// its old meaning. Calls are monomorphized at compile time: the type of
+// every argument is known from the declarations before the call, each
+// combination of types gets its own instance with the variables replaced
+// (`first__int`), and the call is pointed at it. An instance is made once,
+// next to the generic in the module that defines it, and shared by every
+// module calling it with those types.
+bool isTypeVariable(const FunctionDef& func, const std::string& type);
+bool isGeneric(const FunctionDef& func);
+
+// Instantiates the generic calls of a root module and its imports'
+// generics. Problems are appended to mod.diagnostics.
+void instantiateGenerics(Module& mod);
+
+// The same for a REPL chunk: variables of earlier chunks have the types
+// they hold now, funS of earlier chunks are in `functions`, where
+// instances of them are added as well.
+void instantiateGenerics(Module& chunk, std::map<std::string, FunctionDef>& functions,
+                         const std::unordered_map<std::string, Variable>& variables,
+                         const std::vector<const Module*>& imports);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <cstdint>
+#include <string>
+#include "context.h"
+#include "module.h"
+#include "statement.h"
+
+// --set NAME=VALUE: gives the first loc NAME of the root file VALUE instead
+// of the value written there (quoted for str). false with `error` set when
+// there is no such loc.
+bool setGlobal(Module& root, const std::string& name, const std::string& value, std::string& error);
+
+// Fingerprint of every source file of the module graph under `root`.
+uint64_t graphFingerprint(const Module& root);
+
+// Runs top-level code like runCode, one unit at a time (--incremental): a
+// unit is a statement or a whole if-/try-/match- block. The cache at `path`
+// keeps, for each unit of earlier runs, the variables it could read and
+// their values then, the values it left in the variables it sets and what
+// it printed. A unit whose code and read values are the same again is
+// replayed from the cache instead of run, so only units downstream of
+// changed inputs (--set values, input--) run. Units that read input--, load
+// modules or call natives always run. Cache entries of `source` only are
+// used; the cache is rewritten after the run, also when the run fails.
+void runIncremental(Context& ctx, const Code& code, const std::string& path, uint64_t source);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include <string>
+#include <vector>
+#include "context.h"
+#include "statement.h"
+
+void processLoc(Context &ctx, const Stmt &st);
+void processAssign(Context &ctx, const Stmt &st);
+void processInput(Context &ctx, const Stmt &st);
+void processPrint(Context &ctx, const Stmt &st, StmtKind kind);
+void processUseNative(Context &ctx, const Stmt &st);
+void processImport(Context &ctx, const Stmt &st);
+
+// Runs compiled top-level code. Failures that lo code does not catch
+// surface as LoError (see error.h); the context stays usable afterwards.
+void runCode(Context &ctx, const Code &code);
+// Runs code[begin, end), which holds whole blocks.
+void runCode(Context &ctx, const Code &code, uint32_t begin, uint32_t end);
+// Where the top-level block starting at `begin` ends: past the end-- of an
+// if-/try-/match-, otherwise right after the statement.
+uint32_t blockEnd(const Code &code, uint32_t begin);
+
+#endif
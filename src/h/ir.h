@@ -0,0 +1,115 @@
+#ifndef IR_H
+#define IR_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "module.h"
+#include "statement.h"
+
+// SSA form of a module's top-level code. Every store to a variable (loc,
+// assignment, input, catch-) defines a new value, reads name the store that
+// reaches them and phis merge stores at the end of if-/match-/try- blocks.
+// Lo has no loops, so blocks are kept in an order where predecessors come
+// first, which every pass relies on.
+enum class IrOp : unsigned char {
+    Undef,     // the variable does not exist; only insts[0]
+    Opaque,    // catch- handler entry: any store of the try- body may be seen
+    Loc,       // type, text: raw value
+    Assign,    // operand: previous store; text: rhs
+    Input,     // type, text: prompt
+    Caught,    // catch- variable: the error message
+    Phi,       // one operand per predecessor
+    Cmp,       // operands: lhs store, rhs store (Undef: the literal `text`); name: lhs; type: operator
+    Print,     // operand: the store printed
+    PrintText, // text
+    Call,      // text: function; args and one operand per arg (Undef: literal)
+    Effect,    // import, use native and statements that can only raise
+    // terminators
+    Jump,
+    Branch,    // operand: Cmp; successors: true, false
+    Switch,    // match-; operand: subject; args: case labels; successors: cases, then the miss
+    Try,       // successors: body, handler
+    Exit,
+};
+
+// What the optimizer knows about a stored value.
+struct IrValue {
+    enum class Exists : unsigned char { No, Yes, Maybe };
+    Exists exists = Exists::Maybe;
+    std::string type; // empty: unknown
+    bool constant = false;
+    std::string value;
+};
+
+struct IrInst {
+    IrOp op;
+    uint32_t block = 0;
+    uint32_t stmt = Code::none; // statement it was built from
+    int line = 0;
+    std::string name; // variable stored, printed, compared or matched
+    std::string type;
+    std::string text;
+    std::vector<std::string> args;
+    std::vector<uint32_t> operands;
+
+    // filled in by optimizeIr
+    IrValue known;
+    uint32_t vn = 0;  // value number: equal numbers hold equal values
+    bool dead = false;
+    int taken = -1;   // Branch/Switch: index of the only successor that can run
+};
+
+struct IrBlock {
+    std::vector<uint32_t> insts; // phis first, the terminator last
+    std::vector<uint32_t> preds;
+    std::vector<uint32_t> succs;
+    bool reachable = true;
+};
+
+struct IrProgram {
+    std::vector<IrInst> insts;
+    std::vector<IrBlock> blocks;   // blocks[0] is the entry
+    std::vector<uint32_t> instOf;  // per statement: the inst that stands for it, or Code::none
+    bool optimized = false;
+};
+
+// Dominator tree of the blocks, numbered by a depth-first walk so that a
+// query is two comparisons.
+class IrDominators {
+public:
+    explicit IrDominators(const IrProgram& ir);
+    bool dominates(uint32_t a, uint32_t b) const { return enter[a] <= enter[b] && leave[b] <= leave[a]; }
+
+private:
+    uint32_t intersect(uint32_t a, uint32_t b) const;
+
+    std::vector<uint32_t> idom, jump, depth;
+    std::vector<uint32_t> enter, leave;
+};
+
+bool isTerminator(IrOp op);
+// Stores and phis: instructions other instructions can name as operands.
+bool definesValue(IrOp op);
+
+IrProgram buildIr(const Code& code);
+
+// Checks block structure, phi arity and that every definition dominates
+// its uses. Returns an empty string for a well-formed program.
+std::string verifyIr(const IrProgram& ir);
+
+void dumpIr(const IrProgram& ir, std::ostream& out);
+
+// Global value numbering with constant folding over the executable part of
+// the program (which also finds common subexpressions), branch folding on
+// conditions that dominating branches or constants decide, then dead store
+// elimination.
+void optimizeIr(IrProgram& ir);
+
+// Rewrites mod.code from the optimized program: dead stores and decided
+// branches are dropped, stores and prints of known values become literals.
+// false leaves mod.code as it was.
+bool lowerIr(const IrProgram& ir, Module& mod);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Small JSON value, enough for the LSP server's JSON-RPC traffic.
+class Json {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Json() = default;
+    Json(std::nullptr_t) {}
+    Json(bool b) : t(Type::Bool), b(b) {}
+    Json(int n) : t(Type::Number), n(n) {}
+    Json(long long n) : t(Type::Number), n(static_cast<double>(n)) {}
+    Json(double n) : t(Type::Number), n(n) {}
+    Json(const char* s) : t(Type::String), s(s) {}
+    Json(std::string s) : t(Type::String), s(std::move(s)) {}
+
+    static Json array();
+    static Json object();
+    static bool parse(const std::string& text, Json& out);
+
+    Type type() const { return t; }
+    bool isNull() const { return t == Type::Null; }
+    bool isString() const { return t == Type::String; }
+    bool isNumber() const { return t == Type::Number; }
+
+    bool boolean() const { return t == Type::Bool && b; }
+    double number() const { return t == Type::Number ? n : 0; }
+    int integer() const { return static_cast<int>(number()); }
+    const std::string& str() const { return s; }
+
+    // objects: missing keys read as null
+    bool has(const std::string& key) const;
+    const Json& operator[](const std::string& key) const;
+    Json& operator[](const std::string& key);
+
+    // arrays
+    size_t size() const { return t == Type::Array ? items.size() : keys.size(); }
+    const Json& operator[](size_t i) const { return items[i]; }
+    void push(Json value);
+
+    std::string dump() const;
+
+private:
+    void dumpTo(std::string& out) const;
+
+    Type t = Type::Null;
+    bool b = false;
+    double n = 0;
+    std::string s;
+    std::vector<Json> items;       // array elements or object values
+    std::vector<std::string> keys; // object keys, parallel to items
+};
+
+// Appends `s` as a quoted JSON string.
+void dumpJsonString(std::string_view s, std::string& out);
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef JUMPTABLE_H
+#define JUMPTABLE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "variable.h"
+
+// Minimal perfect hash over distinct 64-bit keys (hash and displace): every
+// key lands in its own slot after one bucket lookup and one rehash.
+class PerfectHash {
+public:
+    // false when no displacement could be found; callers retry with other keys
+    bool build(const std::vector<uint64_t>& keys);
+    size_t slot(uint64_t key) const;
+    size_t size() const { return slots; }
+
+private:
+    std::vector<uint32_t> displacement;
+    size_t slots = 0;
+};
+
+// O(1) dispatch for match- and for if-/elif- chains that compare one
+// variable with === against constants. Int cases go through a dense table
+// when their range is small and through the perfect hash otherwise; string
+// cases always use the perfect hash.
+class JumpTable {
+public:
+    static constexpr size_t none = static_cast<size_t>(-1);
+
+    explicit JumpTable(size_t miss) : miss(miss) {}
+
+    // the first target added for a value wins, as in a chain of comparisons
+    void addInt(long long value, size_t target);
+    void addString(const std::string& value, size_t target);
+    void build();
+
+    // Words of a lowered chain compare against a variable of that name when
+    // one exists; the table is bypassed while any of these is declared.
+    void guardNames(std::vector<std::string> words) { names = std::move(words); }
+    // A lowered chain only stays exact for int variables if every case is a number.
+    void rejectInts() { intsExact = false; }
+    // Branch statements in the order to test them when the table cannot
+    // decide, as a profile ranked them (see profile.h); empty: as written.
+    // A table without cases only carries this order.
+    void setTestOrder(std::vector<uint32_t> branches) { order = std::move(branches); }
+    const std::vector<uint32_t>& testOrder() const { return order; }
+
+    // Picks the statement to continue with. false means the table cannot
+    // decide and the caller evaluates the comparisons one by one.
+    bool select(const std::unordered_map<std::string, Variable>& vars, const std::string& name, uint32_t& target) const;
+
+    size_t size() const { return intKeys.size() + stringKeys.size(); }
+
+private:
+    size_t findInt(long long value) const;
+    size_t findString(const std::string& value) const;
+    bool shadowed(const std::unordered_map<std::string, Variable>& vars) const;
+
+    size_t miss; // nothing matched
+
+    std::vector<long long> intKeys;
+    std::vector<size_t> intTargets;
+    long long denseBase = 0;
+    std::vector<size_t> dense; // target per value in [denseBase, denseBase + dense.size())
+    uint64_t intSeed = 0;
+    PerfectHash intHash;
+    std::vector<size_t> intSlots; // perfect-hash slot -> index into intKeys
+    bool intsExact = true;
+
+    std::vector<std::string> stringKeys;
+    std::vector<size_t> stringTargets;
+    uint64_t stringSeed = 0;
+    PerfectHash stringHash;
+    std::vector<size_t> stringSlots;
+
+    std::unordered_set<long long> intSeen; // only while adding
+    std::unordered_set<std::string> stringSeen;
+
+    std::vector<std::string> names;
+    std::vector<uint32_t> order;
+    mutable size_t checkedVars = none; // variables are never removed, so an unchanged count means an unchanged set
+    mutable bool namesShadowed = false;
+};
+
+#endif
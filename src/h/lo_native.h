@@ -0,0 +1,36 @@
+#ifndef LO_NATIVE_H
+#define LO_NATIVE_H
+
+/*
+ * Stable C ABI for native lo extension modules.
+ *
+ * A module is a shared object exporting `lo_module_init`. lomake calls it
+ * once, right after dlopen, and the module registers its functions through
+ * the supplied callback. Registered functions are then callable from lo
+ * code as `f-name(args)`.
+ *
+ * Arguments arrive as NUL-terminated strings (the textual value of each lo
+ * argument). The returned string must stay valid until the next call of the
+ * same function on the same thread; a thread_local buffer is enough.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LO_NATIVE_ABI_VERSION 1
+#define LO_MODULE_INIT_SYMBOL "lo_module_init"
+
+typedef const char* (*lo_native_fn)(int argc, const char* const* argv);
+
+/* arity < 0 means the function accepts any number of arguments */
+typedef void (*lo_register_fn)(void* registry, const char* name, int arity, lo_native_fn fn);
+
+/* returns 0 on success, anything else aborts the load */
+typedef int (*lo_module_init_fn)(int abiVersion, void* registry, lo_register_fn reg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef LSP_H
+#define LSP_H
+
+// Language server over stdio (JSON-RPC with Content-Length framing).
+// Documents are kept in memory split into top-level units; an edit only
+// recompiles the units it touches.
+int runLanguageServer();
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "function.h"
+#include "module.h"
+
+// Results of funS calls shared between runs and between lomake processes
+// running at the same time (--memo). funS only see their arguments, so a
+// result is keyed by the function's code and the argument values.
+//
+// The table is a file mapped into every process: an array of slots and a
+// ring of records. A record holds a key and its result and is never changed
+// once written; a slot holds the ring position of a record and a few bits
+// of its key's hash. Lookups take no lock: they probe the slots, copy the
+// record out and check afterwards that the ring was not written over it
+// meanwhile. Inserts reserve ring space and claim a slot with a
+// compare-and-swap. When the ring wraps, the oldest records are dropped,
+// and a key whose slots are all taken replaces one of them.
+class MemoTable {
+public:
+    MemoTable() = default;
+    MemoTable(const MemoTable&) = delete;
+    MemoTable& operator=(const MemoTable&) = delete;
+    ~MemoTable();
+
+    // Maps the table at `path`, creating it `bytes` large when there is
+    // none; an existing one keeps its size. false with `error` set when it
+    // cannot be used.
+    bool open(const std::string& path, size_t bytes, std::string& error);
+
+    bool find(const std::string& key, std::string& result) const;
+    // Results too large for the ring are not kept.
+    void insert(const std::string& key, const std::string& result);
+
+private:
+    struct Header;
+
+    unsigned char* base = nullptr;
+    size_t mapped = 0;
+    Header* header = nullptr;
+    uint64_t* slots = nullptr;
+    unsigned char* ring = nullptr;
+};
+
+// The table calls are memoized in, or null.
+extern MemoTable* activeMemo;
+
+// Gives every funS of the module graph and of `functions` the identity
+// memoKey hashes. Called once the code is final: it covers the compiled
+// body, so clones and instances differ from their originals.
+void assignMemoIds(Module& root, std::map<std::string, FunctionDef>& functions);
+
+// Key of a call of `func` with its parameters bound to `values`.
+std::string memoKey(const FunctionDef& func, const std::vector<std::string>& values);
+
+#endif
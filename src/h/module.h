@@ -0,0 +1,55 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "function.h"
+#include "statement.h"
+#include "diagnostic.h"
+#include "context.h"
+
+struct ModuleImport {
+    std::string path; // canonical
+    int line;
+};
+
+struct Module {
+    std::string path;
+    std::map<std::string, FunctionDef> functions;
+    Code code;
+    std::vector<ModuleImport> importPaths;
+    std::vector<const Module*> imports;
+    std::vector<Diagnostic> diagnostics;
+    bool failed = false;   // the file could not be read
+    bool reported = false; // diagnostics already handed out
+};
+
+bool parseFunctionHeader(const std::string& line, std::string& name, FunctionDef& def);
+
+// Resolves `path` relative to the importing file. Paths that are not
+// absolute are looked up next to `importer` first, then in the working dir.
+std::string resolveImportPath(const std::string& importer, const std::string& path);
+
+// Loads `path` and everything it imports. Modules are compiled concurrently
+// on `jobs` threads, cached for the whole process and shared by every
+// importer. Diagnostics are returned in import order, then by line.
+// `foldCalls` is passed on to foldConstants.
+Module* loadModuleGraph(const std::string& path, bool allowCode, unsigned jobs,
+                        std::vector<Diagnostic>& diagnostics, bool foldCalls = true);
+
+// Loads several root files and their imports on one shared pool, optionally
+// running the static checker over every new module. diagnostics[i] belongs
+// to paths[i]; a module shared by several roots reports under the first.
+std::vector<Module*> loadModuleGraphs(const std::vector<std::string>& paths, bool allowCode, bool typeCheck,
+                                      unsigned jobs, std::vector<std::vector<Diagnostic>>& diagnostics,
+                                      bool foldCalls = true);
+
+// Returns an already loaded module, loading it on demand otherwise.
+const Module* importModule(const std::string& path, std::string& error);
+
+// Looks a function up in the context, then in its imports. Imported
+// functions are linked into ctx.functions on first use only.
+const FunctionDef* findFunction(Context& ctx, const std::string& name);
+
+#endif
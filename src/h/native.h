@@ -0,0 +1,22 @@
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "lo_native.h"
+
+struct NativeFunction {
+    int arity;
+    lo_native_fn fn;
+};
+
+using NativeTable = std::unordered_map<std::string, NativeFunction>;
+
+// Loads a native module and registers its functions into `table`.
+// A path that was already loaded by this process is not opened again.
+bool loadNativeModule(const std::string& path, NativeTable& table, std::string& error);
+
+std::string callNative(const NativeFunction& fn, const std::vector<std::string>& args);
+
+#endif
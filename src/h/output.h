@@ -0,0 +1,48 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <memory>
+#include <string_view>
+
+// What print-- writes (--output): lines of text, or a typed record per
+// print for other programs to read.
+enum class OutputFormat { Text, Jsonl, Binary };
+
+extern OutputFormat outputFormat;
+
+// Prints a value print-- produced. `type` is a variable's type or a funS's
+// declared return type; an int or bool that does not hold one, and any
+// other type, print as str. The records:
+//   jsonl   {"type":"int","value":42}, an arr's items in a JSON array
+//   binary  a tag byte (1 int, 2 str, 3 bool, 4 arr), the size of the
+//           payload in 4 bytes little-endian, then the payload: an int in
+//           8 bytes little-endian, a bool in 1, the bytes of a str, the
+//           records of an arr's items
+// An arr item is an int if it holds one and a str otherwise.
+void printValue(std::string_view type, std::string_view value);
+
+// Whether a print of a `type` value may be folded into a print of literal
+// text: always for text output, only for a known str with records.
+bool printFoldable(std::string_view type);
+
+// Puts std::cout behind a writer thread for as long as it lives
+// (--async-output). Prints fill one of a few buffers while the thread writes
+// the ones filled before, so a print waits only when every buffer is still
+// queued for a slow stdout. std::cerr and std::cin flush it completely
+// before they write or read, so diagnostics and input-- prompts come out
+// where they did.
+class AsyncOutput {
+public:
+    AsyncOutput();
+    AsyncOutput(const AsyncOutput&) = delete;
+    AsyncOutput& operator=(const AsyncOutput&) = delete;
+    ~AsyncOutput(); // writes out what is left
+
+private:
+    class Writer;
+    class Drain;
+    std::unique_ptr<Writer> writer;
+    std::unique_ptr<Drain> drain;
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "context.h"
+#include "statement.h"
+
+// Runs top-level code like runCode, with funS calls spread over `jobs`
+// threads (--auto-parallel). A top-level `print-- f-name(...)` of a funS
+// depends only on the values its arguments have when it is reached, so
+// they are copied and the call runs on the pool while the main thread goes
+// on; every other block runs on the main thread in program order. Results
+// are printed in program order: a block that prints, reads input or loads
+// code first waits for the calls before it, and a failure is reported only
+// once the calls before it are printed, so the first one in program order
+// wins. Workers only read quickened sites (see quicken.h); the main thread
+// runs funS code itself only while the pool is idle.
+void runParallel(Context& ctx, const Code& code, unsigned jobs);
+
+#endif
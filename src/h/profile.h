@@ -0,0 +1,67 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include "function.h"
+#include "module.h"
+#include "statement.h"
+
+// Profile-guided optimization. `--profile-out` counts, per line of the
+// root file, how often each if-/elif- chain ran and each of its branches
+// was taken and how often each f- call site ran, and notes which form the
+// return of each funS called was quickened to. Counts add up over runs as long as the source
+// stays the same. `--profile-use` reads them back (see applyProfile and
+// specializeCalls).
+class Profile {
+public:
+    explicit Profile(uint64_t source = 0) : source(source) {}
+
+    // Adds the counts of a profile file made for the same source. false
+    // with `error` set when it cannot be read or was made for another one.
+    bool merge(const std::string& path, std::string& error);
+    bool save(const std::string& path, std::string& error) const;
+
+    // `target` is where the chain headed at `head` went on: past its end--
+    // or into the body of a branch.
+    void chainRan(Stmt head, uint32_t target);
+    void called(Stmt site);
+    // Called once the run is over, with the funS it called.
+    void finishRun(const std::map<std::string, FunctionDef>& functions);
+
+    uint64_t runCount() const { return runs; }
+    uint64_t chainRuns(int line) const { return count(chains, line); }
+    uint64_t branchTaken(int line) const { return count(branches, line); }
+    uint64_t siteCalls(int line) const { return count(sites, line); }
+    // the return of `function` ended up generic in every run that called it
+    bool genericReturn(const std::string& function) const {
+        return genericReturns.count(function) && !intReturns.count(function);
+    }
+
+private:
+    static uint64_t count(const std::unordered_map<int, uint64_t>& counts, int line);
+
+    uint64_t source;
+    uint64_t runs = 0;
+    std::unordered_map<int, uint64_t> chains, branches, sites;
+    std::set<std::string> genericReturns, intReturns;
+};
+
+// The profile being recorded, or null.
+extern Profile* activeProfile;
+
+// Fingerprint of a source file, so a profile is only used for the code it
+// was recorded on; 0 when the file cannot be read.
+uint64_t sourceFingerprint(const std::string& path);
+
+// Lets the hottest branch of an if-/elif- chain be tested first when the
+// tests cannot raise and at most one of them can hold (one variable
+// against distinct int literals, as ints or as strings), and starts the
+// return of funS that only ever went generic in generic form. Runs on the
+// final code, after --optimize.
+void applyProfile(Module& mod, const Profile& profile);
+
+#endif
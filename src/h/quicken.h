@@ -0,0 +1,73 @@
+#ifndef QUICKEN_H
+#define QUICKEN_H
+
+#include <string>
+#include <unordered_map>
+#include "function.h"
+#include "statement.h"
+#include "variable.h"
+
+using VariableMap = std::unordered_map<std::string, Variable>;
+
+// Quickening: the first time a statement runs it looks at the types it
+// actually met and rewrites itself into a form specialized for them, with
+// variable slots resolved and literals parsed. Every later run checks a
+// cheap guard on those types; when it fails the site goes back to the
+// generic code for good. Variables are never removed, so a cached slot
+// stays valid for the map it came from.
+enum class QuickForm : unsigned char {
+    Unseen,
+    Generic,
+    IntCompare, // if-/elif- on two ints
+    StrCompare, // if-/elif- on two strs
+    Assign,     // value precomputed for the variable's type
+    Load,       // print-- of a scalar variable
+    IntReturn,  // funS return of an int local or of two int operands
+    ConstLoc,   // funS loc; its value depends only on its text
+};
+
+// `return a op b!` or `return a!` where the operands are locals or
+// non-negative int literals and no local name occurs anywhere else in the
+// text, so substituting the locals amounts to reading the operands.
+struct ReturnShape {
+    std::string operand[2]; // local names, empty for a literal
+    long long literal[2] = {0, 0};
+    char op = 0;            // 0: a bare operand
+};
+
+struct QuickSite {
+    QuickForm form = QuickForm::Unseen;
+    const VariableMap* scope = nullptr; // map the cached slots point into
+    Variable* lhs = nullptr;
+    Variable* rhs = nullptr;    // null: compare with the literal
+    size_t knownVars = 0;       // scope size when the literal was last seen not to name a variable
+    long long number = 0;       // int literal
+    char op = 0;                // '>', '<' or '='
+    std::string type;           // assign: type the value was computed for
+    Text value;                 // str literal, precomputed value
+    ReturnShape shape;          // return
+};
+
+// if-/elif- condition; same result as evaluateCondition.
+bool quickCondition(VariableMap& vars, const Stmt& st);
+// assign; false when the generic processAssign has to run (and report).
+bool quickAssign(VariableMap& vars, const Stmt& st);
+// print-- variable; null when the generic path has to print it.
+const Variable* quickLoad(VariableMap& vars, const Stmt& st);
+// Set on threads that run funS calls beside the main thread (see
+// parallel.h). They use the sites the main thread quickened but neither
+// make nor give up any, so the sites are only read while they run.
+extern thread_local bool quickReadOnly;
+
+// funS loc value.
+const Text& quickLocValue(const Stmt& st);
+
+bool matchReturnShape(const FunctionDef& func, const std::string& expr, ReturnShape& shape);
+// An int the generic path reads the same way: std::stoll gives this value
+// and cannot overflow. Anything else is left to the generic path.
+bool parseQuickInt(std::string_view s, long long& out, bool allowSign = true);
+
+// funS return; false when the generic substitution has to run.
+bool quickReturn(const FunctionDef& func, const Stmt& st, const VariableMap& locals, std::string& out);
+
+#endif
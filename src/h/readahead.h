@@ -0,0 +1,46 @@
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// How the source loader and input-- read (--read-ahead). Blocking reads as
+// they always did; Uring and Thread keep the next chunks of a file or of
+// stdin in flight while the current one is parsed, with io_uring or with a
+// thread. Uring falls back to a thread where the kernel or a sandbox
+// refuses io_uring.
+enum class ReadBackend { Blocking, Uring, Thread };
+
+extern ReadBackend readBackend;
+
+// Reads `fd` from where it stands to its end in chunks, read ahead of the
+// caller. Regular files have several reads in flight at once; pipes and
+// terminals one, because their reads must happen in order. Leaves `fd`
+// open.
+class ReadAhead {
+public:
+    ReadAhead(int fd, ReadBackend backend);
+    ReadAhead(const ReadAhead&) = delete;
+    ReadAhead& operator=(const ReadAhead&) = delete;
+    ~ReadAhead();
+
+    // The next chunk, good until the next call; empty at the end or on an
+    // error.
+    std::string_view next();
+
+    class Source;
+
+private:
+    std::unique_ptr<Source> source;
+};
+
+// Reads the lines of `path` the way std::getline would, through a ReadAhead
+// on readBackend. False if it cannot be opened.
+bool readFileLines(const std::string& path, std::vector<std::string>& lines);
+
+// Puts std::cin on a ReadAhead of stdin for the rest of the process.
+void readStdinAhead();
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef REPL_H
+#define REPL_H
+
+// Interactive loop on stdin. Each complete statement, if-/try- block or funS
+// definition is compiled on its own and run against one persistent Context.
+int runRepl();
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SPECIALIZE_H
+#define SPECIALIZE_H
+
+#include <cstddef>
+#include "module.h"
+#include "profile.h"
+
+// Clones funS for the int literals that call sites of the top-level code
+// pass most often and points those sites at the clones, with the literals
+// substituted into the clone's returns. A clone is made for a combination
+// of literals that at least two sites share, most shared first, while the
+// clones' statements fit in `budget`. With a profile, combinations are
+// ranked by how often their sites ran instead, and ones whose sites never
+// ran get no clone. Clones are added to mod.functions and listed in stats.
+void specializeCalls(Module& mod, size_t budget, const Profile* profile = nullptr);
+
+// Whether a clone may run for these argument values (see FunctionDef::generic).
+bool specializationHolds(const FunctionDef& clone, const std::vector<std::string>& values);
+
+// The arguments of a call to a clone as its generic function takes them.
+std::vector<std::string> genericArgs(const FunctionDef& clone, const std::vector<std::string>& args);
+
+#endif
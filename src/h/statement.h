@@ -0,0 +1,154 @@
+#ifndef STATEMENT_H
+#define STATEMENT_H
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class JumpTable;
+struct QuickSite;
+
+enum class StmtKind : unsigned char {
+    Loc,        // name, type, raw value
+    Const,      // name, type, raw value or f-call; replaced by a Loc once evaluated
+    Assign,     // name, rhs
+    Input,      // name, type, prompt
+    PrintText,  // text
+    PrintVar,   // variable
+    PrintCall,  // function, args...
+    If,         // lhs, op, rhs
+    Elif,       // lhs, op, rhs
+    End,
+    Import,     // resolved module path
+    UseNative,  // library path
+    Return,     // expression
+    Try,
+    Catch,      // [variable]
+    Match,      // variable
+    Case,       // int or "string" literal
+    Trap        // debugger breakpoint; the original kind is kept by the debugger
+};
+
+class Code;
+
+// A statement of a Code: the code it lives in and its index there. Cheap to
+// copy and stays valid as long as the Code is neither moved nor destroyed.
+class Stmt {
+public:
+    Stmt(const Code& code, uint32_t index) : owner(&code), at(index) {}
+
+    StmtKind kind() const;
+    int line() const;
+    uint32_t next() const; // if-/elif-/case-: the following branch or end--; try-: its catch-
+    uint32_t end() const;  // if-/elif-/try-/catch-/match-/case-: index of the closing end--
+    size_t argCount() const;
+    std::string_view arg(size_t i) const;
+    std::string str(size_t i) const { return std::string(arg(i)); }
+    std::vector<std::string> args(size_t from = 0) const;
+    const JumpTable* table() const; // match-, and if- chains lowered to a table
+    QuickSite& quick() const;       // specialized form, made on first run (see quicken.h)
+    const QuickSite* quickMade() const; // null until quick() made one
+
+    const Code& code() const { return *owner; }
+    uint32_t index() const { return at; }
+    bool operator==(const Stmt& o) const { return owner == o.owner && at == o.at; }
+    bool operator<(const Stmt& o) const { return owner != o.owner ? owner < o.owner : at < o.at; }
+
+private:
+    const Code* owner;
+    uint32_t at;
+};
+
+// Compiled statements stored column by column: one array per field,
+// statements and arguments addressed by 32-bit indices, and all argument
+// text in a single buffer. A module therefore costs a few arrays instead of
+// a vector and strings per statement, and reserve() lets the compiler build
+// it without regrowing them.
+class Code {
+public:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    uint32_t add(StmtKind kind, int line, std::initializer_list<std::string_view> args);
+    uint32_t add(StmtKind kind, int line, const std::vector<std::string>& args);
+    // rewrites a statement in place; the old argument text stays unused in the buffer
+    void replace(uint32_t i, StmtKind kind, std::initializer_list<std::string_view> args);
+    void replace(uint32_t i, StmtKind kind, const std::vector<std::string>& args);
+    void setKind(uint32_t i, StmtKind kind) { kinds[i] = kind; }
+    void setNext(uint32_t i, uint32_t target) { nexts[i] = target; }
+    void setEnd(uint32_t i, uint32_t target) { ends[i] = target; }
+    void setTable(uint32_t i, std::shared_ptr<const JumpTable> table);
+
+    void reserve(size_t statements, size_t args, size_t textBytes);
+    void clear();
+
+    uint32_t size() const { return static_cast<uint32_t>(kinds.size()); }
+    bool empty() const { return kinds.empty(); }
+    Stmt operator[](uint32_t i) const { return Stmt(*this, i); }
+    Stmt front() const { return Stmt(*this, 0); }
+
+    class iterator {
+    public:
+        iterator(const Code& code, uint32_t i) : code(&code), i(i) {}
+        Stmt operator*() const { return Stmt(*code, i); }
+        iterator& operator++() { ++i; return *this; }
+        bool operator!=(const iterator& o) const { return i != o.i; }
+
+    private:
+        const Code* code;
+        uint32_t i;
+    };
+    iterator begin() const { return iterator(*this, 0); }
+    iterator end() const { return iterator(*this, size()); }
+
+    // heap bytes held by the arrays
+    size_t bytes() const;
+    // array buffers allocated while building, reserve() included
+    size_t allocations() const { return allocs; }
+
+private:
+    friend class Stmt;
+
+    void appendArgs(std::initializer_list<std::string_view> args);
+    void appendArg(std::string_view arg);
+    template <class V>
+    void note(const V& v, size_t capacity) { if (v.capacity() != capacity) ++allocs; }
+
+    std::vector<StmtKind> kinds;
+    std::vector<int32_t> lines;
+    std::vector<uint32_t> nexts;
+    std::vector<uint32_t> ends;
+    std::vector<uint32_t> firstArg;
+    std::vector<uint32_t> argCounts;
+    std::vector<uint32_t> tableOf; // index into tables or none
+
+    std::vector<uint32_t> argStart; // per argument: slice of text
+    std::vector<uint32_t> argLength;
+    std::string text;
+
+    std::vector<std::shared_ptr<const JumpTable>> tables;
+    // filled on first run only; copies of a Code share the sites made so far
+    mutable std::vector<uint32_t> quickOf;
+    mutable std::vector<std::shared_ptr<QuickSite>> quickSites;
+    size_t allocs = 0;
+};
+
+inline StmtKind Stmt::kind() const { return owner->kinds[at]; }
+inline int Stmt::line() const { return owner->lines[at]; }
+inline uint32_t Stmt::next() const { return owner->nexts[at]; }
+inline uint32_t Stmt::end() const { return owner->ends[at]; }
+inline size_t Stmt::argCount() const { return owner->argCounts[at]; }
+
+inline std::string_view Stmt::arg(size_t i) const {
+    uint32_t a = owner->firstArg[at] + static_cast<uint32_t>(i);
+    return std::string_view(owner->text.data() + owner->argStart[a], owner->argLength[a]);
+}
+
+inline const JumpTable* Stmt::table() const {
+    uint32_t t = owner->tableOf[at];
+    return t == Code::none ? nullptr : owner->tables[t].get();
+}
+
+#endif
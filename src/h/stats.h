@@ -0,0 +1,69 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Runtime counters printed by --stats.
+struct Stats {
+    double compileMs = 0; // loading, compiling and checking the module graph
+    double runMs = 0;
+    // quickening (see quicken.h)
+    size_t intCompares = 0;
+    size_t strCompares = 0;
+    size_t assigns = 0;
+    size_t loads = 0;
+    size_t intReturns = 0;
+    size_t constLocs = 0;
+    size_t genericSites = 0;  // ran once and had no specialized form for the types seen
+    size_t guardFailures = 0; // specialized sites that met other types and went generic
+    // compiled code of every loaded module and function (see statement.h)
+    size_t codeStatements = 0;
+    size_t codeBytes = 0;
+    size_t codeAllocations = 0;
+    // --optimize (see ir.h)
+    size_t irInstructions = 0;
+    size_t irBlocks = 0;
+    size_t irFoldedValues = 0;   // stores and prints of a known value
+    size_t irFoldedBranches = 0; // branches and match-es with a single way to go
+    size_t irDeadStores = 0;
+    // funS clones (see specialize.h)
+    std::vector<std::string> specializations; // one line per clone
+    size_t specializedSites = 0;
+    size_t specializedStatements = 0;
+    size_t specializeBudget = 0;
+    size_t instances = 0; // of generic funS (see generic.h)
+    // --profile-use (see profile.h)
+    bool profiled = false;
+    size_t profileReorderedChains = 0;
+    size_t profileGenericReturns = 0;
+    // --incremental (see incremental.h)
+    size_t incrementalUnits = 0;
+    size_t incrementalReplayed = 0;
+    // --memo (see memo.h)
+    size_t memoHits = 0;
+    size_t memoMisses = 0;
+    size_t memoStored = 0;
+    // --auto-parallel (see parallel.h)
+    size_t parallelUnits = 0;
+    size_t parallelCalls = 0; // run on the pool
+    unsigned parallelThreads = 0;
+    double parallelism = 0;   // computing time on every thread over run time
+    // --async-output (see output.h)
+    size_t outputWrites = 0; // buffers written
+    size_t outputStalls = 0; // prints that waited for a buffer
+    // --read-ahead (see readahead.h)
+    size_t readAheadChunks = 0;
+    size_t readAheadUring = 0; // of them read with io_uring
+};
+
+extern Stats stats;
+
+class Code;
+void countCode(const Code& code);
+
+void printStats(std::ostream& out);
+
+#endif
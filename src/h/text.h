@@ -0,0 +1,86 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// The value of a variable: an immutable string shared by every copy, so
+// binding a funS argument, snapshotting globals for --auto-parallel or
+// replaying an --incremental unit costs a reference count however long the
+// value is, and the characters go as soon as the last holder does. Values
+// only hold characters, so references cannot form cycles and counting is
+// all the collection there is. Counts are plain increments until
+// shareTextAcrossThreads() is called, and atomic from then on.
+class Text {
+public:
+    Text() = default;
+    Text(std::string s) : rep(s.empty() ? nullptr : new Rep{1, std::move(s)}) {}
+    Text(const char* s) : Text(std::string(s)) {}
+    Text(const Text& o) noexcept : rep(o.rep) { retain(); }
+    Text(Text&& o) noexcept : rep(o.rep) { o.rep = nullptr; }
+    Text& operator=(Text o) noexcept {
+        std::swap(rep, o.rep);
+        return *this;
+    }
+    ~Text() { release(); }
+
+    const std::string& str() const { return rep ? rep->text : none(); }
+    operator const std::string&() const { return str(); }
+    std::string_view view() const { return str(); }
+
+    bool empty() const { return !rep; }
+    size_t size() const { return str().size(); }
+    char front() const { return str().front(); }
+    char back() const { return str().back(); }
+    size_t find(std::string_view what, size_t from = 0) const { return view().find(what, from); }
+    size_t find(char c, size_t from = 0) const { return view().find(c, from); }
+
+private:
+    struct Rep {
+        size_t refs;
+        std::string text;
+    };
+
+    static const std::string& none();
+    void retain() const;
+    void release();
+
+    Rep* rep = nullptr;
+};
+
+// Makes every count update atomic; called before a Text may be copied or
+// dropped on a second thread.
+void shareTextAcrossThreads();
+
+extern bool textsShared;
+
+inline void Text::retain() const {
+    if (!rep) return;
+    if (textsShared) __atomic_add_fetch(&rep->refs, 1, __ATOMIC_RELAXED);
+    else ++rep->refs;
+}
+
+inline void Text::release() {
+    if (!rep) return;
+    if (textsShared ? __atomic_sub_fetch(&rep->refs, 1, __ATOMIC_ACQ_REL) == 0 : --rep->refs == 0) delete rep;
+}
+
+inline bool operator==(const Text& a, const Text& b) { return a.view() == b.view(); }
+inline bool operator!=(const Text& a, const Text& b) { return !(a == b); }
+inline bool operator<(const Text& a, const Text& b) { return a.view() < b.view(); }
+inline bool operator>(const Text& a, const Text& b) { return b < a; }
+inline bool operator==(const Text& a, std::string_view b) { return a.view() == b; }
+inline bool operator!=(const Text& a, std::string_view b) { return a.view() != b; }
+inline bool operator==(const Text& a, const std::string& b) { return a.view() == b; }
+inline bool operator!=(const Text& a, const std::string& b) { return a.view() != b; }
+inline bool operator==(const Text& a, const char* b) { return a.view() == b; }
+inline bool operator!=(const Text& a, const char* b) { return a.view() != b; }
+
+inline std::string operator+(const std::string& a, const Text& b) { return a + b.str(); }
+inline std::string operator+(const char* a, const Text& b) { return a + b.str(); }
+
+inline std::ostream& operator<<(std::ostream& out, const Text& t) { return out << t.str(); }
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Minimal fixed-size pool. Tasks may submit further tasks; wait() returns
+// once the queue is drained and no task is running.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads) {
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        taskReady.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+            ++pending;
+        }
+        taskReady.notify_one();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock, [this] { return pending == 0; });
+    }
+
+    size_t size() const { return workers.size(); }
+
+    static unsigned defaultThreads() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n ? n : 1;
+    }
+
+private:
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) allDone.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskReady;
+    std::condition_variable allDone;
+    size_t pending = 0;
+    bool stopping = false;
+};
+
+#endif
@@ -6,5 +6,7 @@
 std::string trim(const std::string& str);
 bool isStringLiteral(const std::string& value);
 std::string stripQuotes(const std::string& s);
+bool startsWith(const std::string& s, const std::string& prefix);
+std::string canonicalPath(const std::string& path);
 
-#endif
\ No newline at end of file
+#endif
@@ -2,10 +2,11 @@
 #define VARIABLE_H
 
 #include <string>
+#include "text.h"
 
 struct Variable {
     std::string type;
-    std::string value;
+    Text value;
 };
 
 #endif
\ No newline at end of file
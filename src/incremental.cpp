@@ -0,0 +1,424 @@
+#include "h/incremental.h"
+#include "h/interpreter.h"
+#include "h/output.h"
+#include "h/profile.h"
+#include "h/stats.h"
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <unordered_map>
+
+namespace {
+
+const char magic[] = "lo-incremental 2\n";
+const uint32_t none = UINT32_MAX;
+
+// A variable as a unit saw or left it: ids into Cache::strings, with
+// type == none when it was not declared.
+struct Ref {
+    uint32_t name, type, value;
+};
+
+// Output of a unit: a slice of Cache::output.
+struct Piece {
+    uint64_t offset, size;
+    uint32_t error; // written to stderr
+    uint32_t pad = 0;
+};
+
+// A unit of an earlier run. Its reads and writes are refs[firstRef ..
+// firstRef + reads + writes), its output pieces[firstPiece .. + pieces).
+struct Entry {
+    uint32_t at; // index of its first statement
+    uint32_t firstRef, reads, writes;
+    uint32_t firstPiece, pieces;
+    uint64_t hash;
+};
+
+// The units of earlier runs, kept as plain arrays that go to and from the
+// file whole: there is a record for every unit of the program, so loading
+// and saving them has to cost little next to running them.
+struct Cache {
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<Ref> refs;
+    std::vector<Piece> pieces;
+    std::string output;
+    std::vector<Entry> entries; // by `at`
+
+    uint32_t intern(const std::string& s) {
+        auto [it, fresh] = ids.emplace(s, static_cast<uint32_t>(strings.size()));
+        if (fresh) strings.push_back(s);
+        return it->second;
+    }
+};
+
+template <class T>
+bool readArray(std::istream& in, std::vector<T>& v) {
+    uint64_t count = 0;
+    if (!in.read(reinterpret_cast<char*>(&count), sizeof count) || count > UINT32_MAX) return false;
+    v.resize(count);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(v.data()), static_cast<std::streamsize>(count * sizeof(T))));
+}
+
+template <class T>
+void writeArray(std::ostream& out, const std::vector<T>& v) {
+    uint64_t count = v.size();
+    out.write(reinterpret_cast<const char*>(&count), sizeof count);
+    out.write(reinterpret_cast<const char*>(v.data()), static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+// An empty cache unless `path` holds an intact one made for `source`.
+Cache load(const std::string& path, uint64_t source) {
+    Cache cache;
+    std::ifstream in(path, std::ios::binary);
+    char head[sizeof magic - 1];
+    uint64_t recorded = 0;
+    std::vector<uint64_t> lengths;
+    std::vector<char> text, output;
+    if (!in.read(head, sizeof head) || std::string(head, sizeof head) != magic ||
+        !in.read(reinterpret_cast<char*>(&recorded), sizeof recorded) || recorded != source ||
+        !readArray(in, lengths) || !readArray(in, text) || !readArray(in, cache.refs) ||
+        !readArray(in, cache.pieces) || !readArray(in, cache.entries) || !readArray(in, output))
+        return {};
+    cache.output.assign(output.begin(), output.end());
+    size_t offset = 0;
+    for (uint64_t length : lengths) {
+        if (length > text.size() - offset) return {};
+        cache.intern(std::string(text.data() + offset, length));
+        offset += length;
+    }
+    size_t strings = cache.strings.size();
+    for (const auto& ref : cache.refs) {
+        if (ref.name >= strings || (ref.type != none && (ref.type >= strings || ref.value >= strings))) return {};
+    }
+    for (const auto& piece : cache.pieces) {
+        if (piece.offset > cache.output.size() || piece.size > cache.output.size() - piece.offset) return {};
+    }
+    for (const auto& entry : cache.entries) {
+        if (uint64_t(entry.firstRef) + entry.reads + entry.writes > cache.refs.size() ||
+            uint64_t(entry.firstPiece) + entry.pieces > cache.pieces.size())
+            return {};
+    }
+    return cache;
+}
+
+// Writes the entries of `cache` and only what they still use.
+bool save(const std::string& path, uint64_t source, const Cache& cache) {
+    std::vector<uint32_t> remap(cache.strings.size(), none);
+    std::vector<uint64_t> lengths;
+    std::vector<char> text, output;
+    std::vector<Ref> refs;
+    std::vector<Piece> pieces;
+    std::vector<Entry> entries;
+    auto keep = [&](uint32_t id) {
+        if (id == none) return none;
+        if (remap[id] == none) {
+            remap[id] = static_cast<uint32_t>(lengths.size());
+            lengths.push_back(cache.strings[id].size());
+            text.insert(text.end(), cache.strings[id].begin(), cache.strings[id].end());
+        }
+        return remap[id];
+    };
+    for (Entry entry : cache.entries) {
+        uint32_t first = static_cast<uint32_t>(refs.size());
+        for (uint32_t i = 0; i < entry.reads + entry.writes; ++i) {
+            const Ref& ref = cache.refs[entry.firstRef + i];
+            refs.push_back({keep(ref.name), keep(ref.type), ref.type == none ? 0 : keep(ref.value)});
+        }
+        entry.firstRef = first;
+        first = static_cast<uint32_t>(pieces.size());
+        for (uint32_t i = 0; i < entry.pieces; ++i) {
+            Piece piece = cache.pieces[entry.firstPiece + i];
+            const char* from = cache.output.data() + piece.offset;
+            piece.offset = output.size();
+            output.insert(output.end(), from, from + piece.size);
+            pieces.push_back(piece);
+        }
+        entry.firstPiece = first;
+        entries.push_back(entry);
+    }
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(magic, sizeof magic - 1);
+        out.write(reinterpret_cast<const char*>(&source), sizeof source);
+        writeArray(out, lengths);
+        writeArray(out, text);
+        writeArray(out, refs);
+        writeArray(out, pieces);
+        writeArray(out, entries);
+        writeArray(out, output);
+        if (!out.flush()) return false;
+    }
+    return std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+uint64_t unitHash(const Code& code, uint32_t begin, uint32_t end) {
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const void* data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<const unsigned char*>(data)[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+    for (uint32_t i = begin; i < end; ++i) {
+        Stmt st = code[i];
+        StmtKind kind = st.kind();
+        size_t args = st.argCount();
+        mix(&kind, sizeof kind);
+        mix(&args, sizeof args);
+        for (size_t a = 0; a < args; ++a) {
+            std::string_view arg = st.arg(a);
+            size_t size = arg.size();
+            mix(&size, sizeof size);
+            mix(arg.data(), size);
+        }
+    }
+    return hash;
+}
+
+// What running a unit may touch.
+struct Shape {
+    std::set<std::string> reads;  // every word of the code: a superset of the variables it reads
+    std::set<std::string> writes; // variables it may declare or assign
+    bool volatileCode = false;    // reads input or changes what the context has loaded
+};
+
+Shape shapeOf(const Code& code, uint32_t begin, uint32_t end) {
+    Shape shape;
+    for (uint32_t i = begin; i < end; ++i) {
+        Stmt st = code[i];
+        size_t args = st.argCount();
+        for (size_t a = 0; a < args; ++a) {
+            std::string_view arg = st.arg(a);
+            auto word = [&arg](size_t p) { return std::isalnum(static_cast<unsigned char>(arg[p])) || arg[p] == '_'; };
+            for (size_t p = 0; p < arg.size();) {
+                size_t q = p;
+                while (q < arg.size() && word(q)) ++q;
+                if (q > p) shape.reads.emplace(arg.substr(p, q - p));
+                p = q + 1;
+            }
+        }
+        switch (st.kind()) {
+            case StmtKind::Loc:
+            case StmtKind::Assign:
+                shape.writes.insert(st.str(0));
+                break;
+            case StmtKind::Catch:
+                if (args) shape.writes.insert(st.str(0));
+                break;
+            case StmtKind::Input:
+            case StmtKind::Import:
+            case StmtKind::UseNative:
+            case StmtKind::Const:
+            case StmtKind::Trap:
+                shape.volatileCode = true;
+                break;
+            default:
+                break;
+        }
+    }
+    return shape;
+}
+
+// Natives may answer differently each time, so units calling one always run.
+bool callsNative(const Context& ctx, const Code& code, uint32_t begin, uint32_t end) {
+    if (ctx.natives.empty()) return false;
+    for (uint32_t i = begin; i < end; ++i) {
+        Stmt st = code[i];
+        if (st.kind() == StmtKind::PrintCall && ctx.natives.count(st.str(0))) return true;
+    }
+    return false;
+}
+
+
+// Runs the units, replaying the ones the cache still holds for. Lives for
+// the run: it puts its captures on std::cout and std::cerr and hands the
+// entries it did not get to back to the cache when it goes.
+class Runner {
+public:
+    Runner(Context& ctx, const Code& code, Cache& cache)
+        : ctx(ctx), code(code), cache(cache), old(std::move(cache.entries)),
+          out(std::cout.rdbuf(), false, *this), err(std::cerr.rdbuf(), true, *this) {
+        cache.entries.clear();
+        std::cout.rdbuf(&out);
+        std::cerr.rdbuf(&err);
+    }
+    ~Runner() {
+        std::cout.rdbuf(out.target);
+        std::cerr.rdbuf(err.target);
+        for (; next < old.size(); ++next) cache.entries.push_back(old[next]);
+    }
+
+    bool changed = false;
+
+    void run() {
+        for (uint32_t pc = 0, end; pc < code.size(); pc = end) {
+            end = blockEnd(code, pc);
+            uint64_t hash = unitHash(code, pc, end);
+            ++stats.incrementalUnits;
+            for (; next < old.size() && old[next].at < pc; ++next) cache.entries.push_back(old[next]);
+            const Entry* entry = next < old.size() && old[next].at == pc ? &old[next++] : nullptr;
+            if (entry && entry->hash == hash && !callsNative(ctx, code, pc, end) && stillHolds(*entry)) {
+                replay(*entry);
+                cache.entries.push_back(*entry);
+                ++stats.incrementalReplayed;
+                continue;
+            }
+            Shape shape = shapeOf(code, pc, end);
+            Entry fresh{pc, static_cast<uint32_t>(cache.refs.size()), 0, 0,
+                        static_cast<uint32_t>(cache.pieces.size()), 0, hash};
+            for (const auto& name : shape.reads) record(name);
+            fresh.reads = static_cast<uint32_t>(shape.reads.size());
+            recording = &fresh;
+            runCode(ctx, code, pc, end);
+            recording = nullptr;
+            for (const auto& name : shape.writes) record(name);
+            fresh.writes = static_cast<uint32_t>(shape.writes.size());
+            if (!shape.volatileCode && !callsNative(ctx, code, pc, end)) cache.entries.push_back(fresh);
+            changed = true;
+        }
+        std::cout.flush();
+    }
+
+private:
+    // Passes output on to `target` and lets the runner keep a copy.
+    class CaptureBuf : public std::streambuf {
+    public:
+        CaptureBuf(std::streambuf* target, bool error, Runner& runner) : target(target), error(error), runner(runner) {}
+
+        std::streambuf* target;
+
+    protected:
+        int overflow(int c) override {
+            if (c == traits_type::eof()) return traits_type::not_eof(c);
+            char ch = static_cast<char>(c);
+            runner.keep(error, &ch, 1);
+            return target->sputc(ch);
+        }
+        std::streamsize xsputn(const char* s, std::streamsize n) override {
+            runner.keep(error, s, n);
+            return target->sputn(s, n);
+        }
+        int sync() override { return target->pubsync(); }
+
+    private:
+        bool error;
+        Runner& runner;
+    };
+
+    void keep(bool error, const char* s, std::streamsize n) {
+        if (!recording) return;
+        if (!recording->pieces || cache.pieces.back().error != error) {
+            cache.pieces.push_back({cache.output.size(), 0, error});
+            ++recording->pieces;
+        }
+        cache.output.append(s, static_cast<size_t>(n));
+        cache.pieces.back().size += static_cast<uint64_t>(n);
+    }
+
+    void record(const std::string& name) {
+        Ref ref{cache.intern(name), none, 0};
+        auto it = ctx.variables.find(name);
+        if (it != ctx.variables.end()) {
+            ref.type = cache.intern(it->second.type);
+            ref.value = cache.intern(it->second.value);
+        }
+        cache.refs.push_back(ref);
+    }
+
+    // Variables are never removed, so one found stays where it is.
+    const Variable* lookup(uint32_t name) {
+        if (name >= bound.size()) bound.resize(cache.strings.size(), nullptr);
+        if (!bound[name]) {
+            auto it = ctx.variables.find(cache.strings[name]);
+            if (it != ctx.variables.end()) bound[name] = &it->second;
+        }
+        return bound[name];
+    }
+
+    // Every variable the unit could read is as it was when it ran.
+    bool stillHolds(const Entry& entry) {
+        for (uint32_t i = 0; i < entry.reads; ++i) {
+            const Ref& ref = cache.refs[entry.firstRef + i];
+            const Variable* var = lookup(ref.name);
+            if (!var ? ref.type != none
+                     : ref.type == none || var->type != cache.strings[ref.type] ||
+                           var->value != cache.strings[ref.value])
+                return false;
+        }
+        return true;
+    }
+
+    void replay(const Entry& entry) {
+        for (uint32_t i = 0; i < entry.writes; ++i) {
+            // one left undeclared was undeclared before too: it is also read
+            const Ref& ref = cache.refs[entry.firstRef + entry.reads + i];
+            if (ref.type != none) ctx.variables[cache.strings[ref.name]] = {cache.strings[ref.type], cache.strings[ref.value]};
+        }
+        for (uint32_t i = 0; i < entry.pieces; ++i) {
+            const Piece& piece = cache.pieces[entry.firstPiece + i];
+            // flush what std::cerr is tied to, as writing to it would, so
+            // both streams interleave as they did
+            if (piece.error && std::cerr.tie()) std::cerr.tie()->flush();
+            (piece.error ? err : out)
+                .target->sputn(cache.output.data() + piece.offset, static_cast<std::streamsize>(piece.size));
+        }
+    }
+
+    Context& ctx;
+    const Code& code;
+    Cache& cache;
+    std::vector<Entry> old;
+    size_t next = 0;
+    Entry* recording = nullptr;
+    std::vector<const Variable*> bound; // by name id
+    CaptureBuf out, err;
+};
+
+}
+
+bool setGlobal(Module& root, const std::string& name, const std::string& value, std::string& error) {
+    for (Stmt st : root.code) {
+        if (st.kind() != StmtKind::Loc || st.str(0) != name) continue;
+        std::string type = st.str(1);
+        bool quoted = value.size() >= 2 && value.front() == '"' && value.back() == '"';
+        root.code.replace(st.index(), StmtKind::Loc, {name, type, type == "str" && !quoted ? '"' + value + '"' : value});
+        return true;
+    }
+    error = "no loc " + name + " in " + root.path;
+    return false;
+}
+
+uint64_t graphFingerprint(const Module& root) {
+    std::set<const Module*> seen;
+    std::vector<const Module*> pending{&root};
+    uint64_t h = 14695981039346656037ULL;
+    while (!pending.empty()) {
+        const Module* mod = pending.back();
+        pending.pop_back();
+        if (!seen.insert(mod).second) continue;
+        h = (h ^ sourceFingerprint(mod->path)) * 1099511628211ULL;
+        for (const Module* dep : mod->imports) pending.push_back(dep);
+    }
+    return h;
+}
+
+void runIncremental(Context& ctx, const Code& code, const std::string& path, uint64_t source) {
+    // the output kept is in the format it was printed in
+    if (outputFormat != OutputFormat::Text) source = (source ^ static_cast<uint64_t>(outputFormat)) * 1099511628211ULL;
+    Cache cache = load(path, source);
+    bool changed = true;
+    try {
+        Runner runner(ctx, code, cache);
+        runner.run();
+        changed = runner.changed;
+    } catch (...) {
+        if (!save(path, source, cache)) std::cerr << "Cannot save incremental cache: " << path << std::endl;
+        throw;
+    }
+    if (changed && !save(path, source, cache)) std::cerr << "Cannot save incremental cache: " << path << std::endl;
+}
@@ -0,0 +1,248 @@
+#include "h/interpreter.h"
+#include "h/debugger.h"
+#include "h/error.h"
+#include "h/evaluator.h"
+#include "h/executor.h"
+#include "h/jumptable.h"
+#include "h/module.h"
+#include "h/native.h"
+#include "h/output.h"
+#include "h/profile.h"
+#include "h/quicken.h"
+#include "h/utils.h"
+#include <iostream>
+#include <sstream>
+
+void processLoc(Context &ctx, const Stmt &st) {
+    int lineno = st.line();
+    std::string name = st.str(0), type = st.str(1), raw = st.str(2);
+    if (type == "str") {
+        if (raw.size() >= 2 && raw.front() == '"' && raw.back() == '"') {
+            raw = raw.substr(1, raw.size() - 2);
+        }
+        ctx.variables[name] = {"str", raw};
+    } else if (type == "int") {
+        std::string val = evalExpression(raw); // we assume that evalExpression returns a string representation of int
+        ctx.variables[name] = {"int", val};
+    } else if (type == "bool") {
+        std::string val = trim(raw);
+        if (val == "true" || val == "1") ctx.variables[name] = {"bool", "true"};
+        else if (val == "false" || val == "0") ctx.variables[name] = {"bool", "false"};
+        else raiseError(ErrorCode::InvalidValue, lineno, "Invalid bool value: " + val);
+    } else if (type == "arr") {
+        std::string rawList = trim(raw);
+        std::vector<std::string> elements;
+        std::stringstream ss(rawList);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            item = trim(item);
+            if (item.size() >= 2 && item.front() == '"' && item.back() == '"')
+                item = item.substr(1, item.size() - 2);
+            elements.push_back(item);
+        }
+        std::ostringstream os;
+        for (size_t i = 0; i < elements.size(); ++i) {
+            if (i) os << ",";
+            os << elements[i];
+        }
+        ctx.variables[name] = {"arr", os.str()};
+        
+    } else {
+        raiseError(ErrorCode::InvalidValue, lineno, "Unknown type for loc: " + type);
+    }
+}
+
+void processAssign(Context &ctx, const Stmt &st) {
+    int lineno = st.line();
+    std::string name = st.str(0);
+    if (!ctx.variables.count(name)) raiseError(ErrorCode::UndefinedVariable, lineno, "Undefined variable: " + name);
+    std::string rhs = st.str(1);
+    auto &var = ctx.variables[name];
+    if (var.type == "int") var.value = evalExpression(rhs);
+    else if (var.type == "bool") {
+        rhs = trim(rhs);
+        if (rhs == "true" || rhs == "1") var.value = "true";
+        else if (rhs == "false" || rhs == "0") var.value = "false";
+        else raiseError(ErrorCode::InvalidValue, lineno, "Invalid bool assignment: " + rhs);
+    } else {
+        if (rhs.size() >= 2 && rhs.front() == '"' && rhs.back() == '"') rhs = rhs.substr(1, rhs.size() - 2);
+        var.value = rhs;
+    }
+}
+
+void processInput(Context &ctx, const Stmt &st) {
+    int lineno = st.line();
+    std::string name = st.str(0), type = st.str(1);
+    std::string_view prompt = st.arg(2);
+    // records own stdout
+    (outputFormat == OutputFormat::Text ? std::cout : std::cerr) << prompt;
+    std::string input;
+    std::getline(std::cin, input);
+    if (type == "i") {
+        try { std::stoll(input); ctx.variables[name] = {"int", input}; }
+        catch (...) { raiseError(ErrorCode::BadInput, lineno, "Invalid input for int: " + input); }
+    } else ctx.variables[name] = {"str", input};
+}
+
+// `kind` is passed separately because a trapped statement's own kind is Trap.
+void processPrint(Context &ctx, const Stmt &st, StmtKind kind) {
+    int lineno = st.line();
+    if (kind == StmtKind::PrintText) {
+        // literal
+        printValue("str", st.arg(0));
+    } else if (kind == StmtKind::PrintVar) {
+        // variable
+        if (const Variable *v = quickLoad(ctx.variables, st)) {
+            printValue(v->type, v->value.view());
+            return;
+        }
+        std::string var = st.str(0);
+        if (!ctx.variables.count(var)) { std::cerr << "Undefined variable: " << var << std::endl; return; }
+        auto &v = ctx.variables[var];
+        printValue(v.type, v.value.view());
+    } else if (kind == StmtKind::PrintCall) {
+        std::string fname = st.str(0);
+        std::vector<std::string> args = st.args(1);
+        const FunctionDef *func = findFunction(ctx, fname);
+        if (!func && ctx.natives.count(fname)) {
+            const auto &native = ctx.natives[fname];
+            if (native.arity >= 0 && static_cast<int>(args.size()) != native.arity)
+                raiseError(ErrorCode::WrongArgCount, lineno, "Wrong argument count for " + fname);
+            for (auto &arg : args) {
+                if (ctx.variables.count(arg)) arg = ctx.variables[arg].value;
+                else arg = stripQuotes(arg);
+            }
+            printValue("str", callNative(native, args));
+            return;
+        }
+        if (!func) raiseError(ErrorCode::UndefinedFunction, lineno, "Undefined function: " + fname);
+        if (activeProfile) activeProfile->called(st);
+        std::string res;
+        try {
+            res = executeFunction(*func, args, ctx.functions, ctx.variables);
+        } catch (LoError &e) {
+            if (!e.line) e.line = lineno;
+            e.stack.push_back({sourceName(*func, fname), lineno});
+            throw;
+        }
+        printValue(func->returnType, res);
+    } else raiseError(ErrorCode::Syntax, lineno, "Bad print expression");
+}
+
+void processUseNative(Context &ctx, const Stmt &st) {
+    std::string error;
+    std::string path = st.str(0);
+    if (!loadNativeModule(path, ctx.natives, error))
+        raiseError(ErrorCode::NativeModule, st.line(), "Failed to load native module " + path + ": " + error);
+}
+
+void processImport(Context &ctx, const Stmt &st) {
+    std::string error;
+    const Module *mod = importModule(st.str(0), error);
+    if (!mod) raiseError(ErrorCode::Import, st.line(), error);
+    ctx.imports.push_back(mod);
+}
+
+// Where the if- chain headed at `head` goes on: into the body of the first
+// branch whose test holds, or to its end--.
+static uint32_t selectBranch(Context &ctx, const Code &code, Stmt head) {
+    uint32_t target;
+    const JumpTable *table = head.table();
+    if (table && table->select(ctx.variables, head.str(0), target)) return target;
+    if (table && !table->testOrder().empty()) {
+        for (uint32_t b : table->testOrder()) {
+            if (quickCondition(ctx.variables, code[b])) return b + 1;
+        }
+        return head.end();
+    }
+    for (uint32_t branch = head.index();;) {
+        Stmt b = code[branch];
+        if (quickCondition(ctx.variables, b)) return branch + 1;
+        branch = b.next();
+        if (branch >= code.size() || code[branch].kind() != StmtKind::Elif) return branch;
+    }
+}
+
+// Executes code[begin, end). if-/elif- chains jump straight to the next
+// branch or past end--, so skipped bodies are never looked at; match- and
+// lowered chains jump straight to the taken branch. try- bodies
+// run in a nested call, so the only cost of being catchable is that call.
+static void runRange(Context &ctx, const Code &code, uint32_t begin, uint32_t end) {
+    uint32_t pc = begin;
+    try {
+        while (pc < end) {
+            Stmt st = code[pc];
+            StmtKind kind = st.kind();
+        dispatch:
+            switch (kind) {
+                case StmtKind::If: {
+                    uint32_t target = selectBranch(ctx, code, st);
+                    if (activeProfile) activeProfile->chainRan(st, target);
+                    pc = target;
+                    continue;
+                }
+                case StmtKind::Match: {
+                    std::string name = st.str(0);
+                    auto var = ctx.variables.find(name);
+                    if (var == ctx.variables.end())
+                        raiseError(ErrorCode::UndefinedVariable, st.line(), "Undefined variable: " + name);
+                    if (!st.table()->select(ctx.variables, name, pc))
+                        raiseError(ErrorCode::InvalidValue, st.line(), "Invalid integer: " + var->second.value);
+                    continue;
+                }
+                case StmtKind::Elif:
+                case StmtKind::Case:
+                case StmtKind::Catch:
+                    // reached by falling out of the previous branch
+                    pc = st.end();
+                    continue;
+                case StmtKind::Try:
+                    try {
+                        runRange(ctx, code, pc + 1, st.next());
+                        pc = st.end();
+                    } catch (const LoError &e) {
+                        Stmt handler = code[st.next()];
+                        if (handler.argCount()) ctx.variables[handler.str(0)] = {"str", e.what()};
+                        pc = st.next() + 1;
+                    }
+                    continue;
+                case StmtKind::End: break;
+                case StmtKind::Import: processImport(ctx, st); break;
+                case StmtKind::UseNative: processUseNative(ctx, st); break;
+                case StmtKind::Loc: processLoc(ctx, st); break;
+                case StmtKind::Input: processInput(ctx, st); break;
+                case StmtKind::Assign:
+                    if (!quickAssign(ctx.variables, st)) processAssign(ctx, st);
+                    break;
+                case StmtKind::PrintText:
+                case StmtKind::PrintVar:
+                case StmtKind::PrintCall: processPrint(ctx, st, kind); break;
+                case StmtKind::Const: raiseError(ErrorCode::Syntax, st.line(), "const was not evaluated"); break;
+                case StmtKind::Return: raiseError(ErrorCode::Syntax, st.line(), "return outside of funS"); break;
+                case StmtKind::Trap:
+                    kind = debugTrap(st, nullptr, nullptr);
+                    goto dispatch;
+            }
+            pc++;
+        }
+    } catch (LoError &e) {
+        // errors raised below statement level (e.g. by the evaluator) get
+        // the line of the statement that was running
+        if (!e.line) e.line = code[pc].line();
+        throw;
+    }
+}
+
+void runCode(Context &ctx, const Code &code) {
+    runRange(ctx, code, 0, code.size());
+}
+
+void runCode(Context &ctx, const Code &code, uint32_t begin, uint32_t end) {
+    runRange(ctx, code, begin, end);
+}
+
+uint32_t blockEnd(const Code &code, uint32_t begin) {
+    Stmt head = code[begin];
+    StmtKind kind = head.kind();
+    return kind == StmtKind::If || kind == StmtKind::Try || kind == StmtKind::Match ? head.end() + 1 : begin + 1;
+}
@@ -0,0 +1,579 @@
+#include "h/ir.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+bool isTerminator(IrOp op) {
+    return op >= IrOp::Jump;
+}
+
+bool definesValue(IrOp op) {
+    switch (op) {
+        case IrOp::Undef:
+        case IrOp::Opaque:
+        case IrOp::Loc:
+        case IrOp::Assign:
+        case IrOp::Input:
+        case IrOp::Caught:
+        case IrOp::Phi:
+        case IrOp::Cmp:
+            return true;
+        default:
+            return false;
+    }
+}
+
+namespace {
+
+// Walks the structured code once. The stores visible at the current point
+// live in one map; each block records what it changes in an undo log, so
+// entering and leaving a branch costs what the branch itself stores.
+class IrBuilder {
+public:
+    explicit IrBuilder(const Code& code) : code(code) {
+        IrInst undef;
+        undef.op = IrOp::Undef;
+        ir.insts.push_back(std::move(undef));
+        ir.instOf.assign(code.size(), Code::none);
+        // about one instruction per statement, a test and a branch per if-/elif-
+        ir.insts.reserve(code.size() + code.size() / 2 + 2);
+        ir.blocks.reserve(code.size() / 2 + 1);
+        ir.blocks.emplace_back();
+    }
+
+    IrProgram build() {
+        range(0, code.size());
+        terminate(IrOp::Exit, 0, 0);
+        return std::move(ir);
+    }
+
+private:
+    using Changes = std::vector<std::pair<std::string, uint32_t>>; // name -> store at the end of a branch
+
+    struct Incoming {
+        uint32_t block;
+        Changes changes;
+    };
+
+    uint32_t add(IrInst inst) {
+        inst.block = current;
+        auto id = static_cast<uint32_t>(ir.insts.size());
+        ir.insts.push_back(std::move(inst));
+        ir.blocks[current].insts.push_back(id);
+        return id;
+    }
+
+    uint32_t add(IrOp op, Stmt st) {
+        IrInst inst;
+        inst.op = op;
+        inst.stmt = st.index();
+        inst.line = st.line();
+        return add(std::move(inst));
+    }
+
+    uint32_t lookup(std::string_view name) const {
+        auto it = stores.find(std::string(name));
+        return it == stores.end() ? 0 : it->second;
+    }
+
+    void define(const std::string& name, uint32_t id) {
+        uint32_t& slot = stores[name];
+        undo.emplace_back(name, slot);
+        slot = id;
+        if (!tryDefs.empty()) tryDefs.back().push_back(id);
+    }
+
+    // Stores made since `mark`, then back to the state at `mark`.
+    Changes rollback(size_t mark) {
+        Changes changes;
+        std::unordered_set<std::string> seen;
+        for (size_t i = undo.size(); i-- > mark;) {
+            const std::string& name = undo[i].first;
+            if (seen.insert(name).second) changes.emplace_back(name, stores[name]);
+        }
+        for (size_t i = undo.size(); i-- > mark;) stores[undo[i].first] = undo[i].second;
+        undo.resize(mark);
+        return changes;
+    }
+
+    uint32_t newBlock() {
+        ir.blocks.emplace_back();
+        return static_cast<uint32_t>(ir.blocks.size() - 1);
+    }
+
+    void link(uint32_t from, uint32_t to) {
+        ir.blocks[from].succs.push_back(to);
+        ir.blocks[to].preds.push_back(from);
+    }
+
+    // Ends the current block; its successors are linked by the caller.
+    void terminate(IrOp op, uint32_t operand, uint32_t stmt) {
+        IrInst inst;
+        inst.op = op;
+        if (op == IrOp::Branch || op == IrOp::Switch) inst.operands.push_back(operand);
+        if (stmt != Code::none && op != IrOp::Exit) {
+            inst.stmt = stmt;
+            inst.line = code[stmt].line();
+        }
+        uint32_t id = add(std::move(inst));
+        if (op == IrOp::Branch || op == IrOp::Switch) ir.instOf[stmt] = id;
+    }
+
+    // Starts a block where the incoming branches meet, merging their
+    // stores with phis; a branch that did not store a name brings the
+    // store from before the block.
+    void join(std::vector<Incoming>& incoming, uint32_t stmt) {
+        current = newBlock();
+        std::unordered_map<std::string, std::vector<uint32_t>> merged;
+        std::vector<std::string> order;
+        for (size_t i = 0; i < incoming.size(); ++i) {
+            link(incoming[i].block, current);
+            for (const auto& [name, id] : incoming[i].changes) {
+                auto& ops = merged[name];
+                if (ops.empty()) {
+                    order.push_back(name);
+                    ops.assign(incoming.size(), lookup(name));
+                }
+                ops[i] = id;
+            }
+        }
+        for (const std::string& name : order) {
+            const auto& ops = merged[name];
+            bool same = true;
+            for (uint32_t id : ops) same = same && id == ops.front();
+            if (same) {
+                define(name, ops.front());
+                continue;
+            }
+            IrInst phi;
+            phi.op = IrOp::Phi;
+            phi.name = name;
+            phi.stmt = stmt;
+            phi.line = code[stmt].line();
+            phi.operands = ops;
+            define(name, add(std::move(phi)));
+        }
+    }
+
+    void jumpFrom(uint32_t block, std::vector<Incoming>& incoming, Changes changes) {
+        uint32_t saved = current;
+        current = block;
+        terminate(IrOp::Jump, 0, Code::none);
+        current = saved;
+        incoming.push_back({block, std::move(changes)});
+    }
+
+    void range(uint32_t begin, uint32_t end) {
+        for (uint32_t pc = begin; pc < end;) {
+            Stmt st = code[pc];
+            switch (st.kind()) {
+                case StmtKind::If: pc = chain(st); continue;
+                case StmtKind::Match: pc = match(st); continue;
+                case StmtKind::Try: pc = tryBlock(st); continue;
+                default: statement(st); break;
+            }
+            ++pc;
+        }
+    }
+
+    void statement(Stmt st) {
+        uint32_t id = Code::none;
+        switch (st.kind()) {
+            case StmtKind::Loc:
+            case StmtKind::Input: {
+                id = add(st.kind() == StmtKind::Loc ? IrOp::Loc : IrOp::Input, st);
+                IrInst& inst = ir.insts[id];
+                inst.name = st.str(0);
+                inst.type = st.str(1);
+                inst.text = st.str(2);
+                define(inst.name, id);
+                break;
+            }
+            case StmtKind::Assign: {
+                id = add(IrOp::Assign, st);
+                IrInst& inst = ir.insts[id];
+                inst.name = st.str(0);
+                inst.text = st.str(1);
+                inst.operands.push_back(lookup(inst.name));
+                define(inst.name, id);
+                break;
+            }
+            case StmtKind::PrintVar:
+                id = add(IrOp::Print, st);
+                ir.insts[id].name = st.str(0);
+                ir.insts[id].operands.push_back(lookup(st.arg(0)));
+                break;
+            case StmtKind::PrintText:
+                id = add(IrOp::PrintText, st);
+                ir.insts[id].text = st.str(0);
+                break;
+            case StmtKind::PrintCall: {
+                id = add(IrOp::Call, st);
+                IrInst& inst = ir.insts[id];
+                inst.text = st.str(0);
+                inst.args = st.args(1);
+                for (const auto& arg : inst.args) inst.operands.push_back(arg.empty() || arg.front() == '"' ? 0 : lookup(arg));
+                break;
+            }
+            case StmtKind::End:
+                return;
+            default:
+                id = add(IrOp::Effect, st);
+                ir.insts[id].text = st.argCount() ? st.str(0) : "";
+                break;
+        }
+        ir.instOf[st.index()] = id;
+    }
+
+    // if- and its elif-s: a test block per branch, the last test falling
+    // through to the join.
+    uint32_t chain(Stmt head) {
+        std::vector<Incoming> incoming;
+        for (uint32_t b = head.index();;) {
+            Stmt st = code[b];
+            IrInst cmp;
+            cmp.op = IrOp::Cmp;
+            cmp.stmt = b;
+            cmp.line = st.line();
+            cmp.type = st.str(1);
+            cmp.text = st.str(2);
+            cmp.name = st.str(0);
+            cmp.operands = {lookup(st.arg(0)), lookup(st.arg(2))};
+            uint32_t cond = add(std::move(cmp));
+            terminate(IrOp::Branch, cond, b);
+            uint32_t test = current;
+
+            current = newBlock();
+            link(test, current);
+            size_t mark = undo.size();
+            range(b + 1, st.next());
+            uint32_t bodyEnd = current;
+            jumpFrom(bodyEnd, incoming, rollback(mark));
+
+            uint32_t next = st.next();
+            bool more = next < code.size() && code[next].kind() == StmtKind::Elif;
+            if (!more) {
+                incoming.push_back({test, {}});
+                break;
+            }
+            current = newBlock();
+            link(test, current);
+            b = next;
+        }
+        join(incoming, head.end());
+        return head.end() + 1;
+    }
+
+    uint32_t match(Stmt head) {
+        std::vector<Incoming> incoming;
+        std::vector<uint32_t> cases;
+        for (uint32_t c = head.next(); c < head.end(); c = code[c].next()) cases.push_back(c);
+        std::vector<std::string> labels;
+        for (uint32_t c : cases) labels.push_back(code[c].str(0));
+        terminate(IrOp::Switch, lookup(head.arg(0)), head.index());
+        ir.insts[ir.blocks[current].insts.back()].args = std::move(labels);
+        ir.insts[ir.blocks[current].insts.back()].name = head.str(0);
+        uint32_t test = current;
+        for (uint32_t c : cases) {
+            current = newBlock();
+            link(test, current);
+            size_t mark = undo.size();
+            range(c + 1, code[c].next());
+            jumpFrom(current, incoming, rollback(mark));
+        }
+        incoming.push_back({test, {}});
+        join(incoming, head.end());
+        return head.end() + 1;
+    }
+
+    // The handler may start after any statement of the body, so it sees
+    // each name the body stores as an opaque value that may come from any
+    // of those stores or from before the try-.
+    uint32_t tryBlock(Stmt head) {
+        terminate(IrOp::Try, 0, head.index());
+        uint32_t entry = current;
+        std::vector<Incoming> incoming;
+
+        current = newBlock();
+        link(entry, current);
+        size_t mark = undo.size();
+        tryDefs.emplace_back();
+        range(head.index() + 1, head.next());
+        std::vector<uint32_t> bodyDefs = std::move(tryDefs.back());
+        tryDefs.pop_back();
+        if (!tryDefs.empty()) tryDefs.back().insert(tryDefs.back().end(), bodyDefs.begin(), bodyDefs.end());
+        jumpFrom(current, incoming, rollback(mark));
+
+        current = newBlock();
+        link(entry, current);
+        mark = undo.size();
+        std::unordered_map<std::string, uint32_t> opaque;
+        Stmt handler = code[head.next()];
+        for (uint32_t def : bodyDefs) {
+            const std::string& name = ir.insts[def].name;
+            auto [it, fresh] = opaque.try_emplace(name, 0);
+            if (fresh) {
+                IrInst inst;
+                inst.op = IrOp::Opaque;
+                inst.name = name;
+                inst.stmt = handler.index();
+                inst.line = handler.line();
+                inst.operands.push_back(lookup(name));
+                it->second = add(std::move(inst));
+            }
+            ir.insts[it->second].operands.push_back(def);
+        }
+        for (const auto& [name, id] : opaque) define(name, id);
+        if (handler.argCount()) {
+            uint32_t id = add(IrOp::Caught, handler);
+            ir.insts[id].name = handler.str(0);
+            define(ir.insts[id].name, id);
+        }
+        range(head.next() + 1, head.end());
+        jumpFrom(current, incoming, rollback(mark));
+
+        join(incoming, head.end());
+        return head.end() + 1;
+    }
+
+    const Code& code;
+    IrProgram ir;
+    uint32_t current = 0;
+    std::unordered_map<std::string, uint32_t> stores;
+    std::vector<std::pair<std::string, uint32_t>> undo; // name, store it replaced
+    std::vector<std::vector<uint32_t>> tryDefs;         // stores made in each enclosing try- body
+};
+
+const char* opName(IrOp op) {
+    switch (op) {
+        case IrOp::Undef: return "undef";
+        case IrOp::Opaque: return "opaque";
+        case IrOp::Loc: return "loc";
+        case IrOp::Assign: return "assign";
+        case IrOp::Input: return "input";
+        case IrOp::Caught: return "caught";
+        case IrOp::Phi: return "phi";
+        case IrOp::Cmp: return "cmp";
+        case IrOp::Print: return "print";
+        case IrOp::PrintText: return "print";
+        case IrOp::Call: return "call";
+        case IrOp::Effect: return "effect";
+        case IrOp::Jump: return "jump";
+        case IrOp::Branch: return "branch";
+        case IrOp::Switch: return "switch";
+        case IrOp::Try: return "try";
+        case IrOp::Exit: return "exit";
+    }
+    return "?";
+}
+
+std::string quoted(const std::string& s) {
+    return "\"" + s + "\"";
+}
+
+}
+
+IrDominators::IrDominators(const IrProgram& ir)
+    : idom(ir.blocks.size(), 0), jump(ir.blocks.size(), 0), depth(ir.blocks.size(), 0), enter(ir.blocks.size()),
+      leave(ir.blocks.size()) {
+    // predecessors come first, so one pass settles every block
+    for (uint32_t b = 1; b < ir.blocks.size(); ++b) {
+        uint32_t d = Code::none;
+        for (uint32_t p : ir.blocks[b].preds) d = d == Code::none ? p : intersect(d, p);
+        if (d == Code::none) d = 0;
+        idom[b] = d;
+        depth[b] = depth[d] + 1;
+        // skew-binary jump pointers: any ancestor is O(log depth) jumps away
+        uint32_t j = jump[d];
+        jump[b] = depth[d] - depth[j] == depth[j] - depth[jump[j]] ? jump[j] : d;
+    }
+    // children of each block, grouped by parent
+    std::vector<uint32_t> first(ir.blocks.size() + 1, 0), children(ir.blocks.size());
+    for (uint32_t b = 1; b < ir.blocks.size(); ++b) ++first[idom[b] + 1];
+    for (size_t b = 1; b < first.size(); ++b) first[b] += first[b - 1];
+    std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+    for (uint32_t b = 1; b < ir.blocks.size(); ++b) children[fill[idom[b]]++] = b;
+    std::vector<std::pair<uint32_t, size_t>> stack{{0, 0}};
+    uint32_t clock = 0;
+    enter[0] = clock++;
+    while (!stack.empty()) {
+        auto& [b, next] = stack.back();
+        if (first[b] + next < first[b + 1]) {
+            uint32_t c = children[first[b] + next++];
+            enter[c] = clock++;
+            stack.push_back({c, 0});
+        } else {
+            leave[b] = clock++;
+            stack.pop_back();
+        }
+    }
+}
+
+uint32_t IrDominators::intersect(uint32_t a, uint32_t b) const {
+    // ancestors have lower indices, so a jump that stays above the other
+    // block skips nothing either could meet at
+    while (a != b) {
+        while (a > b) a = jump[a] > b ? jump[a] : idom[a];
+        while (b > a) b = jump[b] > a ? jump[b] : idom[b];
+    }
+    return a;
+}
+
+IrProgram buildIr(const Code& code) {
+    return IrBuilder(code).build();
+}
+
+std::string verifyIr(const IrProgram& ir) {
+    auto at = [](uint32_t id) { return "%" + std::to_string(id); };
+    if (ir.insts.empty() || ir.insts[0].op != IrOp::Undef) return "insts[0] is not undef";
+    if (ir.blocks.empty() || !ir.blocks[0].preds.empty()) return "entry block has predecessors";
+    std::vector<uint32_t> position(ir.insts.size(), Code::none);
+    std::vector<uint64_t> inEdges, outEdges; // from << 32 | to
+    for (uint32_t b = 0; b < ir.blocks.size(); ++b) {
+        const IrBlock& block = ir.blocks[b];
+        std::string where = "b" + std::to_string(b);
+        if (block.insts.empty() || !isTerminator(ir.insts[block.insts.back()].op))
+            return where + " does not end in a terminator";
+        for (uint32_t p : block.preds) {
+            if (p >= b) return where + " comes before its predecessor b" + std::to_string(p);
+            inEdges.push_back(uint64_t(p) << 32 | b);
+        }
+        for (uint32_t s : block.succs) {
+            if (s >= ir.blocks.size()) return where + " has a missing successor";
+            outEdges.push_back(uint64_t(b) << 32 | s);
+        }
+        bool phis = true;
+        for (size_t i = 0; i < block.insts.size(); ++i) {
+            uint32_t id = block.insts[i];
+            if (id == 0 || id >= ir.insts.size() || position[id] != Code::none) return where + " lists a bad instruction";
+            position[id] = static_cast<uint32_t>(i);
+            const IrInst& inst = ir.insts[id];
+            if (inst.block != b) return at(id) + " is listed in another block";
+            if (isTerminator(inst.op) != (i + 1 == block.insts.size())) return at(id) + ": terminator not at the end";
+            if (inst.op == IrOp::Phi && !phis) return at(id) + ": phi after other instructions";
+            phis = phis && inst.op == IrOp::Phi;
+            if (inst.op == IrOp::Phi && inst.operands.size() != block.preds.size())
+                return at(id) + ": phi arity differs from the predecessors";
+            if (inst.op == IrOp::Opaque && (block.preds.size() != 1 ||
+                                            ir.insts[ir.blocks[block.preds[0]].insts.back()].op != IrOp::Try))
+                return at(id) + ": opaque value outside a catch- handler";
+        }
+        const IrInst& last = ir.insts[block.insts.back()];
+        size_t want = last.op == IrOp::Jump ? 1 : last.op == IrOp::Branch || last.op == IrOp::Try ? 2
+                    : last.op == IrOp::Switch ? last.args.size() + 1 : 0;
+        if (block.succs.size() != want) return where + ": wrong number of successors for " + opName(last.op);
+        if ((last.op == IrOp::Branch || last.op == IrOp::Switch) != (last.operands.size() == 1))
+            return where + ": wrong number of operands for " + opName(last.op);
+        if (last.op == IrOp::Branch && ir.insts[last.operands[0]].op != IrOp::Cmp) return where + ": branch on a non-cmp";
+    }
+
+    std::sort(inEdges.begin(), inEdges.end());
+    std::sort(outEdges.begin(), outEdges.end());
+    if (inEdges != outEdges) return "predecessor and successor lists disagree";
+
+    IrDominators dom(ir);
+    for (uint32_t id = 1; id < ir.insts.size(); ++id) {
+        const IrInst& inst = ir.insts[id];
+        if (position[id] == Code::none) return at(id) + " is in no block";
+        for (size_t i = 0; i < inst.operands.size(); ++i) {
+            uint32_t op = inst.operands[i];
+            if (op >= ir.insts.size() || !definesValue(ir.insts[op].op)) return at(id) + " uses a non-value";
+            if (op == 0) continue;
+            const IrInst& def = ir.insts[op];
+            bool ok;
+            if (inst.op == IrOp::Phi) {
+                ok = dom.dominates(def.block, ir.blocks[inst.block].preds[i]);
+            } else if (inst.op == IrOp::Opaque) {
+                // the entry store or one made in the try- body
+                uint32_t entry = ir.blocks[inst.block].preds.at(0);
+                ok = dom.dominates(def.block, entry) || dom.dominates(entry, def.block);
+            }
+            else if (def.block == inst.block) ok = position[op] < position[id];
+            else ok = dom.dominates(def.block, inst.block);
+            if (!ok) return at(op) + " does not dominate its use in " + at(id);
+        }
+    }
+    return "";
+}
+
+void dumpIr(const IrProgram& ir, std::ostream& out) {
+    for (uint32_t b = 0; b < ir.blocks.size(); ++b) {
+        const IrBlock& block = ir.blocks[b];
+        out << "b" << b << ":";
+        if (!block.preds.empty()) {
+            out << " ; preds";
+            for (uint32_t p : block.preds) out << " b" << p;
+        }
+        if (!block.reachable) out << " ; unreachable";
+        out << "\n";
+        for (uint32_t id : block.insts) {
+            const IrInst& inst = ir.insts[id];
+            out << "  ";
+            if (inst.dead) out << "dead ";
+            if (definesValue(inst.op)) out << "%" << id << " = ";
+            out << opName(inst.op);
+            if (!inst.name.empty() && inst.op != IrOp::Print) out << " " << inst.name;
+            if (!inst.type.empty()) out << " " << inst.type;
+            auto operand = [&](size_t i) {
+                uint32_t op = inst.operands[i];
+                return op ? "%" + std::to_string(op) : std::string("undef");
+            };
+            switch (inst.op) {
+                case IrOp::Phi:
+                    for (size_t i = 0; i < inst.operands.size(); ++i)
+                        out << (i ? ", [" : " [") << operand(i) << ", b" << block.preds[i] << "]";
+                    break;
+                case IrOp::Cmp:
+                    out << " " << operand(0) << ", " << (inst.operands[1] ? operand(1) : inst.text);
+                    break;
+                case IrOp::Call:
+                    out << " f-" << inst.text << "(";
+                    for (size_t i = 0; i < inst.args.size(); ++i)
+                        out << (i ? ", " : "") << (inst.operands[i] ? operand(i) : inst.args[i]);
+                    out << ")";
+                    break;
+                case IrOp::Switch:
+                    out << " " << operand(0);
+                    for (size_t i = 0; i < inst.args.size(); ++i) out << ", " << inst.args[i] << " -> b" << block.succs[i];
+                    out << ", miss -> b" << block.succs.back();
+                    break;
+                case IrOp::Branch:
+                    out << " " << operand(0) << ", b" << block.succs[0] << ", b" << block.succs[1];
+                    break;
+                case IrOp::Jump:
+                    out << " b" << block.succs[0];
+                    break;
+                case IrOp::Try:
+                    out << " b" << block.succs[0] << ", catch b" << block.succs[1];
+                    break;
+                case IrOp::Loc:
+                    out << "(" << inst.text << ")";
+                    break;
+                case IrOp::PrintText:
+                case IrOp::Input:
+                    out << " " << quoted(inst.text);
+                    break;
+                case IrOp::Effect:
+                    if (!inst.text.empty()) out << " " << quoted(inst.text);
+                    break;
+                default:
+                    for (size_t i = 0; i < inst.operands.size(); ++i) out << (i ? ", " : " ") << operand(i);
+                    if (inst.op == IrOp::Assign) out << ", " << inst.text;
+                    break;
+            }
+            std::string notes;
+            if (inst.line) notes += "line " + std::to_string(inst.line);
+            if (ir.optimized && definesValue(inst.op)) {
+                const IrValue& v = inst.known;
+                notes += (notes.empty() ? "" : ", ") + std::string("vn ") + std::to_string(inst.vn);
+                if (v.exists == IrValue::Exists::No) notes += ", absent";
+                else if (v.constant) notes += ", " + v.type + " " + quoted(v.value);
+                else if (!v.type.empty()) notes += ", " + v.type;
+            }
+            if (ir.optimized && inst.taken >= 0) notes += (notes.empty() ? "" : ", ") + std::string("taken b") +
+                                                          std::to_string(block.succs[inst.taken]);
+            if (!notes.empty()) out << "  ; " << notes;
+            out << "\n";
+        }
+    }
+}
@@ -0,0 +1,460 @@
+#include "h/ir.h"
+#include "h/compiler.h"
+#include "h/evaluator.h"
+#include "h/output.h"
+#include "h/stats.h"
+#include "h/utils.h"
+#include <unordered_map>
+
+namespace {
+
+const uint32_t absentVn = 1; // value number of every variable that does not exist
+
+std::string unquote(const std::string& s) {
+    return s.size() >= 2 && s.front() == '"' && s.back() == '"' ? s.substr(1, s.size() - 2) : s;
+}
+
+// Stores that lowerIr writes as a loc- of their value.
+bool foldedStore(const IrInst& inst) {
+    return (inst.op == IrOp::Loc || inst.op == IrOp::Assign) && inst.known.constant;
+}
+
+// Stores that cannot raise, so nothing is lost when an unread one goes.
+bool removable(const IrInst& inst) {
+    return foldedStore(inst) || (inst.op == IrOp::Loc && inst.type == "arr");
+}
+
+// print-- of a value that lowerIr can write as a literal.
+bool printsLiteral(const IrProgram& ir, const IrInst& print) {
+    const IrValue& v = ir.insts[print.operands[0]].known;
+    return v.exists == IrValue::Exists::Yes && v.constant && v.type != "arr" && v.value.find('"') == std::string::npos &&
+           printFoldable(v.type);
+}
+
+// Joins what is known about values that may reach one point.
+IrValue meet(const std::vector<const IrValue*>& values) {
+    IrValue out;
+    bool yes = true, no = true, typed = true, constant = true;
+    const IrValue* typeFrom = nullptr;
+    for (const IrValue* v : values) {
+        yes = yes && v->exists == IrValue::Exists::Yes;
+        no = no && v->exists == IrValue::Exists::No;
+        if (v->exists == IrValue::Exists::No) continue;
+        if (!typeFrom) typeFrom = v;
+        typed = typed && !v->type.empty() && v->type == typeFrom->type;
+        constant = constant && v->constant && v->value == typeFrom->value;
+    }
+    out.exists = yes ? IrValue::Exists::Yes : no ? IrValue::Exists::No : IrValue::Exists::Maybe;
+    if (typeFrom && typed) out.type = typeFrom->type;
+    if (yes && typed && constant) {
+        out.constant = true;
+        out.value = typeFrom->value;
+    }
+    return out;
+}
+
+// One pass in block order: a block runs when an executable edge reaches
+// it, values get numbers so that equal numbers hold equal values, and a
+// branch is decided by a constant condition or by a dominating branch on
+// the same condition number. Liveness then marks every store that a kept
+// statement reads; stores nothing reads and that cannot raise are dead.
+class Optimizer {
+public:
+    explicit Optimizer(IrProgram& ir) : ir(ir), dom(ir) {}
+
+    void run() {
+        ir.insts[0].known.exists = IrValue::Exists::No;
+        ir.insts[0].vn = absentVn;
+        for (uint32_t b = 0; b < ir.blocks.size(); ++b) {
+            IrBlock& block = ir.blocks[b];
+            block.reachable = b == 0;
+            for (uint32_t p : block.preds) block.reachable = block.reachable || edge(p, b);
+            if (!block.reachable) continue;
+            for (uint32_t id : block.insts) number(b, ir.insts[id]);
+        }
+        sweep();
+        ir.optimized = true;
+        stats.irInstructions += ir.insts.size() - 1;
+        stats.irBlocks += ir.blocks.size();
+        for (const IrInst& inst : ir.insts) {
+            if (!ir.blocks[inst.block].reachable || &inst == &ir.insts[0]) continue;
+            if (foldedStore(inst) || (inst.op == IrOp::Print && printsLiteral(ir, inst))) ++stats.irFoldedValues;
+            if (inst.taken >= 0) ++stats.irFoldedBranches;
+            if (inst.dead && inst.op != IrOp::Phi) ++stats.irDeadStores;
+        }
+    }
+
+private:
+    bool edge(uint32_t from, uint32_t to) const {
+        const IrBlock& block = ir.blocks[from];
+        if (!block.reachable) return false;
+        int taken = ir.insts[block.insts.back()].taken;
+        return taken < 0 || block.succs[taken] == to;
+    }
+
+    const IrValue& known(uint32_t id) const { return ir.insts[id].known; }
+
+    void fresh(IrInst& inst) { inst.vn = nextVn++; }
+
+    void setConstant(IrInst& inst, const std::string& type, const std::string& value) {
+        inst.known.exists = IrValue::Exists::Yes;
+        inst.known.type = type;
+        inst.known.constant = true;
+        inst.known.value = value;
+        auto [it, added] = constants.try_emplace(type + '\0' + value, nextVn);
+        if (added) ++nextVn;
+        inst.vn = it->second;
+    }
+
+    void number(uint32_t b, IrInst& inst) {
+        switch (inst.op) {
+            case IrOp::Loc: return loc(inst);
+            case IrOp::Assign: return assign(inst);
+            case IrOp::Input:
+                inst.known = {IrValue::Exists::Yes, inst.type == "i" ? "int" : "str", false, ""};
+                return fresh(inst);
+            case IrOp::Caught:
+                inst.known = {IrValue::Exists::Yes, "str", false, ""};
+                return fresh(inst);
+            case IrOp::Phi:
+            case IrOp::Opaque: return merge(b, inst);
+            case IrOp::Cmp: return compare(inst);
+            case IrOp::Branch: return branch(b, inst);
+            case IrOp::Switch: return select(inst);
+            default: return;
+        }
+    }
+
+    void loc(IrInst& inst) {
+        inst.known = {IrValue::Exists::Yes, inst.type, false, ""};
+        if (inst.type == "int") {
+            try {
+                return setConstant(inst, "int", evalExpression(inst.text));
+            } catch (...) {
+            }
+        } else if (inst.type == "str") {
+            return setConstant(inst, "str", unquote(inst.text));
+        } else if (inst.type == "bool") {
+            std::string v = trim(inst.text);
+            if (v == "true" || v == "1") return setConstant(inst, "bool", "true");
+            if (v == "false" || v == "0") return setConstant(inst, "bool", "false");
+        }
+        fresh(inst);
+    }
+
+    // An assignment keeps the variable's type and raises if there is none.
+    void assign(IrInst& inst) {
+        const IrValue& old = known(inst.operands[0]);
+        inst.known = {IrValue::Exists::Yes, old.type, false, ""};
+        if (old.exists == IrValue::Exists::Yes) {
+            if (old.type == "int") {
+                try {
+                    return setConstant(inst, "int", evalExpression(inst.text));
+                } catch (...) {
+                }
+            } else if (old.type == "bool") {
+                std::string v = trim(inst.text);
+                if (v == "true" || v == "1") return setConstant(inst, "bool", "true");
+                if (v == "false" || v == "0") return setConstant(inst, "bool", "false");
+            } else if (old.type == "str") {
+                return setConstant(inst, "str", unquote(inst.text));
+            }
+        }
+        fresh(inst);
+    }
+
+    // A phi sees the stores of its executable predecessors, a handler's
+    // opaque value any of its operands.
+    void merge(uint32_t b, IrInst& inst) {
+        std::vector<const IrValue*> values;
+        uint32_t vn = 0;
+        bool same = true;
+        for (size_t i = 0; i < inst.operands.size(); ++i) {
+            if (inst.op == IrOp::Phi && !edge(ir.blocks[b].preds[i], b)) continue;
+            const IrInst& op = ir.insts[inst.operands[i]];
+            values.push_back(&op.known);
+            same = same && (vn == 0 || vn == op.vn);
+            vn = op.vn;
+        }
+        inst.known = meet(values);
+        if (same && vn) inst.vn = vn;
+        else if (inst.known.constant) setConstant(inst, inst.known.type, inst.known.value);
+        else fresh(inst);
+    }
+
+    void compare(IrInst& inst) {
+        const IrValue& lhs = known(inst.operands[0]);
+        const IrValue& rhs = known(inst.operands[1]);
+        const std::string& lhsName = inst.name;
+        bool decided = lhs.exists == IrValue::Exists::No;
+        bool result = false;
+        if (lhs.exists == IrValue::Exists::Yes && lhs.constant &&
+            (rhs.exists == IrValue::Exists::No || (rhs.exists == IrValue::Exists::Yes && rhs.constant))) {
+            std::unordered_map<std::string, Variable> vars{{lhsName, {lhs.type, lhs.value}}};
+            if (rhs.exists == IrValue::Exists::Yes) vars[inst.text] = {rhs.type, rhs.value};
+            try {
+                result = evaluateCondition(vars, lhsName, inst.type, inst.text);
+                decided = true;
+            } catch (...) {
+            }
+        }
+        if (decided) return setConstant(inst, "cond", result ? "true" : "false");
+        std::string key = inst.type + '\0' + std::to_string(ir.insts[inst.operands[0]].vn) + '\0' +
+                          std::to_string(ir.insts[inst.operands[1]].vn) + '\0' + inst.text;
+        auto [it, added] = compares.try_emplace(key, nextVn);
+        if (added) ++nextVn;
+        inst.vn = it->second;
+    }
+
+    void branch(uint32_t b, IrInst& inst) {
+        const IrInst& cond = ir.insts[inst.operands[0]];
+        if (cond.known.constant) {
+            inst.taken = cond.known.value == "true" ? 0 : 1;
+            return;
+        }
+        for (const auto& [where, outcome] : facts[cond.vn]) {
+            if (dom.dominates(where, b)) {
+                inst.taken = outcome ? 0 : 1;
+                return;
+            }
+        }
+        const IrBlock& block = ir.blocks[b];
+        for (int i = 0; i < 2; ++i) {
+            uint32_t s = block.succs[i];
+            if (ir.blocks[s].preds.size() == 1) facts[cond.vn].emplace_back(s, i == 0);
+        }
+    }
+
+    // match- on a known subject; labels are valid, the compiler checked them.
+    void select(IrInst& inst) {
+        const IrValue& subject = known(inst.operands[0]);
+        if (subject.exists != IrValue::Exists::Yes || !subject.constant) return;
+        int miss = static_cast<int>(inst.args.size());
+        if (subject.type == "int") {
+            long long value;
+            try {
+                value = std::stoll(subject.value);
+            } catch (...) {
+                return; // raises at run time
+            }
+            inst.taken = miss;
+            for (int i = 0; i < miss && inst.taken == miss; ++i) {
+                const std::string& label = inst.args[i];
+                if (label.front() != '"' && std::stoll(label) == value) inst.taken = i;
+            }
+        } else {
+            inst.taken = miss;
+            for (int i = 0; i < miss && inst.taken == miss && subject.type == "str"; ++i) {
+                const std::string& label = inst.args[i];
+                if (label.front() == '"' && unquote(label) == subject.value) inst.taken = i;
+            }
+        }
+    }
+
+    void sweep() {
+        std::vector<char> live(ir.insts.size(), 0);
+        std::vector<uint32_t> work;
+        auto use = [&](uint32_t id) {
+            if (id && !live[id]) {
+                live[id] = 1;
+                work.push_back(id);
+            }
+        };
+        // elif- tests that lowerIr keeps behind an earlier undecided test
+        std::vector<char> guarded(ir.blocks.size(), 0);
+        for (uint32_t b = 0; b < ir.blocks.size(); ++b) {
+            const IrBlock& block = ir.blocks[b];
+            if (!block.reachable) continue;
+            for (uint32_t id : block.insts) {
+                const IrInst& inst = ir.insts[id];
+                switch (inst.op) {
+                    case IrOp::Loc:
+                    case IrOp::Assign:
+                        if (!removable(inst)) use(id);
+                        break;
+                    case IrOp::Input:
+                    case IrOp::Caught: use(id); break;
+                    case IrOp::Print:
+                        if (!printsLiteral(ir, inst)) use(inst.operands[0]);
+                        break;
+                    case IrOp::Call:
+                        for (uint32_t op : inst.operands) use(op);
+                        break;
+                    case IrOp::Switch:
+                        if (inst.taken < 0) use(inst.operands[0]);
+                        break;
+                    case IrOp::Branch: {
+                        bool kept = inst.taken < 0 || (inst.taken == 0 && guarded[b]);
+                        if (kept) use(inst.operands[0]);
+                        uint32_t next = block.succs[1];
+                        if ((inst.taken < 0 || guarded[b]) && ir.blocks[next].preds.size() == 1) guarded[next] = 1;
+                        break;
+                    }
+                    default: break;
+                }
+            }
+        }
+        while (!work.empty()) {
+            const IrInst& inst = ir.insts[work.back()];
+            work.pop_back();
+            if (inst.op == IrOp::Assign && foldedStore(inst)) continue; // written as a loc-
+            for (uint32_t op : inst.operands) use(op);
+        }
+        for (uint32_t id = 1; id < ir.insts.size(); ++id) {
+            IrInst& inst = ir.insts[id];
+            if (live[id] || !ir.blocks[inst.block].reachable) continue;
+            inst.dead = inst.op == IrOp::Phi || inst.op == IrOp::Opaque || removable(inst);
+        }
+    }
+
+    IrProgram& ir;
+    IrDominators dom;
+    uint32_t nextVn = absentVn + 1;
+    std::unordered_map<std::string, uint32_t> constants; // type, value -> number
+    std::unordered_map<std::string, uint32_t> compares;  // operator, operand numbers, rhs text -> number
+    std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, bool>>> facts; // condition number -> block, outcome
+};
+
+// Writes the optimized program back as source lines, each statement on
+// the line it came from, and compiles them again, so the result gets the
+// compiler's own block links and jump tables.
+class Lowerer {
+public:
+    Lowerer(const IrProgram& ir, const Code& code) : ir(ir), code(code) {
+        int last = 0;
+        for (Stmt st : code) last = std::max(last, st.line());
+        lines.resize(last);
+    }
+
+    bool run(std::vector<std::string>& out) {
+        range(0, code.size());
+        out = std::move(lines);
+        return ok;
+    }
+
+private:
+    const IrInst& inst(Stmt st) const { return ir.insts[ir.instOf[st.index()]]; }
+
+    void emit(Stmt st, std::string text) { lines[st.line() - 1] = std::move(text); }
+
+    static std::string literal(const IrValue& v) {
+        return v.type == "str" ? "\"" + v.value + "\"" : v.value;
+    }
+
+    void range(uint32_t begin, uint32_t end) {
+        for (uint32_t pc = begin; pc < end;) {
+            Stmt st = code[pc];
+            switch (st.kind()) {
+                case StmtKind::If: pc = chain(st); continue;
+                case StmtKind::Match: pc = match(st); continue;
+                case StmtKind::Try:
+                    emit(st, "try-");
+                    range(pc + 1, st.next());
+                    emit(code[st.next()], code[st.next()].argCount() ? "catch- " + code[st.next()].str(0) : "catch-");
+                    range(st.next() + 1, st.end());
+                    emit(code[st.end()], "end--");
+                    pc = st.end() + 1;
+                    continue;
+                default: statement(st); break;
+            }
+            ++pc;
+        }
+    }
+
+    void statement(Stmt st) {
+        switch (st.kind()) {
+            case StmtKind::Loc:
+            case StmtKind::Assign: {
+                const IrInst& store = inst(st);
+                if (store.dead) return;
+                if (foldedStore(store))
+                    emit(st, "loc " + st.str(0) + " = " + store.known.type + "(" + literal(store.known) + ")!");
+                else if (st.kind() == StmtKind::Loc)
+                    emit(st, "loc " + st.str(0) + " = " + st.str(1) + "(" + st.str(2) + ")!");
+                else
+                    emit(st, st.str(0) + " = " + st.str(1) + " !"); // the space keeps it from reading as input--
+                return;
+            }
+            case StmtKind::Input:
+                emit(st, st.str(0) + " = input-- " + st.str(1) + "- \"" + st.str(2) + "\"!");
+                return;
+            case StmtKind::PrintText: emit(st, "print-- \"" + st.str(0) + "\"!"); return;
+            case StmtKind::PrintVar: {
+                const IrInst& print = inst(st);
+                if (printsLiteral(ir, print)) emit(st, "print-- \"" + ir.insts[print.operands[0]].known.value + "\"!");
+                else emit(st, "print-- " + st.str(0) + "!");
+                return;
+            }
+            case StmtKind::PrintCall: {
+                std::string text = "print-- f-" + st.str(0) + "(";
+                for (size_t i = 1; i < st.argCount(); ++i) text += (i > 1 ? ", " : "") + st.str(i);
+                emit(st, text + ")!");
+                return;
+            }
+            case StmtKind::Import: emit(st, "import \"" + st.str(0) + "\"!"); return;
+            case StmtKind::UseNative: emit(st, "use native \"" + st.str(0) + "\"!"); return;
+            default:
+                ok = false; // const- left unevaluated, debugger traps: keep the code as compiled
+                return;
+        }
+    }
+
+    static std::string condition(Stmt st) { return st.str(0) + " " + st.str(1) + " " + st.str(2) + " the"; }
+
+    // Branches decided false go, a branch decided true ends the chain and
+    // runs without its test when no undecided test comes before it.
+    uint32_t chain(Stmt head) {
+        bool kept = false;
+        for (uint32_t b = head.index(); b < head.end(); b = code[b].next()) {
+            Stmt st = code[b];
+            int taken = inst(st).taken;
+            if (taken == 1) continue;
+            if (taken == 0 && !kept) {
+                range(b + 1, st.next());
+                break;
+            }
+            // tests raise with the line of the chain's head
+            emit(kept ? st : head, (kept ? "elif- " : "if- ") + condition(st));
+            kept = true;
+            range(b + 1, st.next());
+            if (taken == 0) break;
+        }
+        if (kept) emit(code[head.end()], "end--");
+        return head.end() + 1;
+    }
+
+    uint32_t match(Stmt head) {
+        int taken = inst(head).taken;
+        int i = 0;
+        if (taken < 0) emit(head, "match- " + head.str(0) + " the");
+        for (uint32_t c = head.next(); c < head.end(); c = code[c].next(), ++i) {
+            if (taken >= 0 && taken != i) continue;
+            if (taken < 0) emit(code[c], "case- " + code[c].str(0));
+            range(c + 1, code[c].next());
+        }
+        if (taken < 0) emit(code[head.end()], "end--");
+        return head.end() + 1;
+    }
+
+    const IrProgram& ir;
+    const Code& code;
+    std::vector<std::string> lines;
+    bool ok = true;
+};
+
+}
+
+void optimizeIr(IrProgram& ir) {
+    Optimizer(ir).run();
+}
+
+bool lowerIr(const IrProgram& ir, Module& mod) {
+    std::vector<std::string> lines;
+    if (!Lowerer(ir, mod.code).run(lines)) return false;
+    Module lowered;
+    lowered.path = mod.path;
+    compileModule(lowered, lines, true, nullptr);
+    if (!lowered.diagnostics.empty() || !lowered.functions.empty()) return false;
+    mod.code = std::move(lowered.code);
+    return true;
+}
@@ -0,0 +1,276 @@
+#include "h/json.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const Json nullJson;
+
+class Parser {
+public:
+    explicit Parser(const std::string& text) : text(text) {}
+
+    bool parseDocument(Json& out) {
+        if (!parseValue(out)) return false;
+        skipSpace();
+        return pos == text.size();
+    }
+
+private:
+    void skipSpace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+            ++pos;
+    }
+
+    bool consume(const char* word) {
+        size_t len = std::char_traits<char>::length(word);
+        if (text.compare(pos, len, word) != 0) return false;
+        pos += len;
+        return true;
+    }
+
+    bool parseValue(Json& out) {
+        skipSpace();
+        if (pos >= text.size()) return false;
+        char c = text[pos];
+        if (c == '{') return parseObject(out);
+        if (c == '[') return parseArray(out);
+        if (c == '"') {
+            std::string s;
+            if (!parseString(s)) return false;
+            out = Json(std::move(s));
+            return true;
+        }
+        if (consume("true")) { out = Json(true); return true; }
+        if (consume("false")) { out = Json(false); return true; }
+        if (consume("null")) { out = Json(); return true; }
+        return parseNumber(out);
+    }
+
+    bool parseNumber(Json& out) {
+        const char* start = text.c_str() + pos;
+        char* end = nullptr;
+        double value = std::strtod(start, &end);
+        if (end == start) return false;
+        pos += static_cast<size_t>(end - start);
+        out = Json(value);
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, unsigned cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool parseHex4(unsigned& cp) {
+        if (pos + 4 > text.size()) return false;
+        cp = static_cast<unsigned>(std::strtoul(text.substr(pos, 4).c_str(), nullptr, 16));
+        pos += 4;
+        return true;
+    }
+
+    bool parseString(std::string& out) {
+        ++pos; // opening quote
+        while (pos < text.size()) {
+            char c = text[pos++];
+            if (c == '"') return true;
+            if (c != '\\') { out += c; continue; }
+            if (pos >= text.size()) return false;
+            char e = text[pos++];
+            switch (e) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned cp;
+                    if (!parseHex4(cp)) return false;
+                    if (cp >= 0xD800 && cp < 0xDC00 && consume("\\u")) {
+                        unsigned low;
+                        if (!parseHex4(low)) return false;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, cp);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        return false;
+    }
+
+    bool parseArray(Json& out) {
+        ++pos;
+        out = Json::array();
+        skipSpace();
+        if (pos < text.size() && text[pos] == ']') { ++pos; return true; }
+        for (;;) {
+            Json item;
+            if (!parseValue(item)) return false;
+            out.push(std::move(item));
+            skipSpace();
+            if (pos >= text.size()) return false;
+            if (text[pos] == ',') { ++pos; continue; }
+            if (text[pos] == ']') { ++pos; return true; }
+            return false;
+        }
+    }
+
+    bool parseObject(Json& out) {
+        ++pos;
+        out = Json::object();
+        skipSpace();
+        if (pos < text.size() && text[pos] == '}') { ++pos; return true; }
+        for (;;) {
+            skipSpace();
+            if (pos >= text.size() || text[pos] != '"') return false;
+            std::string key;
+            if (!parseString(key)) return false;
+            skipSpace();
+            if (pos >= text.size() || text[pos] != ':') return false;
+            ++pos;
+            Json value;
+            if (!parseValue(value)) return false;
+            out[key] = std::move(value);
+            skipSpace();
+            if (pos >= text.size()) return false;
+            if (text[pos] == ',') { ++pos; continue; }
+            if (text[pos] == '}') { ++pos; return true; }
+            return false;
+        }
+    }
+
+    const std::string& text;
+    size_t pos = 0;
+};
+
+}
+
+void dumpJsonString(std::string_view s, std::string& out) {
+    out += '"';
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof buf, "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+Json Json::array() {
+    Json j;
+    j.t = Type::Array;
+    return j;
+}
+
+Json Json::object() {
+    Json j;
+    j.t = Type::Object;
+    return j;
+}
+
+bool Json::parse(const std::string& text, Json& out) {
+    return Parser(text).parseDocument(out);
+}
+
+bool Json::has(const std::string& key) const {
+    if (t != Type::Object) return false;
+    for (const auto& k : keys) {
+        if (k == key) return true;
+    }
+    return false;
+}
+
+const Json& Json::operator[](const std::string& key) const {
+    if (t != Type::Object) return nullJson;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (keys[i] == key) return items[i];
+    }
+    return nullJson;
+}
+
+Json& Json::operator[](const std::string& key) {
+    if (t != Type::Object) *this = object();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (keys[i] == key) return items[i];
+    }
+    keys.push_back(key);
+    items.emplace_back();
+    return items.back();
+}
+
+void Json::push(Json value) {
+    if (t != Type::Array) *this = array();
+    items.push_back(std::move(value));
+}
+
+std::string Json::dump() const {
+    std::string out;
+    dumpTo(out);
+    return out;
+}
+
+void Json::dumpTo(std::string& out) const {
+    switch (t) {
+        case Type::Null: out += "null"; break;
+        case Type::Bool: out += b ? "true" : "false"; break;
+        case Type::Number: {
+            if (std::floor(n) == n && std::fabs(n) < 1e15) {
+                out += std::to_string(static_cast<long long>(n));
+            } else {
+                char buf[32];
+                std::snprintf(buf, sizeof buf, "%.17g", n);
+                out += buf;
+            }
+            break;
+        }
+        case Type::String: dumpJsonString(s, out); break;
+        case Type::Array:
+            out += '[';
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (i) out += ',';
+                items[i].dumpTo(out);
+            }
+            out += ']';
+            break;
+        case Type::Object:
+            out += '{';
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (i) out += ',';
+                dumpJsonString(keys[i], out);
+                out += ':';
+                items[i].dumpTo(out);
+            }
+            out += '}';
+            break;
+    }
+}
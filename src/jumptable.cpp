@@ -0,0 +1,181 @@
+#include "h/jumptable.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t fingerprint(const std::string& s, uint64_t seed) {
+    uint64_t h = 14695981039346656037ULL ^ mix(seed);
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// xor with a fixed value keeps distinct ints distinct
+uint64_t intKey(long long value, uint64_t seed) {
+    return static_cast<uint64_t>(value) ^ mix(seed);
+}
+
+// int values within this many slots per case get a dense table
+const unsigned long long denseSlack = 4;
+
+}
+
+bool PerfectHash::build(const std::vector<uint64_t>& keys) {
+    size_t n = keys.size();
+    slots = 2 * n + 1;
+    for (int attempt = 0; attempt < 8; ++attempt, slots += slots / 2 + 1) {
+        size_t buckets = n / 2 + 1;
+        std::vector<std::vector<uint64_t>> byBucket(buckets);
+        for (uint64_t key : keys) byBucket[mix(key) % buckets].push_back(key);
+        std::vector<size_t> order(buckets);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&byBucket](size_t a, size_t b) { return byBucket[a].size() > byBucket[b].size(); });
+
+        displacement.assign(buckets, 0);
+        std::vector<bool> taken(slots, false);
+        bool placedAll = true;
+        for (size_t b : order) {
+            const auto& members = byBucket[b];
+            if (members.empty()) break;
+            bool placed = false;
+            std::vector<size_t> chosen;
+            for (uint32_t d = 0; d < (1u << 16) && !placed; ++d) {
+                displacement[b] = d;
+                chosen.clear();
+                placed = true;
+                for (uint64_t key : members) {
+                    size_t s = slot(key);
+                    if (taken[s] || std::find(chosen.begin(), chosen.end(), s) != chosen.end()) {
+                        placed = false;
+                        break;
+                    }
+                    chosen.push_back(s);
+                }
+            }
+            if (!placed) {
+                placedAll = false;
+                break;
+            }
+            for (size_t s : chosen) taken[s] = true;
+        }
+        if (placedAll) return true;
+    }
+    return false;
+}
+
+size_t PerfectHash::slot(uint64_t key) const {
+    uint32_t d = displacement[mix(key) % displacement.size()];
+    return mix(key ^ (static_cast<uint64_t>(d) + 1) * 0xD6E8FEB86659FD93ULL) % slots;
+}
+
+void JumpTable::addInt(long long value, size_t target) {
+    if (!intSeen.insert(value).second) return;
+    intKeys.push_back(value);
+    intTargets.push_back(target);
+}
+
+void JumpTable::addString(const std::string& value, size_t target) {
+    if (!stringSeen.insert(value).second) return;
+    stringKeys.push_back(value);
+    stringTargets.push_back(target);
+}
+
+void JumpTable::build() {
+    intSeen.clear();
+    stringSeen.clear();
+    if (!intKeys.empty()) {
+        auto [lo, hi] = std::minmax_element(intKeys.begin(), intKeys.end());
+        unsigned long long span = static_cast<unsigned long long>(*hi) - static_cast<unsigned long long>(*lo);
+        if (span < denseSlack * intKeys.size() + 16) {
+            denseBase = *lo;
+            dense.assign(span + 1, none);
+            for (size_t i = 0; i < intKeys.size(); ++i) dense[intKeys[i] - denseBase] = intTargets[i];
+        } else {
+            // a seed the hash cannot place every key with is swapped for the next
+            for (;; ++intSeed) {
+                std::vector<uint64_t> keys;
+                for (long long v : intKeys) keys.push_back(intKey(v, intSeed));
+                if (!intHash.build(keys)) continue;
+                intSlots.assign(intHash.size(), none);
+                for (size_t i = 0; i < keys.size(); ++i) intSlots[intHash.slot(keys[i])] = i;
+                break;
+            }
+        }
+    }
+    if (!stringKeys.empty()) {
+        // distinct strings can share a fingerprint; pick a seed where they do not
+        for (;; ++stringSeed) {
+            std::vector<uint64_t> keys;
+            for (const auto& s : stringKeys) keys.push_back(fingerprint(s, stringSeed));
+            std::vector<uint64_t> sorted = keys;
+            std::sort(sorted.begin(), sorted.end());
+            if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) continue;
+            if (!stringHash.build(keys)) continue;
+            stringSlots.assign(stringHash.size(), none);
+            for (size_t i = 0; i < keys.size(); ++i) stringSlots[stringHash.slot(keys[i])] = i;
+            break;
+        }
+    }
+}
+
+size_t JumpTable::findInt(long long value) const {
+    if (!dense.empty()) {
+        unsigned long long offset = static_cast<unsigned long long>(value) - static_cast<unsigned long long>(denseBase);
+        return offset < dense.size() ? dense[offset] : none;
+    }
+    if (intKeys.empty()) return none;
+    size_t i = intSlots[intHash.slot(intKey(value, intSeed))];
+    return i != none && intKeys[i] == value ? intTargets[i] : none;
+}
+
+size_t JumpTable::findString(const std::string& value) const {
+    if (stringKeys.empty()) return none;
+    size_t i = stringSlots[stringHash.slot(fingerprint(value, stringSeed))];
+    return i != none && stringKeys[i] == value ? stringTargets[i] : none;
+}
+
+bool JumpTable::shadowed(const std::unordered_map<std::string, Variable>& vars) const {
+    if (vars.size() != checkedVars) {
+        namesShadowed = std::any_of(names.begin(), names.end(), [&vars](const std::string& n) { return vars.count(n); });
+        checkedVars = vars.size();
+    }
+    return namesShadowed;
+}
+
+bool JumpTable::select(const std::unordered_map<std::string, Variable>& vars, const std::string& name,
+                       uint32_t& target) const {
+    if (intKeys.empty() && stringKeys.empty()) return false;
+    auto it = vars.find(name);
+    if (it == vars.end()) {
+        target = static_cast<uint32_t>(miss);
+        return true;
+    }
+    if (!names.empty() && shadowed(vars)) return false;
+    const Variable& var = it->second;
+    size_t found = none;
+    if (var.type == "int") {
+        if (!intsExact) return false;
+        long long value;
+        try {
+            value = std::stoll(var.value);
+        } catch (...) {
+            return false; // let the comparison report it
+        }
+        found = findInt(value);
+    } else if (var.type == "str") {
+        found = findString(var.value);
+    }
+    target = static_cast<uint32_t>(found == none ? miss : found);
+    return true;
+}
@@ -0,0 +1,718 @@
+#include "h/lsp.h"
+#include "h/checker.h"
+#include "h/compiler.h"
+#include "h/json.h"
+#include "h/module.h"
+#include "h/utils.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// A top-level unit of a document (statement, if-/try- block or funS),
+// compiled as if it started at line 1.
+struct CompiledBlock {
+    Module mod;
+    std::vector<Diagnostic> local; // compile errors and function-body findings
+    std::string interface;         // what other units can see: declarations, funS arities, imports
+    std::vector<std::string> uses; // names whose declarations the checker looks up
+};
+
+struct Block {
+    int first; // 0-based document line
+    int count;
+    double key; // document order; unlike `first` it survives edits above
+    std::shared_ptr<const CompiledBlock> compiled;
+    std::vector<Diagnostic> scoped; // findings that depend on the rest of the document
+};
+
+struct Declaration {
+    double key; // block
+    int line;   // within the block
+    std::string type;
+};
+
+struct FunctionEntry {
+    const FunctionDef* def;
+    double key;
+};
+
+struct Document {
+    std::string uri;
+    std::string path;
+    std::vector<std::string> lines;
+    std::vector<Block> blocks;
+    std::unordered_map<std::string, std::shared_ptr<const CompiledBlock>> cache; // block text -> compiled
+
+    // document-wide index, kept up to date with the blocks
+    std::unordered_map<std::string, std::vector<Declaration>> variables; // sorted by key
+    std::unordered_map<std::string, std::vector<FunctionEntry>> functions;  // sorted by key
+    std::unordered_map<std::string, std::vector<double>> references;        // name -> keys of blocks using it
+    std::vector<double> natives; // keys of use-- statements
+    std::vector<const Module*> imports;
+};
+
+// Blocks that replaced [lo, lo + removed.size()) in the last resplit.
+struct BlockEdit {
+    size_t lo = 0;
+    size_t count = 0;
+    std::vector<Block> removed;
+    bool renumbered = false;
+};
+
+std::string uriToPath(const std::string& uri) {
+    if (startsWith(uri, "file://")) return uri.substr(7);
+    return uri;
+}
+
+// LSP columns count UTF-16 code units; lines are stored as UTF-8.
+size_t byteOffset(const std::string& line, int utf16Col) {
+    size_t i = 0;
+    int col = 0;
+    while (i < line.size() && col < utf16Col) {
+        unsigned char c = line[i];
+        size_t len = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        col += len == 4 ? 2 : 1;
+        i += len;
+    }
+    return std::min(i, line.size());
+}
+
+int utf16Length(const std::string& line) {
+    int col = 0;
+    for (size_t i = 0; i < line.size();) {
+        unsigned char c = line[i];
+        size_t len = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        col += len == 4 ? 2 : 1;
+        i += len;
+    }
+    return col;
+}
+
+std::vector<std::string> splitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    for (;;) {
+        size_t nl = text.find('\n', start);
+        std::string line = text.substr(start, nl == std::string::npos ? std::string::npos : nl - start);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        lines.push_back(std::move(line));
+        if (nl == std::string::npos) break;
+        start = nl + 1;
+    }
+    return lines;
+}
+
+Json position(int line, int character) {
+    Json p = Json::object();
+    p["line"] = line;
+    p["character"] = character;
+    return p;
+}
+
+Json range(int line, int from, int to) {
+    Json r = Json::object();
+    r["start"] = position(line, from);
+    r["end"] = position(line, to);
+    return r;
+}
+
+Json location(const std::string& uri, int line) {
+    Json loc = Json::object();
+    loc["uri"] = uri;
+    loc["range"] = range(line, 0, 0);
+    return loc;
+}
+
+const FunctionDef* findInModules(const std::vector<const Module*>& mods, const std::string& name,
+                                 std::set<const Module*>& seen, const Module** owner) {
+    for (const Module* mod : mods) {
+        if (!mod || !seen.insert(mod).second) continue;
+        auto it = mod->functions.find(name);
+        if (it != mod->functions.end()) {
+            *owner = mod;
+            return &it->second;
+        }
+        if (const FunctionDef* def = findInModules(mod->imports, name, seen, owner)) return def;
+    }
+    return nullptr;
+}
+
+std::string signature(const std::string& name, const FunctionDef& func) {
+    std::string sig = "funS " + func.returnType + " " + name;
+    for (size_t i = 0; i < func.typeParams.size(); ++i) sig += (i ? ", " : "<") + func.typeParams[i];
+    if (!func.typeParams.empty()) sig += ">";
+    sig += "(";
+    for (size_t i = 0; i < func.params.size(); ++i) {
+        if (i) sig += ", ";
+        sig += func.params[i].first + ": " + func.params[i].second;
+    }
+    return sig + ")";
+}
+
+class LanguageServer {
+public:
+    int run() {
+        std::string body;
+        while (readMessage(body)) {
+            Json msg;
+            if (!Json::parse(body, msg)) continue;
+            handle(msg);
+            if (exitRequested) break;
+        }
+        return shutdownRequested ? 0 : 1;
+    }
+
+private:
+    bool readMessage(std::string& body) {
+        std::string line;
+        size_t length = 0;
+        bool any = false, valid = true;
+        while (std::getline(std::cin, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) {
+                if (any) break;
+                continue;
+            }
+            any = true;
+            if (startsWith(line, "Content-Length:")) {
+                std::string value = trim(line.substr(15));
+                auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), length);
+                valid = error == std::errc() && end == value.data() + value.size();
+            }
+        }
+        // without the length the body cannot be told from the next header
+        if (!any || !valid || !std::cin) return false;
+        body.assign(length, '\0');
+        std::cin.read(&body[0], static_cast<std::streamsize>(length));
+        return static_cast<size_t>(std::cin.gcount()) == length;
+    }
+
+    void send(const Json& msg) {
+        std::string body = msg.dump();
+        std::cout << "Content-Length: " << body.size() << "\r\n\r\n" << body << std::flush;
+    }
+
+    void reply(const Json& id, Json result) {
+        Json msg = Json::object();
+        msg["jsonrpc"] = "2.0";
+        msg["id"] = id;
+        msg["result"] = std::move(result);
+        send(msg);
+    }
+
+    void replyError(const Json& id, int code, const std::string& message) {
+        Json err = Json::object();
+        err["code"] = code;
+        err["message"] = message;
+        Json msg = Json::object();
+        msg["jsonrpc"] = "2.0";
+        msg["id"] = id;
+        msg["error"] = std::move(err);
+        send(msg);
+    }
+
+    void notify(const std::string& method, Json params) {
+        Json msg = Json::object();
+        msg["jsonrpc"] = "2.0";
+        msg["method"] = method;
+        msg["params"] = std::move(params);
+        send(msg);
+    }
+
+    void handle(const Json& msg) {
+        const std::string& method = msg["method"].str();
+        const Json& params = msg["params"];
+        bool isRequest = msg.has("id");
+
+        if (method == "initialize") {
+            Json caps = Json::object();
+            caps["textDocumentSync"] = 2; // incremental
+            caps["definitionProvider"] = true;
+            caps["hoverProvider"] = true;
+            Json result = Json::object();
+            result["capabilities"] = std::move(caps);
+            Json info = Json::object();
+            info["name"] = "lomake";
+            result["serverInfo"] = std::move(info);
+            reply(msg["id"], std::move(result));
+        } else if (method == "shutdown") {
+            shutdownRequested = true;
+            reply(msg["id"], Json());
+        } else if (method == "exit") {
+            exitRequested = true;
+        } else if (method == "textDocument/didOpen") {
+            const Json& td = params["textDocument"];
+            Document& doc = documents[td["uri"].str()] = Document();
+            doc.uri = td["uri"].str();
+            doc.path = canonicalPath(uriToPath(doc.uri));
+            doc.lines = splitLines(td["text"].str());
+            resplit(doc, 0, -1, static_cast<int>(doc.lines.size()) - 1);
+            reindex(doc);
+            for (size_t i = 0; i < doc.blocks.size(); ++i) recheck(doc, i);
+            publish(doc);
+        } else if (method == "textDocument/didChange") {
+            auto it = documents.find(params["textDocument"]["uri"].str());
+            if (it == documents.end()) return;
+            const Json& changes = params["contentChanges"];
+            for (size_t i = 0; i < changes.size(); ++i) applyChange(it->second, changes[i]);
+            publish(it->second);
+        } else if (method == "textDocument/didClose") {
+            std::string uri = params["textDocument"]["uri"].str();
+            documents.erase(uri);
+            Json p = Json::object();
+            p["uri"] = uri;
+            p["diagnostics"] = Json::array();
+            notify("textDocument/publishDiagnostics", std::move(p));
+        } else if (method == "textDocument/definition") {
+            reply(msg["id"], definition(params));
+        } else if (method == "textDocument/hover") {
+            reply(msg["id"], hover(params));
+        } else if (isRequest) {
+            replyError(msg["id"], -32601, "Method not found: " + method);
+        }
+    }
+
+    void applyChange(Document& doc, const Json& change) {
+        if (!change.has("range")) {
+            int oldLast = static_cast<int>(doc.lines.size()) - 1;
+            doc.lines = splitLines(change["text"].str());
+            update(doc, resplit(doc, 0, oldLast, static_cast<int>(doc.lines.size()) - 1));
+            return;
+        }
+        const Json& r = change["range"];
+        int startLine = r["start"]["line"].integer();
+        int endLine = r["end"]["line"].integer();
+        if (doc.lines.empty()) doc.lines.emplace_back();
+        startLine = std::min(startLine, static_cast<int>(doc.lines.size()) - 1);
+        endLine = std::min(std::max(endLine, startLine), static_cast<int>(doc.lines.size()) - 1);
+        const std::string& first = doc.lines[startLine];
+        const std::string& last = doc.lines[endLine];
+        std::string prefix = first.substr(0, byteOffset(first, r["start"]["character"].integer()));
+        std::string suffix = last.substr(byteOffset(last, r["end"]["character"].integer()));
+        std::vector<std::string> inserted = splitLines(prefix + change["text"].str() + suffix);
+        doc.lines.erase(doc.lines.begin() + startLine, doc.lines.begin() + endLine + 1);
+        doc.lines.insert(doc.lines.begin() + startLine, inserted.begin(), inserted.end());
+        update(doc, resplit(doc, startLine, endLine, startLine + static_cast<int>(inserted.size()) - 1));
+    }
+
+    // Lines [from, oldLast] were replaced by [from, newLast]. Only the blocks
+    // touching the edit are rescanned; scanning stops as soon as a block
+    // boundary lines up with an old one again, and the untouched tail is
+    // reused with shifted line numbers.
+    BlockEdit resplit(Document& doc, int from, int oldLast, int newLast) {
+        int delta = newLast - oldLast;
+        auto& blocks = doc.blocks;
+        auto firstAfter = [&blocks](size_t begin, int line) {
+            return static_cast<size_t>(std::lower_bound(blocks.begin() + begin, blocks.end(), line,
+                                       [](const Block& b, int l) { return b.first < l; }) - blocks.begin());
+        };
+        BlockEdit edit;
+        edit.lo = firstAfter(0, from + 1);
+        if (edit.lo > 0 && blocks[edit.lo - 1].first + blocks[edit.lo - 1].count > from) --edit.lo;
+        int pos = edit.lo < blocks.size() ? std::min(blocks[edit.lo].first, from) : from;
+
+        std::vector<Block> fresh;
+        int total = static_cast<int>(doc.lines.size());
+        size_t resume = blocks.size();
+        while (pos < total) {
+            while (pos < total && trim(doc.lines[pos]).empty()) ++pos;
+            if (pos >= total) break;
+            if (pos > newLast) {
+                size_t at = firstAfter(edit.lo, pos - delta);
+                if (at < blocks.size() && blocks[at].first == pos - delta) {
+                    resume = at;
+                    break;
+                }
+            }
+            BlockTracker tracker;
+            int start = pos;
+            do {
+                tracker.feed(trim(doc.lines[pos]));
+                ++pos;
+            } while (pos < total && !tracker.complete());
+            fresh.push_back({start, pos - start, 0, compileBlock(doc, start, pos - start), {}});
+        }
+
+        double below = edit.lo > 0 ? blocks[edit.lo - 1].key : 0;
+        double above = resume < blocks.size() ? blocks[resume].key : below + 1024.0 * (fresh.size() + 1);
+        double step = (above - below) / static_cast<double>(fresh.size() + 1);
+        for (size_t i = 0; i < fresh.size(); ++i) fresh[i].key = below + step * static_cast<double>(i + 1);
+
+        edit.removed.assign(std::make_move_iterator(blocks.begin() + edit.lo),
+                            std::make_move_iterator(blocks.begin() + resume));
+        blocks.erase(blocks.begin() + edit.lo, blocks.begin() + resume);
+        edit.count = fresh.size();
+        blocks.insert(blocks.begin() + edit.lo, std::make_move_iterator(fresh.begin()),
+                      std::make_move_iterator(fresh.end()));
+        for (size_t i = edit.lo + edit.count; i < blocks.size(); ++i) blocks[i].first += delta;
+
+        // keys ran out of room between two neighbours: start over
+        if (!fresh.empty() && !(step > 1e-6)) {
+            for (size_t i = 0; i < blocks.size(); ++i) blocks[i].key = 1024.0 * static_cast<double>(i + 1);
+            edit.renumbered = true;
+        }
+        return edit;
+    }
+
+    std::shared_ptr<const CompiledBlock> compileBlock(Document& doc, int first, int count) {
+        std::vector<std::string> lines(doc.lines.begin() + first, doc.lines.begin() + first + count);
+        std::string key;
+        for (const auto& l : lines) key += l + '\n';
+        auto cached = doc.cache.find(key);
+        if (cached != doc.cache.end()) return cached->second;
+
+        auto block = std::make_shared<CompiledBlock>();
+        block->mod.path = doc.path;
+        compileModule(block->mod, lines, true, nullptr);
+        block->local = block->mod.diagnostics;
+        for (const auto& [name, func] : block->mod.functions) {
+            checkFunction(doc.path, func, block->local);
+            block->interface += "F " + name + " " + std::to_string(func.params.size()) + "\n";
+        }
+        for (const Stmt& st : block->mod.code) {
+            std::string type = declaredType(st);
+            if (!type.empty()) block->interface += "V " + st.str(0) + " " + type + "\n";
+            else if (st.kind() == StmtKind::Import) block->interface += "I " + st.str(0) + "\n";
+            else if (st.kind() == StmtKind::UseNative) block->interface += "N\n";
+            switch (st.kind()) {
+                case StmtKind::Const:
+                    block->uses.push_back(st.str(0));
+                    if (startsWith(st.str(2), "f-"))
+                        block->uses.push_back(st.str(2).substr(2, st.str(2).find('(') - 2));
+                    break;
+                case StmtKind::Loc:
+                case StmtKind::Assign:
+                case StmtKind::PrintVar:
+                case StmtKind::Match:
+                    block->uses.push_back(st.str(0));
+                    break;
+                case StmtKind::If:
+                case StmtKind::Elif:
+                    block->uses.push_back(st.str(0));
+                    block->uses.push_back(st.str(2));
+                    break;
+                case StmtKind::PrintCall:
+                    for (size_t i = 0; i < st.argCount(); ++i) block->uses.push_back(st.str(i));
+                    break;
+                default:
+                    break;
+            }
+        }
+        std::sort(block->uses.begin(), block->uses.end());
+        block->uses.erase(std::unique(block->uses.begin(), block->uses.end()), block->uses.end());
+        std::stable_sort(block->local.begin(), block->local.end(),
+                         [](const Diagnostic& a, const Diagnostic& b) { return a.line < b.line; });
+
+        if (doc.cache.size() > 2 * doc.blocks.size() + 1024) doc.cache.clear();
+        doc.cache.emplace(std::move(key), block);
+        return block;
+    }
+
+    static std::string declaredType(const Stmt& st) {
+        if (st.kind() == StmtKind::Loc || st.kind() == StmtKind::Const) return st.str(1);
+        if (st.kind() == StmtKind::Input) return st.str(1) == "i" ? "int" : "str";
+        if (st.kind() == StmtKind::Catch && st.argCount()) return "str";
+        return "";
+    }
+
+    // Names whose declarations differ between two interfaces; false when
+    // imports or use-- changed, which can affect any block.
+    static bool changedNames(const std::string& before, const std::string& after, std::set<std::string>& names) {
+        std::multiset<std::string> removed, added;
+        std::istringstream in(before), out(after);
+        for (std::string line; std::getline(in, line);) removed.insert(line);
+        for (std::string line; std::getline(out, line);) {
+            auto it = removed.find(line);
+            if (it != removed.end()) removed.erase(it);
+            else added.insert(line);
+        }
+        for (const auto* side : {&removed, &added}) {
+            for (const std::string& entry : *side) {
+                if (entry[0] != 'V' && entry[0] != 'F') return false;
+                names.insert(entry.substr(2, entry.find(' ', 2) - 2));
+            }
+        }
+        return true;
+    }
+
+    // Only the new blocks and the blocks that mention a name whose
+    // declaration changed are checked again; everything else keeps its
+    // findings. Blocks are checked one by one against the index, so the
+    // result is the same as for a full pass.
+    void update(Document& doc, const BlockEdit& edit) {
+        std::string before, after;
+        for (const Block& b : edit.removed) before += b.compiled->interface;
+        for (size_t i = edit.lo; i < edit.lo + edit.count; ++i) after += doc.blocks[i].compiled->interface;
+        std::set<std::string> names;
+        if (edit.renumbered || !changedNames(before, after, names)) {
+            reindex(doc);
+            for (size_t i = 0; i < doc.blocks.size(); ++i) recheck(doc, i);
+            return;
+        }
+        for (const Block& b : edit.removed) unindex(doc, b);
+        for (size_t i = edit.lo; i < edit.lo + edit.count; ++i) index(doc, doc.blocks[i]);
+        for (size_t i = edit.lo; i < edit.lo + edit.count; ++i) recheck(doc, i);
+
+        std::set<size_t> dependents;
+        for (const std::string& name : names) {
+            auto refs = doc.references.find(name);
+            if (refs == doc.references.end()) continue;
+            for (double key : refs->second) {
+                size_t i = blockAt(doc, key);
+                if (i < edit.lo || i >= edit.lo + edit.count) dependents.insert(i);
+            }
+        }
+        for (size_t i : dependents) recheck(doc, i);
+    }
+
+    template <typename T, typename Key>
+    static void insertSorted(std::vector<T>& sites, T site, Key key) {
+        sites.insert(std::upper_bound(sites.begin(), sites.end(), site,
+                                      [&key](const T& a, const T& b) { return key(a) < key(b); }), std::move(site));
+    }
+
+    template <typename Map, typename Pred>
+    static void eraseFrom(Map& map, const std::string& name, Pred pred) {
+        auto it = map.find(name);
+        if (it == map.end()) return;
+        auto& sites = it->second;
+        sites.erase(std::remove_if(sites.begin(), sites.end(), pred), sites.end());
+        if (sites.empty()) map.erase(it);
+    }
+
+    void index(Document& doc, const Block& b) {
+        for (const auto& [name, func] : b.compiled->mod.functions)
+            insertSorted(doc.functions[name], FunctionEntry{&func, b.key}, [](const FunctionEntry& e) { return e.key; });
+        for (const Stmt& st : b.compiled->mod.code) {
+            std::string type = declaredType(st);
+            if (!type.empty())
+                insertSorted(doc.variables[st.str(0)], Declaration{b.key, st.line(), type},
+                             [](const Declaration& d) { return d.key; });
+            else if (st.kind() == StmtKind::UseNative)
+                insertSorted(doc.natives, b.key, [](double k) { return k; });
+        }
+        for (const std::string& name : b.compiled->uses)
+            insertSorted(doc.references[name], b.key, [](double k) { return k; });
+    }
+
+    void unindex(Document& doc, const Block& b) {
+        double key = b.key;
+        for (const auto& [name, func] : b.compiled->mod.functions)
+            eraseFrom(doc.functions, name, [key](const FunctionEntry& e) { return e.key == key; });
+        for (const Stmt& st : b.compiled->mod.code) {
+            if (!declaredType(st).empty())
+                eraseFrom(doc.variables, st.str(0), [key](const Declaration& d) { return d.key == key; });
+            else if (st.kind() == StmtKind::UseNative)
+                doc.natives.erase(std::remove(doc.natives.begin(), doc.natives.end(), key), doc.natives.end());
+        }
+        for (const std::string& name : b.compiled->uses)
+            eraseFrom(doc.references, name, [key](double k) { return k == key; });
+    }
+
+    void reindex(Document& doc) {
+        doc.functions.clear();
+        doc.variables.clear();
+        doc.references.clear();
+        doc.natives.clear();
+        doc.imports.clear();
+        for (const Block& b : doc.blocks) {
+            index(doc, b);
+            for (const Stmt& st : b.compiled->mod.code) {
+                if (st.kind() != StmtKind::Import) continue;
+                std::string error;
+                if (const Module* mod = importModule(st.str(0), error)) doc.imports.push_back(mod);
+            }
+        }
+    }
+
+    static size_t blockAt(const Document& doc, double key) {
+        return static_cast<size_t>(std::lower_bound(doc.blocks.begin(), doc.blocks.end(), key,
+                                   [](const Block& b, double k) { return b.key < k; }) - doc.blocks.begin());
+    }
+
+    const FunctionDef* lookupFunction(const Document& doc, const std::string& name, const Module** owner) const {
+        auto it = doc.functions.find(name);
+        if (it != doc.functions.end()) return it->second.back().def; // a later definition wins
+        std::set<const Module*> seen;
+        return findInModules(doc.imports, name, seen, owner);
+    }
+
+    // Checks one block against what the blocks before it declared.
+    void recheck(Document& doc, size_t i) {
+        Block& b = doc.blocks[i];
+        double from = b.key;
+        b.scoped.clear();
+        for (const Stmt& st : b.compiled->mod.code) {
+            if (st.kind() != StmtKind::Import) continue;
+            std::string error;
+            if (!importModule(st.str(0), error)) b.scoped.push_back({doc.path, st.line(), error});
+        }
+        CodeChecker checker(doc.path, [this, &doc](const std::string& name) {
+            const Module* owner = nullptr;
+            return lookupFunction(doc, name, &owner);
+        }, b.scoped);
+        checker.setOuterScope([&doc, from](const std::string& name) -> const std::string* {
+            auto it = doc.variables.find(name);
+            if (it == doc.variables.end()) return nullptr;
+            const std::string* type = nullptr;
+            for (const Declaration& d : it->second) {
+                if (d.key >= from) break;
+                type = &d.type;
+            }
+            return type;
+        }, !doc.natives.empty() && doc.natives.front() < from);
+        checker.checkCode(b.compiled->mod.code);
+    }
+
+    void publish(const Document& doc) {
+        Json list = Json::array();
+        auto add = [&](const Block& b, const Diagnostic& d) {
+            int line = b.first + std::max(0, d.line - 1);
+            int width = line < static_cast<int>(doc.lines.size()) ? utf16Length(doc.lines[line]) : 0;
+            Json diag = Json::object();
+            diag["range"] = range(line, 0, width);
+            diag["severity"] = 1;
+            diag["source"] = "lomake";
+            diag["message"] = d.message;
+            list.push(std::move(diag));
+        };
+        for (const Block& b : doc.blocks) {
+            // both lists are in line order; merge them
+            size_t i = 0, j = 0;
+            const auto& local = b.compiled->local;
+            while (i < local.size() || j < b.scoped.size()) {
+                if (j == b.scoped.size() || (i < local.size() && local[i].line <= b.scoped[j].line)) add(b, local[i++]);
+                else add(b, b.scoped[j++]);
+            }
+        }
+        Json p = Json::object();
+        p["uri"] = doc.uri;
+        p["diagnostics"] = std::move(list);
+        notify("textDocument/publishDiagnostics", std::move(p));
+    }
+
+    // line `line` (1-based, within the block) in the document
+    static int documentLine(const Document& doc, double key, int line) {
+        size_t i = blockAt(doc, key);
+        return i == doc.blocks.size() ? 0 : doc.blocks[i].first + line - 1;
+    }
+
+    struct Target {
+        const Document* doc = nullptr;
+        const Block* block = nullptr;
+        int line = 0;
+        std::string word;
+        bool isFunction = false;
+    };
+
+    bool resolveTarget(const Json& params, Target& t) {
+        auto it = documents.find(params["textDocument"]["uri"].str());
+        if (it == documents.end()) return false;
+        t.doc = &it->second;
+        t.line = params["position"]["line"].integer();
+        if (t.line < 0 || t.line >= static_cast<int>(t.doc->lines.size())) return false;
+        const std::string& text = t.doc->lines[t.line];
+        size_t at = byteOffset(text, params["position"]["character"].integer());
+        auto isWord = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+        size_t from = at, to = at;
+        while (from > 0 && isWord(text[from - 1])) --from;
+        while (to < text.size() && isWord(text[to])) ++to;
+        if (from == to) return false;
+        t.word = text.substr(from, to - from);
+        t.isFunction = (from >= 2 && text.compare(from - 2, 2, "f-") == 0) || startsWith(trim(text), "funS");
+        for (const Block& b : t.doc->blocks) {
+            if (t.line >= b.first && t.line < b.first + b.count) t.block = &b;
+        }
+        return true;
+    }
+
+    // params and locals of the funS the cursor is in
+    const FunctionDef* enclosingFunction(const Target& t) const {
+        if (!t.block || t.block->compiled->mod.functions.empty()) return nullptr;
+        return &t.block->compiled->mod.functions.begin()->second;
+    }
+
+    Json definition(const Json& params) {
+        Target t;
+        if (!resolveTarget(params, t)) return Json();
+        const Document& doc = *t.doc;
+        if (const FunctionDef* func = enclosingFunction(t); func && !t.isFunction) {
+            for (const auto& p : func->params)
+                if (p.second == t.word) return location(doc.uri, t.block->first + func->line - 1);
+            for (const Stmt& st : func->code)
+                if (st.kind() == StmtKind::Loc && st.arg(0) == t.word)
+                    return location(doc.uri, t.block->first + st.line() - 1);
+        }
+        auto fn = doc.functions.find(t.word);
+        if (fn != doc.functions.end() && (t.isFunction || !doc.variables.count(t.word)))
+            return location(doc.uri, documentLine(doc, fn->second.back().key, fn->second.back().def->line));
+        if (!t.isFunction) {
+            auto var = doc.variables.find(t.word);
+            if (var != doc.variables.end()) {
+                const Declaration& decl = var->second.front();
+                return location(doc.uri, documentLine(doc, decl.key, decl.line));
+            }
+        }
+        std::set<const Module*> seen;
+        const Module* owner = nullptr;
+        if (const FunctionDef* def = findInModules(doc.imports, t.word, seen, &owner))
+            return location("file://" + owner->path, def->line - 1);
+        return Json();
+    }
+
+    Json hover(const Json& params) {
+        Target t;
+        if (!resolveTarget(params, t)) return Json();
+        const Document& doc = *t.doc;
+        std::string text;
+        if (const FunctionDef* func = enclosingFunction(t); func && !t.isFunction) {
+            for (const auto& p : func->params)
+                if (p.second == t.word) text = p.first + " " + p.second + " (parameter)";
+            for (const Stmt& st : func->code)
+                if (text.empty() && st.kind() == StmtKind::Loc && st.str(0) == t.word)
+                    text = st.str(1) + " " + st.str(0) + " (local)";
+        }
+        if (text.empty()) {
+            auto var = doc.variables.find(t.word);
+            auto fn = doc.functions.find(t.word);
+            if (!t.isFunction && var != doc.variables.end()) {
+                text = var->second.front().type + " " + t.word;
+            } else if (fn != doc.functions.end()) {
+                text = signature(t.word, *fn->second.back().def);
+            } else {
+                std::set<const Module*> seen;
+                const Module* owner = nullptr;
+                if (const FunctionDef* def = findInModules(doc.imports, t.word, seen, &owner))
+                    text = signature(t.word, *def) + "  [" + owner->path + "]";
+            }
+        }
+        if (text.empty()) return Json();
+        Json contents = Json::object();
+        contents["kind"] = "plaintext";
+        contents["value"] = text;
+        Json result = Json::object();
+        result["contents"] = std::move(contents);
+        return result;
+    }
+
+    std::unordered_map<std::string, Document> documents;
+    bool shutdownRequested = false;
+    bool exitRequested = false;
+};
+
+}
+
+int runLanguageServer() {
+    std::ios::sync_with_stdio(false);
+    LanguageServer server;
+    return server.run();
+}
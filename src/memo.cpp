@@ -0,0 +1,215 @@
+#include "h/memo.h"
+#include "h/stats.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <set>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MemoTable* activeMemo = nullptr;
+
+struct MemoTable::Header {
+    char magic[8];
+    uint64_t slotCount; // a power of two
+    uint64_t ringSize;  // bytes, a multiple of 8
+    uint64_t tail;      // bytes ever reserved in the ring; position p is in ring[p % ringSize]
+};
+
+namespace {
+
+const char magic[8] = {'l', 'o', 'm', 'e', 'm', 'o', '1', '\0'};
+const size_t headerSize = 64;
+const unsigned probes = 16;
+const uint64_t tagBits = 16;
+
+struct RecordHead {
+    uint64_t hash;
+    uint32_t keySize, resultSize;
+};
+
+uint64_t fnv(const void* data, size_t size, uint64_t h = 14695981039346656037ULL) {
+    for (size_t i = 0; i < size; ++i) {
+        h ^= static_cast<const unsigned char*>(data)[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+uint64_t fnv(const std::string& s, uint64_t h) {
+    uint64_t size = s.size();
+    return fnv(s.data(), s.size(), fnv(&size, sizeof size, h));
+}
+
+uint64_t identityOf(const FunctionDef& func) {
+    uint64_t h = fnv(func.returnType, 14695981039346656037ULL);
+    for (const auto& [type, name] : func.params) h = fnv(name, fnv(type, h));
+    for (Stmt st : func.code) {
+        StmtKind kind = st.kind();
+        h = fnv(&kind, sizeof kind, h);
+        for (size_t i = 0; i < st.argCount(); ++i) h = fnv(st.str(i), h);
+    }
+    for (const auto& [index, literal] : func.bound) h = fnv(literal, fnv(&index, sizeof index, h));
+    if (func.generic) {
+        uint64_t generic = identityOf(*func.generic);
+        h = fnv(&generic, sizeof generic, h);
+    }
+    return h ? h : 1; // 0 means none
+}
+
+void assignIds(std::map<std::string, FunctionDef>& functions) {
+    for (auto& [name, func] : functions) func.memoId = identityOf(func);
+}
+
+void assignModuleIds(const Module* mod, std::set<const Module*>& seen) {
+    if (!seen.insert(mod).second) return;
+    assignIds(const_cast<Module*>(mod)->functions);
+    for (const Module* dep : mod->imports) assignModuleIds(dep, seen);
+}
+
+// an eighth of the table or less
+uint64_t slotsFor(uint64_t bytes) {
+    uint64_t count = 1024;
+    while (count * 8 * 16 < bytes) count *= 2;
+    return count;
+}
+
+uint64_t positionOf(uint64_t slot) {
+    return ((slot >> tagBits) - 1) * 8;
+}
+
+}
+
+MemoTable::~MemoTable() {
+    if (base) munmap(base, mapped);
+}
+
+bool MemoTable::open(const std::string& path, size_t bytes, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    // creating and checking the table is the only part that locks
+    flock(fd, LOCK_EX);
+    struct stat st {};
+    bool ok = fstat(fd, &st) == 0;
+    bool fresh = ok && st.st_size == 0;
+    if (fresh) {
+        bytes = std::max<size_t>(bytes, headerSize + slotsFor(bytes) * 8 + 4096);
+        ok = ftruncate(fd, static_cast<off_t>(bytes)) == 0;
+        st.st_size = static_cast<off_t>(bytes);
+    }
+    mapped = ok ? static_cast<size_t>(st.st_size) : 0;
+    void* at = ok && mapped > headerSize ? mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (at == MAP_FAILED) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        error = "cannot map " + path;
+        return false;
+    }
+    base = static_cast<unsigned char*>(at);
+    header = reinterpret_cast<Header*>(base);
+    if (fresh) {
+        // the file starts zeroed: empty slots, nothing reserved
+        header->slotCount = slotsFor(mapped);
+        header->ringSize = (mapped - headerSize - header->slotCount * 8) / 8 * 8;
+        std::memcpy(header->magic, magic, sizeof magic);
+        msync(base, headerSize, MS_SYNC);
+    }
+    bool valid = std::memcmp(header->magic, magic, sizeof magic) == 0 && header->slotCount &&
+                 !(header->slotCount & (header->slotCount - 1)) && header->ringSize % 8 == 0 &&
+                 header->ringSize >= 4096 && headerSize + header->slotCount * 8 + header->ringSize <= mapped;
+    flock(fd, LOCK_UN);
+    close(fd);
+    if (!valid) {
+        munmap(base, mapped);
+        base = nullptr;
+        error = path + " is not a lo memo table";
+        return false;
+    }
+    slots = reinterpret_cast<uint64_t*>(base + headerSize);
+    ring = base + headerSize + header->slotCount * 8;
+    return true;
+}
+
+bool MemoTable::find(const std::string& key, std::string& result) const {
+    uint64_t hash = fnv(key.data(), key.size());
+    uint64_t tag = hash & ((1 << tagBits) - 1);
+    uint64_t ringSize = header->ringSize;
+    for (unsigned i = 0; i < probes; ++i) {
+        uint64_t slot = __atomic_load_n(&slots[(hash + i) & (header->slotCount - 1)], __ATOMIC_ACQUIRE);
+        if (!slot) return false;
+        if ((slot & ((1 << tagBits) - 1)) != tag) continue;
+        uint64_t position = positionOf(slot);
+        if (__atomic_load_n(&header->tail, __ATOMIC_ACQUIRE) > position + ringSize) continue; // written over
+        uint64_t offset = position % ringSize;
+        RecordHead head;
+        if (offset + sizeof head > ringSize) continue;
+        std::memcpy(&head, ring + offset, sizeof head);
+        if (head.hash != hash || head.keySize != key.size() ||
+            offset + sizeof head + head.keySize + head.resultSize > ringSize ||
+            std::memcmp(ring + offset + sizeof head, key.data(), key.size()) != 0)
+            continue;
+        result.assign(reinterpret_cast<const char*>(ring + offset + sizeof head + head.keySize), head.resultSize);
+        // an insert may have reserved the record's bytes while they were copied
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&header->tail, __ATOMIC_ACQUIRE) > position + ringSize) return false;
+        return true;
+    }
+    return false;
+}
+
+void MemoTable::insert(const std::string& key, const std::string& result) {
+    uint64_t hash = fnv(key.data(), key.size());
+    uint64_t tag = hash & ((1 << tagBits) - 1);
+    uint64_t ringSize = header->ringSize;
+    uint64_t need = (sizeof(RecordHead) + key.size() + result.size() + 7) / 8 * 8;
+    if (need > ringSize / 16) return;
+
+    uint64_t tail = __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE), position;
+    do {
+        position = tail;
+        // records do not wrap around the end of the ring
+        if (position % ringSize + need > ringSize) position += ringSize - position % ringSize;
+    } while (!__atomic_compare_exchange_n(&header->tail, &tail, position + need, true, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE));
+    unsigned char* record = ring + position % ringSize;
+    RecordHead head{hash, static_cast<uint32_t>(key.size()), static_cast<uint32_t>(result.size())};
+    std::memcpy(record, &head, sizeof head);
+    std::memcpy(record + sizeof head, key.data(), key.size());
+    std::memcpy(record + sizeof head + key.size(), result.data(), result.size());
+
+    uint64_t slot = (position / 8 + 1) << tagBits | tag;
+    for (unsigned i = 0; i < probes; ++i) {
+        uint64_t* at = &slots[(hash + i) & (header->slotCount - 1)];
+        uint64_t seen = __atomic_load_n(at, __ATOMIC_ACQUIRE);
+        // free, or its record has been written over
+        while (!seen || __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE) > positionOf(seen) + ringSize) {
+            if (__atomic_compare_exchange_n(at, &seen, slot, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+                __atomic_fetch_add(&stats.memoStored, 1, __ATOMIC_RELAXED);
+                return;
+            }
+        }
+    }
+    __atomic_store_n(&slots[(hash + (hash >> 32) % probes) & (header->slotCount - 1)], slot, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&stats.memoStored, 1, __ATOMIC_RELAXED);
+}
+
+void assignMemoIds(Module& root, std::map<std::string, FunctionDef>& functions) {
+    std::set<const Module*> seen;
+    assignModuleIds(&root, seen);
+    assignIds(functions);
+}
+
+std::string memoKey(const FunctionDef& func, const std::vector<std::string>& values) {
+    std::string key(reinterpret_cast<const char*>(&func.memoId), sizeof func.memoId);
+    for (const auto& value : values) {
+        uint32_t size = static_cast<uint32_t>(value.size());
+        key.append(reinterpret_cast<const char*>(&size), sizeof size);
+        key += value;
+    }
+    return key;
+}
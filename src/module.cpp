@@ -0,0 +1,264 @@
+#include "h/module.h"
+#include "h/checker.h"
+#include "h/compiler.h"
+#include "h/consteval.h"
+#include "h/generic.h"
+#include "h/readahead.h"
+#include "h/threadpool.h"
+#include "h/utils.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <set>
+#include <sstream>
+
+namespace {
+
+std::regex funRegex(R"(^funS\s+(\w+)\s+(\w+)(?:<([^>]*)>)?\(([^)]*)\):\s*\{$)");
+
+std::map<std::string, std::unique_ptr<Module>> moduleCache;
+std::mutex moduleCacheMutex;
+
+std::string dirName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) return "";
+    return path.substr(0, slash + 1);
+}
+
+bool fileExists(const std::string& path) {
+    std::ifstream f(path);
+    return static_cast<bool>(f);
+}
+
+bool readLines(const std::string& path, std::vector<std::string>& lines) {
+    if (readBackend != ReadBackend::Blocking) return readFileLines(path, lines);
+    std::ifstream file(path);
+    if (!file) return false;
+    std::string line;
+    while (std::getline(file, line)) lines.push_back(line);
+    return true;
+}
+
+Module* findLoaded(const std::string& key) {
+    std::lock_guard<std::mutex> lock(moduleCacheMutex);
+    auto it = moduleCache.find(key);
+    return it == moduleCache.end() ? nullptr : it->second.get();
+}
+
+// Claims `key` in the cache. Returns nullptr when another importer got
+// there first. Newly claimed modules are recorded in `fresh`.
+Module* claimModule(const std::string& key, std::vector<Module*>& fresh) {
+    std::lock_guard<std::mutex> lock(moduleCacheMutex);
+    if (moduleCache.count(key)) return nullptr;
+    auto created = std::make_unique<Module>();
+    created->path = key;
+    Module* mod = created.get();
+    moduleCache[key] = std::move(created);
+    fresh.push_back(mod);
+    return mod;
+}
+
+// Queues compilation of a claimed module. Every import found while compiling
+// is claimed and queued the same way, so independent modules end up
+// compiling side by side.
+void scheduleCompile(ThreadPool& pool, Module* mod, bool allowCode, std::vector<Module*>& fresh) {
+    pool.submit([&pool, mod, allowCode, &fresh] {
+        std::vector<std::string> lines;
+        if (!readLines(mod->path, lines)) { mod->failed = true; return; }
+        compileModule(*mod, lines, allowCode, &pool);
+        for (const auto& imp : mod->importPaths) {
+            if (Module* dep = claimModule(imp.path, fresh)) scheduleCompile(pool, dep, false, fresh);
+        }
+    });
+}
+
+// Single-threaded pass once the pool is idle: reports missing modules and
+// cycles, and collects diagnostics in a deterministic (depth-first import)
+// order.
+class GraphLinker {
+public:
+    explicit GraphLinker(std::vector<Diagnostic>& out) : out(out) {}
+
+    void visit(Module* mod) {
+        if (done.count(mod)) return;
+        done.insert(mod);
+        stack.push_back(mod);
+        std::vector<Diagnostic> local = mod->diagnostics;
+        for (size_t i = 0; i < mod->importPaths.size(); ++i) {
+            Module* dep = const_cast<Module*>(mod->imports[i]);
+            int line = mod->importPaths[i].line;
+            auto onStack = std::find(stack.begin(), stack.end(), dep);
+            if (onStack != stack.end()) {
+                std::string chain = "Import cycle: ";
+                for (auto it = onStack; it != stack.end(); ++it) chain += (*it)->path + " -> ";
+                local.push_back({mod->path, line, chain + dep->path});
+            } else if (dep->failed) {
+                local.push_back({mod->path, line, "Failed to open module " + dep->path});
+            }
+        }
+        std::stable_sort(local.begin(), local.end(),
+                         [](const Diagnostic& a, const Diagnostic& b) { return a.line < b.line; });
+        // compiling and checking can both notice the same problem
+        local.erase(std::unique(local.begin(), local.end(),
+                                [](const Diagnostic& a, const Diagnostic& b) {
+                                    return a.line == b.line && a.message == b.message;
+                                }),
+                    local.end());
+        if (!mod->reported) out.insert(out.end(), local.begin(), local.end());
+        mod->reported = true;
+        for (const Module* dep : mod->imports) {
+            if (!dep->failed) visit(const_cast<Module*>(dep));
+        }
+        stack.pop_back();
+    }
+
+private:
+    std::vector<Diagnostic>& out;
+    std::set<Module*> done;
+    std::vector<Module*> stack;
+};
+
+}
+
+bool parseFunctionHeader(const std::string& line, std::string& name, FunctionDef& def) {
+    std::smatch match;
+    if (!std::regex_match(line, match, funRegex)) return false;
+    name = match[2];
+    def.returnType = match[1];
+    def.body.clear();
+    def.params.clear();
+    def.typeParams.clear();
+    std::stringstream vars(match[3].str());
+    std::string v;
+    while (std::getline(vars, v, ',')) {
+        v = trim(v);
+        // a type variable is used as a loc type, which must be capitalized
+        if (v.empty() || !std::isupper(static_cast<unsigned char>(v[0]))) return false;
+        def.typeParams.push_back(v);
+    }
+    std::string paramStr = match[4];
+    std::stringstream ss(paramStr);
+    std::string p;
+    while (std::getline(ss, p, ',')) {
+        p = trim(p);
+        if (p.empty()) continue;
+        size_t colon = p.find(':');
+        if (colon != std::string::npos) {
+            std::string type = trim(p.substr(0, colon));
+            std::string pname = trim(p.substr(colon + 1));
+            def.params.emplace_back(type, pname);
+        } else {
+            // If the parameter has no type, you can decide by default or fail
+            def.params.emplace_back(std::string("var"), trim(p));
+        }
+    }
+    return true;
+}
+
+std::string resolveImportPath(const std::string& importer, const std::string& path) {
+    if (!path.empty() && path.front() == '/') return path;
+    std::string local = dirName(importer) + path;
+    if (fileExists(local)) return local;
+    return path;
+}
+
+std::vector<Module*> loadModuleGraphs(const std::vector<std::string>& paths, bool allowCode, bool typeCheck,
+                                      unsigned jobs, std::vector<std::vector<Diagnostic>>& diagnostics,
+                                      bool foldCalls) {
+    std::vector<std::string> keys;
+    for (const auto& path : paths) keys.push_back(canonicalPath(path));
+
+    ThreadPool pool(jobs);
+    std::vector<Module*> fresh;
+    // roots are claimed before anything compiles, so a root that another
+    // root imports is still compiled as a root
+    std::vector<Module*> claimed;
+    for (const auto& key : keys) claimed.push_back(claimModule(key, fresh));
+    for (Module* mod : claimed) {
+        if (mod) scheduleCompile(pool, mod, allowCode, fresh);
+    }
+    pool.wait();
+
+    for (Module* mod : fresh) {
+        for (const auto& imp : mod->importPaths) mod->imports.push_back(findLoaded(imp.path));
+    }
+    if (allowCode) {
+        // instances go next to their generic, in modules several roots may
+        // share, so calls are instantiated on this thread; constants come
+        // after, as they may call instances
+        for (Module* mod : claimed) {
+            if (mod && !mod->failed) instantiateGenerics(*mod);
+        }
+        for (Module* mod : claimed) {
+            if (mod && !mod->failed) pool.submit([mod, foldCalls] {
+                ConstTable consts;
+                foldConstants(*mod, consts, nullptr, foldCalls);
+            });
+        }
+        pool.wait();
+    }
+    if (typeCheck) {
+        for (Module* mod : fresh) {
+            if (!mod->failed) pool.submit([mod] { checkModule(*mod); });
+        }
+        pool.wait();
+    }
+
+    std::vector<Module*> roots;
+    diagnostics.assign(keys.size(), {});
+    for (size_t i = 0; i < keys.size(); ++i) {
+        Module* root = findLoaded(keys[i]);
+        roots.push_back(root);
+        if (root->failed) {
+            diagnostics[i].push_back({keys[i], 0, "Failed to open file"});
+            continue;
+        }
+        GraphLinker linker(diagnostics[i]);
+        linker.visit(root);
+    }
+    return roots;
+}
+
+Module* loadModuleGraph(const std::string& path, bool allowCode, unsigned jobs,
+                        std::vector<Diagnostic>& diagnostics, bool foldCalls) {
+    std::vector<std::vector<Diagnostic>> perRoot;
+    Module* root = loadModuleGraphs({path}, allowCode, false, jobs, perRoot, foldCalls).front();
+    diagnostics = std::move(perRoot.front());
+    return root;
+}
+
+const Module* importModule(const std::string& path, std::string& error) {
+    std::string key = canonicalPath(path);
+    const Module* mod = findLoaded(key);
+    if (!mod) {
+        std::vector<Diagnostic> diagnostics;
+        mod = loadModuleGraph(key, false, 1, diagnostics);
+        if (!mod->failed && !diagnostics.empty()) {
+            error = formatDiagnostic(diagnostics.front(), "");
+            return nullptr;
+        }
+    }
+    if (mod->failed) { error = "Failed to open module " + key; return nullptr; }
+    return mod;
+}
+
+static const FunctionDef* lookupInModule(const Module* mod, const std::string& name) {
+    auto it = mod->functions.find(name);
+    if (it != mod->functions.end()) return &it->second;
+    for (const Module* dep : mod->imports) {
+        if (const FunctionDef* def = lookupInModule(dep, name)) return def;
+    }
+    return nullptr;
+}
+
+const FunctionDef* findFunction(Context& ctx, const std::string& name) {
+    auto it = ctx.functions.find(name);
+    if (it != ctx.functions.end()) return &it->second;
+    for (const Module* mod : ctx.imports) {
+        if (const FunctionDef* def = lookupInModule(mod, name)) return &(ctx.functions[name] = *def);
+    }
+    return nullptr;
+}
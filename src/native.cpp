@@ -0,0 +1,64 @@
+#include "h/native.h"
+#include "h/utils.h"
+#include <dlfcn.h>
+#include <map>
+#include <mutex>
+
+namespace {
+
+struct LoadedModule {
+    void* handle;
+    std::vector<std::pair<std::string, NativeFunction>> exports;
+};
+
+// Modules stay loaded for the lifetime of the process, so function
+// pointers handed out below never dangle.
+std::map<std::string, LoadedModule> loadedModules;
+std::mutex loadedModulesMutex;
+
+void registerExport(void* registry, const char* name, int arity, lo_native_fn fn) {
+    if (!name || !fn) return;
+    auto* mod = static_cast<LoadedModule*>(registry);
+    mod->exports.emplace_back(name, NativeFunction{arity, fn});
+}
+
+}
+
+bool loadNativeModule(const std::string& path, NativeTable& table, std::string& error) {
+    std::lock_guard<std::mutex> lock(loadedModulesMutex);
+    std::string key = canonicalPath(path);
+
+    auto it = loadedModules.find(key);
+    if (it == loadedModules.end()) {
+        void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) {
+            const char* msg = dlerror();
+            error = msg ? msg : "dlopen failed";
+            return false;
+        }
+        auto init = reinterpret_cast<lo_module_init_fn>(dlsym(handle, LO_MODULE_INIT_SYMBOL));
+        if (!init) {
+            dlclose(handle);
+            error = std::string("missing entry point ") + LO_MODULE_INIT_SYMBOL;
+            return false;
+        }
+        LoadedModule mod{handle, {}};
+        if (init(LO_NATIVE_ABI_VERSION, &mod, registerExport) != 0) {
+            dlclose(handle);
+            error = "module initialisation failed";
+            return false;
+        }
+        it = loadedModules.emplace(key, std::move(mod)).first;
+    }
+
+    for (const auto& [name, fn] : it->second.exports) table[name] = fn;
+    return true;
+}
+
+std::string callNative(const NativeFunction& fn, const std::vector<std::string>& args) {
+    std::vector<const char*> argv;
+    argv.reserve(args.size());
+    for (const auto& a : args) argv.push_back(a.c_str());
+    const char* res = fn.fn(static_cast<int>(argv.size()), argv.data());
+    return res ? res : "";
+}
@@ -0,0 +1,254 @@
+#include "h/output.h"
+#include "h/json.h"
+#include "h/stats.h"
+#include "h/utils.h"
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+OutputFormat outputFormat = OutputFormat::Text;
+
+namespace {
+
+enum Tag : unsigned char { IntTag = 1, StrTag, BoolTag, ArrTag };
+
+const char* const tagNames[] = {"", "int", "str", "bool", "arr"};
+
+bool isInt(std::string_view type) { return type == "int" || type == "i"; }
+
+Tag tagOf(std::string_view type, std::string_view value, long long& number) {
+    if (isInt(type)) {
+        auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+        if (error == std::errc() && end == value.data() + value.size() && !value.empty()) return IntTag;
+    }
+    if (type == "bool" && (value == "true" || value == "false")) return BoolTag;
+    return type == "arr" ? ArrTag : StrTag;
+}
+
+// Calls `item` with each trimmed item of an arr, as print-- shows them.
+template <class F>
+void forEachItem(std::string_view value, F item) {
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        item(trim(std::string(value.substr(0, comma))));
+        if (comma == std::string_view::npos) break;
+        value.remove_prefix(comma + 1);
+    }
+}
+
+void record(std::string& out, std::string_view type, std::string_view value) {
+    long long number = 0;
+    Tag tag = tagOf(type, value, number);
+    if (outputFormat == OutputFormat::Jsonl) {
+        out += "{\"type\":\"";
+        out += tagNames[tag];
+        out += "\",\"value\":";
+        if (tag == IntTag) out += std::to_string(number);
+        else if (tag == BoolTag) out += value;
+        else if (tag == StrTag) dumpJsonString(value, out);
+        else {
+            out += '[';
+            bool first = true;
+            forEachItem(value, [&](const std::string& item) {
+                if (!first) out += ',';
+                first = false;
+                long long n;
+                if (tagOf("int", item, n) == IntTag) out += std::to_string(n);
+                else dumpJsonString(item, out);
+            });
+            out += ']';
+        }
+        out += "}\n";
+        return;
+    }
+    out += static_cast<char>(tag);
+    size_t at = out.size();
+    out.append(4, '\0');
+    if (tag == IntTag) {
+        for (int i = 0; i < 8; ++i) out += static_cast<char>(static_cast<uint64_t>(number) >> (8 * i));
+    } else if (tag == BoolTag) {
+        out += static_cast<char>(value == "true");
+    } else if (tag == StrTag) {
+        out += value;
+    } else {
+        forEachItem(value, [&](const std::string& item) { record(out, "int", item); });
+    }
+    uint32_t size = static_cast<uint32_t>(out.size() - at - 4);
+    for (int i = 0; i < 4; ++i) out[at + i] = static_cast<char>(size >> (8 * i));
+}
+
+}
+
+void printValue(std::string_view type, std::string_view value) {
+    if (outputFormat == OutputFormat::Text) {
+        if (type != "arr") {
+            std::cout << value << std::endl;
+            return;
+        }
+        std::cout << "[";
+        bool first = true;
+        forEachItem(value, [&first](const std::string& item) {
+            std::cout << (first ? "" : ", ") << item;
+            first = false;
+        });
+        std::cout << "]" << std::endl;
+        return;
+    }
+    // records are not flushed one by one: std::cerr and std::cin flush
+    // std::cout before they write or read anyway
+    static std::string out;
+    out.clear();
+    record(out, type, value);
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+}
+
+bool printFoldable(std::string_view type) {
+    return outputFormat == OutputFormat::Text || type == "str";
+}
+
+// The stream buffer std::cout writes into. Buffer `n % Buffers` is the one
+// being filled while `filled` of them have been handed over; the thread
+// writes them out in order and counts them in `written`. The counters are
+// the handoff: the lock and the condition only put a side to sleep when it
+// has nothing to do.
+class AsyncOutput::Writer : public std::streambuf {
+public:
+    Writer() : thread([this] { loop(); }) {
+        for (auto& buffer : buffers) buffer.reset(new char[BufferSize]);
+        start();
+    }
+    ~Writer() override {
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+    // Returns once everything put so far is on stdout.
+    void flush() {
+        if (pptr() > pbase()) handOver();
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return written.load() == filled.load(); });
+    }
+
+protected:
+    int overflow(int c) override {
+        handOver();
+        if (c != traits_type::eof()) sputc(static_cast<char>(c));
+        return traits_type::not_eof(c);
+    }
+
+    // std::endl: a terminal gets lines as the thread keeps up with them,
+    // like stdio's line buffering; pipes and files get whole buffers
+    int sync() override {
+        if (terminal && pptr() > pbase() && written.load() == filled.load()) handOver();
+        return 0;
+    }
+
+private:
+    static constexpr size_t Buffers = 3;
+    static constexpr size_t BufferSize = 64 << 10;
+
+    void start() {
+        char* buffer = buffers[filled.load() % Buffers].get();
+        setp(buffer, buffer + BufferSize);
+    }
+
+    void handOver() {
+        unsigned n = filled.load();
+        used[n % Buffers] = static_cast<size_t>(pptr() - pbase());
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            filled.store(n + 1);
+        }
+        wake.notify_all();
+        if (n + 1 - written.load() == Buffers) {
+            ++stats.outputStalls;
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, n] { return n + 1 - written.load() < Buffers; });
+        }
+        start();
+    }
+
+    void loop() {
+        for (;;) {
+            unsigned n = written.load();
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, n] { return filled.load() != n || stopping; });
+                if (filled.load() == n) return;
+            }
+            const char* data = buffers[n % Buffers].get();
+            for (size_t size = used[n % Buffers]; size;) {
+                ssize_t done = ::write(STDOUT_FILENO, data, size);
+                if (done < 0 && errno == EINTR) continue;
+                if (done <= 0) break; // what std::cout does on a closed stdout: drop it
+                data += done;
+                size -= static_cast<size_t>(done);
+            }
+            ++stats.outputWrites;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                written.store(n + 1);
+            }
+            wake.notify_all();
+        }
+    }
+
+    const bool terminal = isatty(STDOUT_FILENO);
+    std::unique_ptr<char[]> buffers[Buffers];
+    size_t used[Buffers] = {};
+    std::atomic<unsigned> filled{0};
+    std::atomic<unsigned> written{0};
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread; // last: it starts on a constructed writer
+};
+
+// What std::cerr and std::cin are tied to in place of std::cout: flushing it
+// flushes the writer all the way.
+class AsyncOutput::Drain : public std::streambuf {
+public:
+    explicit Drain(Writer& writer)
+        : writer(writer), stream(this), coutBuf(std::cout.rdbuf(&writer)), cerrTie(std::cerr.tie(&stream)),
+          cinTie(std::cin.tie(&stream)) {}
+    ~Drain() override {
+        std::cin.tie(cinTie);
+        std::cerr.tie(cerrTie);
+        std::cout.rdbuf(coutBuf);
+    }
+
+protected:
+    int sync() override {
+        writer.flush();
+        return 0;
+    }
+
+private:
+    Writer& writer;
+    std::ostream stream;
+    std::streambuf* coutBuf;
+    std::ostream* cerrTie;
+    std::ostream* cinTie;
+};
+
+AsyncOutput::AsyncOutput() {
+    std::cout.flush(); // anything printed before goes first
+    writer = std::make_unique<Writer>();
+    drain = std::make_unique<Drain>(*writer);
+}
+
+AsyncOutput::~AsyncOutput() {
+    drain.reset();
+    writer.reset();
+}
@@ -0,0 +1,209 @@
+#include "h/parallel.h"
+#include "h/error.h"
+#include "h/executor.h"
+#include "h/interpreter.h"
+#include "h/module.h"
+#include "h/output.h"
+#include "h/quicken.h"
+#include "h/stats.h"
+#include "h/threadpool.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <set>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// A top-level call with the argument values it saw.
+struct Call {
+    const FunctionDef* func;
+    std::string name;
+    int line;
+    std::vector<std::string> args;
+    std::unordered_map<std::string, Variable> globals; // the arguments that name variables
+};
+
+std::string runCall(const Call& call) {
+    // executeFunction only hands the function table on
+    static const std::map<std::string, FunctionDef> noFunctions;
+    try {
+        return executeFunction(*call.func, call.args, noFunctions, call.globals);
+    } catch (LoError& e) {
+        if (!e.line) e.line = call.line;
+        e.stack.push_back({sourceName(*call.func, call.name), call.line});
+        throw;
+    }
+}
+
+// Blocks that may print, read input or load code; they wait for the calls
+// before them. The others only set variables, which calls already copied.
+bool loud(const Code& code, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) {
+        switch (code[i].kind()) {
+            case StmtKind::PrintText:
+            case StmtKind::PrintVar:
+            case StmtKind::PrintCall:
+            case StmtKind::Input:
+            case StmtKind::Import:
+            case StmtKind::UseNative:
+            case StmtKind::Trap:
+                return true;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+// Consecutive calls go to the pool together, so its cost is paid per batch.
+// Calls are numbered in program order; one numbered past a call that failed
+// is never printed, so it is skipped rather than run.
+struct Batch {
+    size_t first = 0; // number of calls[0]
+    std::vector<Call> calls;
+    std::vector<std::string> results; // of the calls before the one that failed
+    std::exception_ptr error;
+    std::future<void> done;
+
+    void run(std::atomic<size_t>& failed) {
+        for (size_t i = 0; i < calls.size(); ++i) {
+            if (first + i > failed.load(std::memory_order_relaxed)) return;
+            try {
+                results.push_back(runCall(calls[i]));
+            } catch (...) {
+                error = std::current_exception();
+                size_t seen = failed.load();
+                while (first + i < seen && !failed.compare_exchange_weak(seen, first + i)) {}
+                return;
+            }
+        }
+    }
+};
+
+// Calls in flight, oldest first.
+class Calls {
+public:
+    explicit Calls(unsigned jobs) : window(jobs * 4), pool(jobs) {}
+
+    void add(Call call) {
+        if (warmed.insert(call.func).second) {
+            // the first call quickens the function, which only the main thread may do
+            submit();
+            pool.wait();
+            auto started = Clock::now();
+            auto batch = std::make_shared<Batch>();
+            batch->first = numbered++;
+            batch->calls.push_back(std::move(call));
+            batch->run(failed);
+            std::promise<void> done;
+            batch->done = done.get_future();
+            done.set_value();
+            pending.push_back(batch);
+            mainWork += Clock::now() - started;
+            // nothing after it runs
+            if (batch->error) print();
+            return;
+        }
+        ++stats.parallelCalls;
+        if (!open) {
+            open = std::make_shared<Batch>();
+            open->first = numbered;
+        }
+        ++numbered;
+        open->calls.push_back(std::move(call));
+        if (open->calls.size() == batchSize) submit();
+    }
+
+    // Prints results until `keep` batches are left in flight; rethrows the
+    // failure of the first failed call.
+    void print(size_t keep = 0) {
+        submit();
+        while (pending.size() > keep) {
+            std::shared_ptr<Batch> next = std::move(pending.front());
+            pending.pop_front();
+            next->done.wait();
+            for (size_t i = 0; i < next->results.size(); ++i)
+                printValue(next->calls[i].func->returnType, next->results[i]);
+            if (next->error) std::rethrow_exception(next->error);
+        }
+    }
+
+    // Time spent computing on every thread.
+    Clock::duration work() const { return mainWork + Clock::duration(workerNs.load()); }
+
+    Clock::duration mainWork{};
+
+private:
+    static constexpr size_t batchSize = 32;
+
+    void submit() {
+        if (!open) return;
+        // the batch owns the task's future, so the task must not own the batch;
+        // pending keeps it until the pool is joined
+        auto task = std::make_shared<std::packaged_task<void()>>([this, batch = open.get()] {
+            quickReadOnly = true;
+            auto started = Clock::now();
+            batch->run(failed);
+            workerNs += (Clock::now() - started).count();
+        });
+        open->done = task->get_future();
+        pending.push_back(std::move(open));
+        open.reset();
+        pool.submit([task] { (*task)(); });
+        if (pending.size() > window) print(window);
+    }
+
+    std::shared_ptr<Batch> open; // collecting calls
+    std::deque<std::shared_ptr<Batch>> pending;
+    std::set<const FunctionDef*> warmed;
+    size_t numbered = 0;
+    std::atomic<size_t> failed{SIZE_MAX}; // number of the first call known to have failed
+    std::atomic<Clock::rep> workerNs{0};
+    size_t window; // batches in flight before the oldest is waited for
+    ThreadPool pool; // last: its tasks use the members above until it is joined
+};
+
+}
+
+void runParallel(Context& ctx, const Code& code, unsigned jobs) {
+    // one thread has nothing to overlap with
+    if (jobs <= 1) return runCode(ctx, code);
+    stats.parallelThreads = jobs;
+    shareTextAcrossThreads(); // calls hold copies of the globals they read
+    auto started = Clock::now();
+    Calls calls(jobs);
+    for (uint32_t pc = 0; pc < code.size();) {
+        Stmt st = code[pc];
+        uint32_t end = blockEnd(code, pc);
+        ++stats.parallelUnits;
+        const FunctionDef* func = st.kind() == StmtKind::PrintCall ? findFunction(ctx, st.str(0)) : nullptr;
+        if (func) {
+            Call call{func, st.str(0), st.line(), st.args(1), {}};
+            for (const auto& arg : call.args) {
+                auto var = ctx.variables.find(arg);
+                if (var != ctx.variables.end()) call.globals.insert(*var);
+            }
+            calls.add(std::move(call));
+        } else {
+            if (loud(code, pc, end)) calls.print();
+            auto ran = Clock::now();
+            try {
+                runCode(ctx, code, pc, end);
+            } catch (...) {
+                // a call before the block that failed too is reported instead
+                calls.print();
+                throw;
+            }
+            calls.mainWork += Clock::now() - ran;
+        }
+        pc = end;
+    }
+    calls.print();
+    auto wall = Clock::now() - started;
+    if (wall.count()) stats.parallelism = std::chrono::duration<double>(calls.work()) / wall;
+}
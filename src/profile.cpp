@@ -0,0 +1,218 @@
+#include "h/profile.h"
+#include "h/jumptable.h"
+#include "h/quicken.h"
+#include "h/stats.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+Profile* activeProfile = nullptr;
+
+namespace {
+
+const char* header = "lo-profile 1";
+
+// A test of the chain's variable against an int literal.
+struct Test {
+    char op; // '=', '>' or '<'
+    long long number;
+    std::string text;
+};
+
+bool parseTest(Stmt st, const std::string& subject, const std::set<std::string>& declared, Test& test) {
+    if (st.str(0) != subject) return false;
+    std::string rhs = st.str(2);
+    // a word naming a variable compares with it; any other word but a
+    // number fails to convert for an int variable, naming the literal
+    if (declared.count(rhs) || rhs.find_first_not_of("0123456789") != std::string::npos) return false;
+    try {
+        test.number = std::stoll(rhs);
+    } catch (...) {
+        return false;
+    }
+    test.text = rhs;
+    std::string op = st.str(1);
+    test.op = op == "===" ? '=' : op == ">>" ? '>' : '<';
+    return true;
+}
+
+// No int value passes both tests.
+bool excludeAsInts(const Test& a, const Test& b) {
+    using Wide = __int128;
+    const Wide far = Wide(1) << 100;
+    auto bounds = [far](const Test& t) {
+        Wide v = t.number;
+        return t.op == '=' ? std::make_pair(v, v) : t.op == '>' ? std::make_pair(v + 1, far) : std::make_pair(-far, v - 1);
+    };
+    auto [aLow, aHigh] = bounds(a);
+    auto [bLow, bHigh] = bounds(b);
+    return aHigh < bLow || bHigh < aLow;
+}
+
+// No string passes both tests. Strings have no neighbours, so two open
+// ranges only miss each other when they do not overlap at all.
+bool excludeAsStrings(const Test& a, const Test& b) {
+    if (a.op == b.op) return a.op == '=' && a.text != b.text;
+    if (a.op != '=' && b.op == '=') return excludeAsStrings(b, a);
+    if (a.op == '=') return b.op == '>' ? a.text <= b.text : a.text >= b.text;
+    const Test& above = a.op == '>' ? a : b;
+    const Test& below = a.op == '<' ? a : b;
+    return below.text <= above.text;
+}
+
+// Tests the branches of the chain headed at `head` in the order the
+// profile took them most, when that order cannot change the outcome.
+bool reorderChain(Code& code, Stmt head, const Profile& profile, const std::set<std::string>& declared) {
+    if (!profile.chainRuns(head.line())) return false;
+    std::string subject = head.str(0);
+    std::vector<uint32_t> branches;
+    std::vector<Test> tests;
+    for (uint32_t b = head.index(); b < head.end(); b = code[b].next()) {
+        Test test;
+        if (!parseTest(code[b], subject, declared, test)) return false;
+        branches.push_back(b);
+        tests.push_back(test);
+    }
+    for (size_t i = 0; i < tests.size(); ++i) {
+        for (size_t j = i + 1; j < tests.size(); ++j) {
+            if (!excludeAsInts(tests[i], tests[j]) || !excludeAsStrings(tests[i], tests[j])) return false;
+        }
+    }
+    std::vector<uint32_t> order = branches;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return profile.branchTaken(code[a].line()) > profile.branchTaken(code[b].line());
+    });
+    if (order == branches) return false;
+    const JumpTable* table = head.table();
+    auto ordered = table ? std::make_shared<JumpTable>(*table) : std::make_shared<JumpTable>(head.end());
+    ordered->setTestOrder(std::move(order));
+    code.setTable(head.index(), std::move(ordered));
+    return true;
+}
+
+void markGenericReturns(const Module* mod, const Profile& profile, std::set<const Module*>& seen) {
+    if (!mod || !seen.insert(mod).second) return;
+    for (const auto& [name, func] : mod->functions) {
+        if (!profile.genericReturn(name)) continue;
+        for (Stmt st : func.code) {
+            if (st.kind() != StmtKind::Return) continue;
+            QuickSite& q = st.quick();
+            if (q.form != QuickForm::Unseen) continue;
+            q.form = QuickForm::Generic;
+            ++stats.profileGenericReturns;
+        }
+    }
+    for (const Module* dep : mod->imports) markGenericReturns(dep, profile, seen);
+}
+
+}
+
+uint64_t Profile::count(const std::unordered_map<int, uint64_t>& counts, int line) {
+    auto it = counts.find(line);
+    return it == counts.end() ? 0 : it->second;
+}
+
+bool Profile::merge(const std::string& path, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot read " + path;
+        return false;
+    }
+    std::string line;
+    uint64_t recorded = 0;
+    if (!std::getline(in, line) || line != header || !(in >> line >> recorded) || line != "source") {
+        error = path + " is not a lo profile";
+        return false;
+    }
+    if (recorded != source) {
+        error = path + " was recorded for another version of the program";
+        return false;
+    }
+    std::string kind;
+    while (in >> kind) {
+        if (kind == "runs") {
+            uint64_t n = 0;
+            in >> n;
+            runs += n;
+        } else if (kind == "chain" || kind == "branch" || kind == "site") {
+            int at = 0;
+            uint64_t n = 0;
+            in >> at >> n;
+            (kind == "chain" ? chains : kind == "branch" ? branches : sites)[at] += n;
+        } else if (kind == "return") {
+            std::string name, form;
+            in >> name >> form;
+            (form == "int" ? intReturns : genericReturns).insert(name);
+        } else {
+            std::getline(in, line);
+        }
+    }
+    return true;
+}
+
+bool Profile::save(const std::string& path, std::string& error) const {
+    std::ostringstream out;
+    out << header << "\nsource " << source << "\nruns " << runs << "\n";
+    // sorted, so profiles of the same runs compare equal
+    for (const auto& [kind, counts] : {std::make_pair("chain", &chains), std::make_pair("branch", &branches),
+                                       std::make_pair("site", &sites)}) {
+        std::map<int, uint64_t> sorted(counts->begin(), counts->end());
+        for (const auto& [at, n] : sorted) out << kind << " " << at << " " << n << "\n";
+    }
+    for (const auto& name : intReturns) out << "return " << name << " int\n";
+    for (const auto& name : genericReturns) out << "return " << name << " generic\n";
+    std::ofstream file(path, std::ios::trunc);
+    if (!(file << out.str())) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+void Profile::chainRan(Stmt head, uint32_t target) {
+    ++chains[head.line()];
+    if (target != head.end()) ++branches[head.code()[target - 1].line()];
+}
+
+void Profile::called(Stmt site) {
+    ++sites[site.line()];
+}
+
+void Profile::finishRun(const std::map<std::string, FunctionDef>& functions) {
+    ++runs;
+    for (const auto& [name, func] : functions) {
+        for (Stmt st : func.code) {
+            if (st.kind() != StmtKind::Return) continue;
+            QuickForm form = st.quick().form;
+            if (form == QuickForm::IntReturn) intReturns.insert(name);
+            else if (form == QuickForm::Generic) genericReturns.insert(name);
+        }
+    }
+}
+
+uint64_t sourceFingerprint(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return 0;
+    std::ostringstream text;
+    text << in.rdbuf();
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : text.str()) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void applyProfile(Module& mod, const Profile& profile) {
+    std::set<std::string> declared;
+    for (Stmt st : mod.code) {
+        if ((st.kind() == StmtKind::Loc || st.kind() == StmtKind::Input || st.kind() == StmtKind::Catch) &&
+            st.argCount())
+            declared.insert(st.str(0));
+    }
+    for (Stmt st : mod.code) {
+        if (st.kind() == StmtKind::If && reorderChain(mod.code, st, profile, declared)) ++stats.profileReorderedChains;
+    }
+    std::set<const Module*> seen;
+    markGenericReturns(&mod, profile, seen);
+}
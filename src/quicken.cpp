@@ -0,0 +1,267 @@
+#include "h/quicken.h"
+#include "h/evaluator.h"
+#include "h/stats.h"
+#include "h/utils.h"
+#include <algorithm>
+#include <regex>
+
+bool parseQuickInt(std::string_view s, long long& out, bool allowSign) {
+    size_t i = allowSign && !s.empty() && s[0] == '-' ? 1 : 0;
+    if (i == s.size() || s.size() - i > 18) return false;
+    long long value = 0;
+    for (size_t j = i; j < s.size(); ++j) {
+        if (s[j] < '0' || s[j] > '9') return false;
+        value = value * 10 + (s[j] - '0');
+    }
+    out = i ? -value : value;
+    return true;
+}
+
+thread_local bool quickReadOnly = false;
+
+namespace {
+
+std::regex returnShapeRegex(R"(^(\w+)(?:\s*([-+*/%^])\s*(\w+))?$)");
+
+bool isDigits(const std::string& s) {
+    return !s.empty() && s.find_first_not_of("0123456789") == std::string::npos;
+}
+
+std::string locValue(const Stmt& st) {
+    const std::string &type = st.str(1), &val = st.str(2);
+    if (type == "str" && val.front() == '"' && val.back() == '"') return val.substr(1, val.size() - 2);
+    return type == "int" ? evalExpression(val) : val;
+}
+
+// The value of a return quickened to `shape`; false when an operand is
+// missing or is not an int the generic path reads the same way.
+bool intReturn(const ReturnShape& shape, const VariableMap& locals, std::string& out, bool& odd) {
+    long long value[2] = {shape.literal[0], shape.literal[1]};
+    for (int i = 0; i < 2; ++i) {
+        if (shape.operand[i].empty()) continue;
+        auto local = locals.find(shape.operand[i]);
+        if (local == locals.end()) return false;
+        if (!parseQuickInt(local->second.value.view(), value[i], !shape.op)) {
+            odd = true;
+            return false;
+        }
+        if (!shape.op) {
+            // a bare operand comes back as its text
+            out = local->second.value;
+            return true;
+        }
+    }
+    out = std::to_string(applyOperator(value[0], shape.op, value[1]));
+    return true;
+}
+
+void giveUp(QuickSite& q) {
+    q.form = QuickForm::Generic;
+    ++stats.guardFailures;
+}
+
+template <typename T>
+bool compare(const T& l, char op, const T& r) {
+    if (op == '>') return l > r;
+    if (op == '<') return l < r;
+    return l == r;
+}
+
+void specializeCondition(QuickSite& q, VariableMap& vars, const Stmt& st) {
+    auto left = vars.find(st.str(0));
+    if (left == vars.end()) return; // nothing to observe yet
+    const std::string& op = st.str(1);
+    q.op = op == ">>" ? '>' : op == "<<" ? '<' : op == "===" ? '=' : 0;
+    q.form = QuickForm::Generic;
+    q.scope = &vars;
+    q.lhs = &left->second;
+    q.knownVars = vars.size();
+    const std::string& type = q.lhs->type;
+    if (!q.op || (type != "int" && type != "str")) {
+        ++stats.genericSites;
+        return;
+    }
+    auto right = vars.find(st.str(2));
+    if (right != vars.end()) {
+        if (right->second.type != type) {
+            ++stats.genericSites;
+            return;
+        }
+        q.rhs = &right->second;
+    } else if (type == "int") {
+        if (!parseQuickInt(stripQuotes(st.str(2)), q.number)) {
+            ++stats.genericSites;
+            return;
+        }
+    } else {
+        q.value = stripQuotes(st.str(2));
+    }
+    if (type == "int") {
+        q.form = QuickForm::IntCompare;
+        ++stats.intCompares;
+    } else {
+        q.form = QuickForm::StrCompare;
+        ++stats.strCompares;
+    }
+}
+
+}
+
+bool quickCondition(VariableMap& vars, const Stmt& st) {
+    QuickSite& q = st.quick();
+    if (q.form == QuickForm::Unseen) specializeCondition(q, vars, st);
+    if (q.form != QuickForm::Generic && q.form != QuickForm::Unseen && q.scope == &vars) {
+        const char* type = q.form == QuickForm::IntCompare ? "int" : "str";
+        bool literalStill = true;
+        if (!q.rhs && vars.size() != q.knownVars) {
+            literalStill = !vars.count(st.str(2));
+            q.knownVars = vars.size();
+        }
+        if (!literalStill || q.lhs->type != type || (q.rhs && q.rhs->type != type)) {
+            giveUp(q);
+        } else if (q.form == QuickForm::StrCompare) {
+            return compare(q.lhs->value.str(), q.op, q.rhs ? q.rhs->value.str() : q.value.str());
+        } else {
+            long long l, r = q.number;
+            if (parseQuickInt(q.lhs->value.view(), l) && (!q.rhs || parseQuickInt(q.rhs->value.view(), r))) return compare(l, q.op, r);
+            // an odd value: the generic path parses (or reports) it
+        }
+    }
+    return evaluateCondition(vars, st.str(0), st.str(1), st.str(2));
+}
+
+bool quickAssign(VariableMap& vars, const Stmt& st) {
+    QuickSite& q = st.quick();
+    if (q.form == QuickForm::Unseen) {
+        auto it = vars.find(st.str(0));
+        if (it == vars.end()) return false;
+        Variable& var = it->second;
+        std::string rhs = st.str(1);
+        // the same rules as processAssign; only the variable's type decides
+        if (var.type == "int") {
+            rhs = evalExpression(rhs);
+        } else if (var.type == "bool") {
+            rhs = trim(rhs);
+            if (rhs == "true" || rhs == "1") rhs = "true";
+            else if (rhs == "false" || rhs == "0") rhs = "false";
+            else return false;
+        } else if (rhs.size() >= 2 && rhs.front() == '"' && rhs.back() == '"') {
+            rhs = rhs.substr(1, rhs.size() - 2);
+        }
+        q.form = QuickForm::Assign;
+        q.scope = &vars;
+        q.lhs = &var;
+        q.type = var.type;
+        q.value = std::move(rhs);
+        ++stats.assigns;
+    }
+    if (q.form != QuickForm::Assign || q.scope != &vars) return false;
+    if (q.lhs->type != q.type) {
+        giveUp(q);
+        return false;
+    }
+    q.lhs->value = q.value;
+    return true;
+}
+
+const Variable* quickLoad(VariableMap& vars, const Stmt& st) {
+    QuickSite& q = st.quick();
+    if (q.form == QuickForm::Unseen) {
+        auto it = vars.find(st.str(0));
+        if (it == vars.end()) return nullptr;
+        q.scope = &vars;
+        q.lhs = &it->second;
+        if (q.lhs->type == "arr") {
+            q.form = QuickForm::Generic;
+            ++stats.genericSites;
+        } else {
+            q.form = QuickForm::Load;
+            ++stats.loads;
+        }
+    }
+    if (q.form != QuickForm::Load || q.scope != &vars) return nullptr;
+    if (q.lhs->type == "arr") {
+        giveUp(q);
+        return nullptr;
+    }
+    return q.lhs;
+}
+
+const Text& quickLocValue(const Stmt& st) {
+    if (quickReadOnly) {
+        const QuickSite* made = st.quickMade();
+        if (made && made->form == QuickForm::ConstLoc) return made->value;
+        thread_local Text value;
+        return value = locValue(st);
+    }
+    QuickSite& q = st.quick();
+    if (q.form == QuickForm::Unseen) {
+        q.value = locValue(st);
+        q.form = QuickForm::ConstLoc;
+        ++stats.constLocs;
+    }
+    return q.value;
+}
+
+// The generic return substitutes every local name wherever it occurs in
+// the text and evaluates the result. Reading the operands directly gives
+// the same answer when each local name occurs exactly as a whole operand.
+bool matchReturnShape(const FunctionDef& func, const std::string& expr, ReturnShape& shape) {
+    std::smatch m;
+    if (!std::regex_match(expr, m, returnShapeRegex)) return false;
+    shape = ReturnShape();
+    size_t operands = m[2].matched ? 2 : 1;
+    for (size_t i = 0; i < operands; ++i) {
+        std::string token = m[i == 0 ? 1 : 3];
+        if (!isDigits(token)) shape.operand[i] = token;
+        else if (operands == 1 || !parseQuickInt(token, shape.literal[i], false)) return false;
+    }
+    std::vector<std::string> names;
+    for (const auto& param : func.params) names.push_back(param.second);
+    for (Stmt s : func.code)
+        if (s.kind() == StmtKind::Loc) names.push_back(s.str(0));
+    for (size_t i = 0; i < operands; ++i) {
+        if (!shape.operand[i].empty() && std::find(names.begin(), names.end(), shape.operand[i]) == names.end())
+            return false; // not a local: the text stays as it is
+    }
+    for (const auto& name : names) {
+        if (isDigits(name)) return false;
+        size_t seen = 0;
+        for (size_t pos = expr.find(name); pos != std::string::npos; pos = expr.find(name, pos + 1)) ++seen;
+        if (seen != size_t((shape.operand[0] == name) + (shape.operand[1] == name))) return false;
+    }
+    shape.op = operands == 2 ? m[2].str()[0] : 0;
+    return true;
+}
+
+bool quickReturn(const FunctionDef& func, const Stmt& st, const VariableMap& locals, std::string& out) {
+    if (quickReadOnly) {
+        const QuickSite* made = st.quickMade();
+        bool odd = false;
+        return made && made->form == QuickForm::IntReturn && intReturn(made->shape, locals, out, odd);
+    }
+    QuickSite& q = st.quick();
+    ReturnShape& shape = q.shape;
+    if (q.form == QuickForm::Unseen) {
+        bool ok = matchReturnShape(func, st.str(0), shape);
+        // param types are free text; the values show what came in
+        for (int i = 0; ok && i < 2; ++i) {
+            if (shape.operand[i].empty()) continue;
+            auto local = locals.find(shape.operand[i]);
+            long long observed;
+            ok = local != locals.end() && parseQuickInt(local->second.value.view(), observed, !shape.op);
+        }
+        if (ok) {
+            q.form = QuickForm::IntReturn;
+            ++stats.intReturns;
+        } else {
+            q.form = QuickForm::Generic;
+            ++stats.genericSites;
+        }
+    }
+    if (q.form != QuickForm::IntReturn) return false;
+    bool odd = false;
+    if (intReturn(shape, locals, out, odd)) return true;
+    if (odd) giveUp(q);
+    return false;
+}
@@ -0,0 +1,371 @@
+#include "h/readahead.h"
+#include "h/stats.h"
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+ReadBackend readBackend = ReadBackend::Blocking;
+
+namespace {
+
+constexpr size_t Chunks = 4;
+constexpr size_t ChunkSize = 128 << 10;
+
+}
+
+// Chunk n of the input goes to buffer n % Chunks. A regular file has every
+// buffer but the one the caller holds being filled.
+class ReadAhead::Source {
+public:
+    explicit Source(int fd) : fd(fd) {
+        struct stat st;
+        file = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+        offset = file ? std::max<off_t>(lseek(fd, 0, SEEK_CUR), 0) : 0;
+        for (auto& buffer : buffers) buffer.reset(new char[ChunkSize]);
+    }
+    virtual ~Source() = default;
+
+    virtual std::string_view next() = 0;
+
+protected:
+    char* buffer(size_t n) { return buffers[n % Chunks].get(); }
+
+    const int fd;
+    bool file;
+    off_t offset; // where chunk 0 of a file starts
+    std::unique_ptr<char[]> buffers[Chunks];
+};
+
+namespace {
+
+// io_uring through the bare system calls; there is no liburing to build on.
+// Each submission is entered right away, so the submission ring never holds
+// more than one entry and the completion ring always has room.
+class UringSource : public ReadAhead::Source {
+public:
+    explicit UringSource(int fd) : Source(fd) {}
+
+    ~UringSource() override {
+        // a read of a pipe or a terminal may never finish by itself
+        for (size_t b = 0; b < Chunks && !broken; ++b) {
+            if (result[b] == Pending) submit(IORING_OP_ASYNC_CANCEL, -1, Cancel, b, 0);
+        }
+        while (inFlight && !broken) reap();
+        if (broken && inFlight) {
+            for (auto& buffer : buffers) buffer.release(); // reads may still land in them
+        }
+        if (sqes != MAP_FAILED) munmap(sqes, sqeBytes);
+        if (cqMap != MAP_FAILED && cqMap != sqMap) munmap(cqMap, cqBytes);
+        if (sqMap != MAP_FAILED) munmap(sqMap, sqBytes);
+        if (ring >= 0) close(ring);
+    }
+
+    // False when io_uring is not to be had; nothing was read then.
+    bool start() {
+        io_uring_params p{};
+        ring = static_cast<int>(syscall(__NR_io_uring_setup, 8, &p));
+        if (ring < 0) return false;
+        sqBytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqBytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqBytes = cqBytes = std::max(sqBytes, cqBytes);
+        sqMap = mmap(nullptr, sqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED) return false;
+        cqMap = single ? sqMap
+                       : mmap(nullptr, cqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring,
+                              IORING_OFF_CQ_RING);
+        if (cqMap == MAP_FAILED) return false;
+        sqeBytes = p.sq_entries * sizeof(io_uring_sqe);
+        void* entries = mmap(nullptr, sqeBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring,
+                             IORING_OFF_SQES);
+        if (entries == MAP_FAILED) return false;
+        sqes = static_cast<io_uring_sqe*>(entries);
+        char* sq = static_cast<char*>(sqMap);
+        char* cq = static_cast<char*>(cqMap);
+        sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return read(queued++);
+    }
+
+    std::string_view next() override {
+        if (ended) return {};
+        size_t n = taken++;
+        // chunk n - 1 is done with, so its buffer takes chunk n + Chunks - 1
+        while (file && queued < n + Chunks && read(queued)) ++queued;
+        int got;
+        while ((got = wait(n)) == -EINTR || got == -EAGAIN) read(n);
+        if (file && got > 0 && static_cast<size_t>(got) < ChunkSize) got = finish(n, got);
+        if (got <= 0) {
+            ended = true;
+            return {};
+        }
+        // a short chunk of a file is its last; a pipe's next chunk is read
+        // only now, after this one
+        if (file) ended = static_cast<size_t>(got) < ChunkSize;
+        else read(queued++);
+        __atomic_fetch_add(&stats.readAheadChunks, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats.readAheadUring, 1, __ATOMIC_RELAXED);
+        return {buffer(n), static_cast<size_t>(got)};
+    }
+
+private:
+    static constexpr int Pending = INT_MIN;
+    static constexpr uint64_t Cancel = Chunks; // user_data of cancellations
+
+    long enter(unsigned submitted, unsigned wanted) {
+        return syscall(__NR_io_uring_enter, ring, submitted, wanted, wanted ? IORING_ENTER_GETEVENTS : 0,
+                       nullptr, 0);
+    }
+
+    bool submit(uint8_t op, int target, uint64_t data, uint64_t addr, uint64_t off) {
+        unsigned tail = *sqTail, i = tail & *sqMask;
+        io_uring_sqe& e = sqes[i];
+        std::memset(&e, 0, sizeof e);
+        e.opcode = op;
+        e.fd = target;
+        e.addr = addr;
+        e.len = op == IORING_OP_READV ? 1 : 0;
+        e.off = off;
+        e.user_data = data;
+        sqArray[i] = i;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        long entered;
+        while ((entered = enter(1, 0)) < 0 && errno == EINTR) {}
+        if (entered != 1) {
+            broken = true;
+            return false;
+        }
+        ++inFlight;
+        return true;
+    }
+
+    // Queues chunk n; false with the chunk failed when it cannot.
+    bool read(size_t n) {
+        size_t b = n % Chunks;
+        iov[b] = {buffer(n), ChunkSize};
+        // -1: a pipe or a terminal reads at its current position
+        uint64_t off = file ? static_cast<uint64_t>(offset) + n * ChunkSize : ~uint64_t(0);
+        result[b] = Pending;
+        if (!broken && submit(IORING_OP_READV, fd, b, reinterpret_cast<uint64_t>(&iov[b]), off)) return true;
+        result[b] = -EIO;
+        return false;
+    }
+
+    void reap() {
+        unsigned head = *cqHead;
+        while (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            if (enter(0, 1) < 0 && errno != EINTR) {
+                broken = true;
+                return;
+            }
+        }
+        const io_uring_cqe& c = cqes[head & *cqMask];
+        if (c.user_data < Chunks) result[c.user_data] = c.res;
+        --inFlight;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    }
+
+    int wait(size_t n) {
+        int& r = result[n % Chunks];
+        while (r == Pending && !broken) reap();
+        return r == Pending ? -EIO : r;
+    }
+
+    // A short read of a file before its end: read the rest of the chunk
+    // directly.
+    int finish(size_t n, int got) {
+        off_t at = offset + static_cast<off_t>(n * ChunkSize);
+        while (static_cast<size_t>(got) < ChunkSize) {
+            ssize_t more = pread(fd, buffer(n) + got, ChunkSize - got, at + got);
+            if (more < 0 && errno == EINTR) continue;
+            if (more <= 0) break;
+            got += static_cast<int>(more);
+        }
+        return got;
+    }
+
+    int ring = -1;
+    void* sqMap = MAP_FAILED;
+    void* cqMap = MAP_FAILED;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqBytes = 0, cqBytes = 0, sqeBytes = 0;
+    unsigned *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+    unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    iovec iov[Chunks];
+    int result[Chunks] = {};
+    size_t queued = 0; // chunks submitted
+    size_t taken = 0;  // chunks handed out
+    unsigned inFlight = 0;
+    bool ended = false;
+    bool broken = false; // the ring stopped answering
+};
+
+// Reads on a thread of its own, staying at most Chunks chunks ahead. Before
+// reading a pipe or a terminal it polls an eventfd too, so the destructor
+// can stop it while it waits for input that never comes.
+class ThreadSource : public ReadAhead::Source {
+public:
+    explicit ThreadSource(int fd) : Source(fd), stop(eventfd(0, EFD_CLOEXEC)), thread([this] { loop(); }) {}
+
+    ~ThreadSource() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        uint64_t one = 1;
+        if (stop >= 0 && ::write(stop, &one, sizeof one) < 0) {}
+        if (thread.joinable()) thread.join();
+        if (stop >= 0) close(stop);
+    }
+
+    std::string_view next() override {
+        if (ended) return {};
+        size_t n = taken++;
+        ssize_t got;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            released = n;
+            changed.notify_all();
+            changed.wait(lock, [this, n] { return ready > n; });
+            got = sizes[n % Chunks];
+        }
+        ended = got <= 0 || (file && static_cast<size_t>(got) < ChunkSize);
+        if (ended) thread.join(); // it stops after the last chunk too
+        if (got <= 0) return {};
+        __atomic_fetch_add(&stats.readAheadChunks, 1, __ATOMIC_RELAXED);
+        return {buffer(n), static_cast<size_t>(got)};
+    }
+
+private:
+    void loop() {
+        for (size_t n = 0;; ++n) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this, n] { return n < released + Chunks || stopping; });
+                if (stopping) return;
+            }
+            ssize_t got = fill(buffer(n));
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                sizes[n % Chunks] = got;
+                ready = n + 1;
+            }
+            changed.notify_all();
+            if (got <= 0 || (file && static_cast<size_t>(got) < ChunkSize)) return;
+        }
+    }
+
+    // A file fills the chunk; a pipe or a terminal gives what one read does.
+    ssize_t fill(char* to) {
+        size_t got = 0;
+        while (got < ChunkSize) {
+            if (!file) {
+                pollfd fds[2] = {{fd, POLLIN, 0}, {stop, POLLIN, 0}};
+                if (poll(fds, stop >= 0 ? 2 : 1, -1) < 0) {
+                    if (errno == EINTR) continue;
+                    return -1;
+                }
+                if (fds[1].revents) return -1;
+            }
+            ssize_t more = ::read(fd, to + got, ChunkSize - got);
+            if (more < 0 && (errno == EINTR || (errno == EAGAIN && !file))) continue;
+            if (more <= 0) return got ? static_cast<ssize_t>(got) : more;
+            got += static_cast<size_t>(more);
+            if (!file) break;
+        }
+        return static_cast<ssize_t>(got);
+    }
+
+    const int stop;
+    std::mutex mutex;
+    std::condition_variable changed;
+    ssize_t sizes[Chunks] = {};
+    size_t ready = 0;    // chunks read
+    size_t released = 0; // chunks the caller is done with
+    bool stopping = false;
+    size_t taken = 0;
+    bool ended = false;
+    std::thread thread; // last: it starts on a constructed source
+};
+
+// std::cin's buffer under --read-ahead.
+class InputBuf : public std::streambuf {
+public:
+    InputBuf() : reader(STDIN_FILENO, readBackend) {}
+
+protected:
+    int underflow() override {
+        std::string_view chunk = reader.next();
+        if (chunk.empty()) return traits_type::eof();
+        char* begin = const_cast<char*>(chunk.data());
+        setg(begin, begin, begin + chunk.size());
+        return traits_type::to_int_type(*begin);
+    }
+
+private:
+    ReadAhead reader;
+};
+
+}
+
+ReadAhead::ReadAhead(int fd, ReadBackend backend) {
+    if (backend == ReadBackend::Uring) {
+        auto uring = std::make_unique<UringSource>(fd);
+        if (uring->start()) source = std::move(uring);
+    }
+    if (!source) source = std::make_unique<ThreadSource>(fd);
+}
+
+ReadAhead::~ReadAhead() = default;
+
+std::string_view ReadAhead::next() {
+    return source->next();
+}
+
+bool readFileLines(const std::string& path, std::vector<std::string>& lines) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    {
+        ReadAhead reader(fd, readBackend);
+        std::string line;
+        for (std::string_view chunk = reader.next(); !chunk.empty(); chunk = reader.next()) {
+            for (size_t end; (end = chunk.find('\n')) != std::string_view::npos; chunk.remove_prefix(end + 1)) {
+                line.append(chunk.substr(0, end));
+                lines.push_back(std::move(line));
+                line.clear();
+            }
+            line.append(chunk);
+        }
+        if (!line.empty()) lines.push_back(std::move(line));
+    }
+    close(fd);
+    return true;
+}
+
+void readStdinAhead() {
+    // never freed: a read of a terminal may still be waiting at exit
+    static InputBuf* input = new InputBuf;
+    std::cin.rdbuf(input);
+}
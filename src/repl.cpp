@@ -0,0 +1,65 @@
+#include "h/repl.h"
+#include "h/compiler.h"
+#include "h/consteval.h"
+#include "h/context.h"
+#include "h/error.h"
+#include "h/generic.h"
+#include "h/interpreter.h"
+#include "h/module.h"
+#include "h/utils.h"
+#include <iostream>
+#include <unistd.h>
+
+int runRepl() {
+    bool interactive = isatty(STDIN_FILENO);
+    Context ctx;
+    ctx.sourcePath = "<repl>";
+
+    ConstTable consts;
+    std::vector<std::string> pending;
+    BlockTracker tracker;
+    int lineno = 0;
+    int chunkStart = 1;
+    std::string line;
+    for (;;) {
+        if (interactive) std::cout << (pending.empty() ? "lo> " : "... ") << std::flush;
+        if (!std::getline(std::cin, line)) break;
+        ++lineno;
+        if (pending.empty()) chunkStart = lineno;
+        pending.push_back(line);
+        tracker.feed(trim(line));
+        if (!tracker.complete()) continue;
+
+        Module chunk;
+        chunk.path = ctx.sourcePath;
+        compileModule(chunk, pending, true, nullptr, chunkStart);
+        pending.clear();
+        if (chunk.diagnostics.empty()) instantiateGenerics(chunk, ctx.functions, ctx.variables, ctx.imports);
+        if (chunk.diagnostics.empty()) {
+            // a chunk that fails is dropped, and so are its constants
+            ConstTable known = consts;
+            foldConstants(chunk, known, &ctx.functions);
+            if (chunk.diagnostics.empty()) consts = std::move(known);
+        }
+        if (!chunk.diagnostics.empty()) {
+            for (const auto& diag : chunk.diagnostics) std::cerr << formatDiagnostic(diag, chunk.path) << std::endl;
+            continue;
+        }
+        for (auto& [name, func] : chunk.functions) {
+            // instances of a generic made before it was redefined
+            for (auto it = ctx.functions.begin(); it != ctx.functions.end();) {
+                if (func.instanceOf.empty() && it->second.instanceOf == name) it = ctx.functions.erase(it);
+                else ++it;
+            }
+            ctx.functions[name] = std::move(func);
+        }
+        try {
+            runCode(ctx, chunk.code);
+        } catch (const LoError& e) {
+            std::cerr << formatError(e) << std::endl;
+        }
+    }
+    if (!pending.empty()) std::cerr << "Unterminated block at end of input" << std::endl;
+    if (interactive) std::cout << std::endl;
+    return 0;
+}
@@ -0,0 +1,249 @@
+#include "h/specialize.h"
+#include "h/compiler.h"
+#include "h/evaluator.h"
+#include "h/stats.h"
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <set>
+
+namespace {
+
+// a combination of literals has to be this common to get a clone
+const size_t minSites = 2;
+
+bool isIntLiteral(const std::string& s) {
+    size_t start = !s.empty() && s[0] == '-' ? 1 : 0;
+    return s.size() > start && s.find_first_not_of("0123456789", start) == std::string::npos;
+}
+
+bool isDigits(const std::string& s) {
+    return !s.empty() && s.find_first_not_of("0123456789") == std::string::npos;
+}
+
+bool isWordChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Counts the occurrences of `name`; false when one of them is glued to
+// other word characters.
+bool wholeWords(const std::string& text, const std::string& name, size_t& count) {
+    count = 0;
+    for (size_t pos = text.find(name); pos != std::string::npos; pos = text.find(name, pos + 1)) {
+        size_t end = pos + name.size();
+        if ((pos > 0 && isWordChar(text[pos - 1])) || (end < text.size() && isWordChar(text[end]))) return false;
+        ++count;
+    }
+    return true;
+}
+
+std::string replaceWords(std::string text, const std::string& name, const std::string& value) {
+    for (size_t pos = text.find(name); pos != std::string::npos; pos = text.find(name, pos + value.size()))
+        text.replace(pos, name.size(), value);
+    return text;
+}
+
+// A funS loc's value, as executeFunction computes it.
+std::string locValue(Stmt st) {
+    std::string type = st.str(1), value = st.str(2);
+    if (type == "str" && value.size() >= 2 && value.front() == '"' && value.back() == '"')
+        return value.substr(1, value.size() - 2);
+    return type == "int" ? evalExpression(value) : value;
+}
+
+// What specialization may do with a function. Substituting a param first
+// gives what executeFunction's substitutions give in any order as long as
+// every local name in a return stands alone and no value that can be
+// substituted contains a local name; the clone's guard checks the
+// argument values, the rest is checked here.
+struct Analysis {
+    bool ok = false;
+    std::vector<std::string> locals;
+    std::vector<bool> bindable; // per param
+};
+
+Analysis analyze(const FunctionDef& func) {
+    Analysis a;
+    std::set<std::string> params, locNames;
+    for (const auto& param : func.params) {
+        if (!params.insert(param.second).second) return a; // given twice: the last binding wins
+        a.locals.push_back(param.second);
+    }
+    std::vector<std::string> returns;
+    for (Stmt st : func.code) {
+        if (st.kind() == StmtKind::Loc && locNames.insert(st.str(0)).second && !params.count(st.str(0)))
+            a.locals.push_back(st.str(0));
+        else if (st.kind() == StmtKind::Return)
+            returns.push_back(st.str(0));
+    }
+    if (returns.empty()) return a;
+    for (const auto& name : a.locals) {
+        if (isDigits(name)) return a;
+    }
+    for (Stmt st : func.code) {
+        if (st.kind() != StmtKind::Loc) continue;
+        std::string value;
+        try {
+            value = locValue(st);
+        } catch (...) {
+            return a;
+        }
+        for (const auto& name : a.locals) {
+            if (value.find(name) != std::string::npos) return a;
+        }
+    }
+    for (const auto& text : returns) {
+        for (const auto& name : a.locals) {
+            size_t count;
+            if (!wholeWords(text, name, count)) return a;
+        }
+    }
+    // only the first return runs
+    for (const auto& param : func.params) {
+        size_t count;
+        wholeWords(returns.front(), param.second, count);
+        a.bindable.push_back(count > 0 && !locNames.count(param.second));
+    }
+    a.ok = true;
+    return a;
+}
+
+struct Candidate {
+    std::string function;
+    std::vector<std::pair<size_t, std::string>> bound;
+    std::vector<uint32_t> sites;
+    uint64_t weight = 0; // sites, or calls the profile counted at them
+};
+
+std::string cloneName(const Module& mod, const Candidate& c) {
+    std::string name = c.function;
+    for (const auto& [param, literal] : c.bound) name += "__" + literal;
+    std::replace(name.begin(), name.end(), '-', 'm'); // names are \w+ for the IR's printer
+    while (mod.functions.count(name)) name += "_";
+    return name;
+}
+
+}
+
+void specializeCalls(Module& mod, size_t budget, const Profile* profile) {
+    // int literals stay literals unless runtime code can declare that name
+    std::set<std::string> declared;
+    for (Stmt st : mod.code) {
+        if ((st.kind() == StmtKind::Loc || st.kind() == StmtKind::Input || st.kind() == StmtKind::Catch) &&
+            st.argCount())
+            declared.insert(st.str(0));
+    }
+
+    std::map<std::string, Analysis> analyses;
+    std::map<std::string, Candidate> candidates;
+    for (Stmt st : mod.code) {
+        if (st.kind() != StmtKind::PrintCall) continue;
+        std::string name = st.str(0);
+        auto it = mod.functions.find(name);
+        if (it == mod.functions.end() || it->second.generic) continue;
+        const FunctionDef& func = it->second;
+        auto found = analyses.find(name);
+        if (found == analyses.end()) found = analyses.emplace(name, analyze(func)).first;
+        const Analysis& a = found->second;
+        std::vector<std::string> args = st.args(1);
+        if (!a.ok || args.size() < func.params.size()) continue;
+        // a param name as an argument is bound differently once params are gone
+        bool plain = std::none_of(args.begin(), args.end(), [&func](const std::string& arg) {
+            return std::any_of(func.params.begin(), func.params.end(),
+                               [&arg](const auto& p) { return p.second == arg; });
+        });
+        if (!plain) continue;
+        Candidate c{name, {}, {}, 0};
+        std::string key = name;
+        for (size_t j = 0; j < func.params.size(); ++j) {
+            if (!a.bindable[j] || !isIntLiteral(args[j]) || declared.count(args[j])) continue;
+            c.bound.emplace_back(j, args[j]);
+            key += '\0' + std::to_string(j) + '=' + args[j];
+        }
+        if (c.bound.empty()) continue;
+        auto& slot = candidates.try_emplace(key, std::move(c)).first->second;
+        slot.sites.push_back(st.index());
+    }
+
+    std::vector<Candidate*> order;
+    for (auto& [key, c] : candidates) {
+        if (c.sites.size() < minSites) continue;
+        c.weight = c.sites.size();
+        if (profile) {
+            c.weight = 0;
+            for (uint32_t site : c.sites) c.weight += profile->siteCalls(mod.code[site].line());
+            if (!c.weight) continue; // cold
+        }
+        order.push_back(&c);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const Candidate* a, const Candidate* b) { return a->weight > b->weight; });
+    size_t used = 0;
+    for (const Candidate* c : order) {
+        const FunctionDef& func = mod.functions.at(c->function);
+        if (used + func.code.size() > budget) continue;
+        used += func.code.size();
+
+        FunctionDef clone;
+        clone.returnType = func.returnType;
+        clone.body = func.body;
+        clone.line = func.line;
+        clone.generic = &func;
+        clone.genericName = sourceName(func, c->function);
+        clone.bound = c->bound;
+        clone.locals = analyses.at(c->function).locals;
+        std::vector<bool> isBound(func.params.size(), false);
+        for (const auto& [param, literal] : c->bound) isBound[param] = true;
+        for (size_t j = 0; j < func.params.size(); ++j) {
+            if (!isBound[j]) clone.params.push_back(func.params[j]);
+        }
+        for (Stmt st : func.code) {
+            if (st.kind() != StmtKind::Return) continue;
+            std::string text = st.str(0);
+            for (const auto& [param, literal] : c->bound) text = replaceWords(text, func.params[param].second, literal);
+            clone.body[st.line() - func.line - 1] = "return " + text + "!";
+        }
+        compileFunction(clone);
+
+        std::string name = cloneName(mod, *c);
+        std::string pattern;
+        for (size_t j = 0, k = 0; j < func.params.size(); ++j) {
+            bool bound = k < c->bound.size() && c->bound[k].first == j;
+            pattern += (j ? ", " : "") + (bound ? c->bound[k++].second : std::string("_"));
+        }
+        mod.functions.emplace(name, std::move(clone));
+        for (uint32_t site : c->sites) {
+            std::vector<std::string> args = mod.code[site].args(1);
+            std::vector<std::string> kept{name};
+            for (size_t j = 0; j < args.size(); ++j) {
+                if (j >= isBound.size() || !isBound[j]) kept.push_back(args[j]);
+            }
+            mod.code.replace(site, StmtKind::PrintCall, kept);
+        }
+        stats.specializations.push_back("f-" + c->function + "(" + pattern + ") as f-" + name + ": " +
+                                        std::to_string(c->sites.size()) + " call sites");
+        stats.specializedSites += c->sites.size();
+    }
+    stats.specializedStatements += used;
+    stats.specializeBudget = budget;
+}
+
+bool specializationHolds(const FunctionDef& clone, const std::vector<std::string>& values) {
+    for (const auto& value : values) {
+        for (const auto& name : clone.locals) {
+            if (value.find(name) != std::string::npos) return false;
+        }
+    }
+    return true;
+}
+
+std::vector<std::string> genericArgs(const FunctionDef& clone, const std::vector<std::string>& args) {
+    std::vector<std::string> out;
+    size_t next = 0, k = 0;
+    for (size_t j = 0; j < clone.generic->params.size(); ++j) {
+        if (k < clone.bound.size() && clone.bound[k].first == j) out.push_back(clone.bound[k++].second);
+        else if (next < args.size()) out.push_back(args[next++]);
+    }
+    out.insert(out.end(), args.begin() + std::min(next, args.size()), args.end());
+    return out;
+}
@@ -0,0 +1,110 @@
+#include "h/statement.h"
+#include "h/jumptable.h"
+#include "h/quicken.h"
+
+std::vector<std::string> Stmt::args(size_t from) const {
+    std::vector<std::string> out;
+    for (size_t i = from; i < argCount(); ++i) out.emplace_back(arg(i));
+    return out;
+}
+
+QuickSite& Stmt::quick() const {
+    auto& slots = owner->quickOf;
+    if (slots.size() < owner->size()) slots.resize(owner->size(), Code::none);
+    if (slots[at] == Code::none) {
+        slots[at] = static_cast<uint32_t>(owner->quickSites.size());
+        owner->quickSites.push_back(std::make_shared<QuickSite>());
+    }
+    return *owner->quickSites[slots[at]];
+}
+
+const QuickSite* Stmt::quickMade() const {
+    const auto& slots = owner->quickOf;
+    return at < slots.size() && slots[at] != Code::none ? owner->quickSites[slots[at]].get() : nullptr;
+}
+
+void Code::appendArg(std::string_view arg) {
+    size_t starts = argStart.capacity(), lengths = argLength.capacity(), bytes = text.capacity();
+    argStart.push_back(static_cast<uint32_t>(text.size()));
+    argLength.push_back(static_cast<uint32_t>(arg.size()));
+    text.append(arg.data(), arg.size());
+    note(argStart, starts);
+    note(argLength, lengths);
+    note(text, bytes);
+}
+
+void Code::appendArgs(std::initializer_list<std::string_view> args) {
+    for (std::string_view a : args) appendArg(a);
+}
+
+uint32_t Code::add(StmtKind kind, int line, std::initializer_list<std::string_view> args) {
+    uint32_t i = size();
+    size_t capacity = kinds.capacity();
+    kinds.push_back(kind);
+    lines.push_back(line);
+    nexts.push_back(0);
+    ends.push_back(0);
+    firstArg.push_back(static_cast<uint32_t>(argStart.size()));
+    argCounts.push_back(static_cast<uint32_t>(args.size()));
+    tableOf.push_back(none);
+    // the seven per-statement arrays always grow together
+    if (kinds.capacity() != capacity) allocs += 7;
+    appendArgs(args);
+    return i;
+}
+
+uint32_t Code::add(StmtKind kind, int line, const std::vector<std::string>& args) {
+    uint32_t i = add(kind, line, {});
+    argCounts[i] = static_cast<uint32_t>(args.size());
+    for (const auto& a : args) appendArg(a);
+    return i;
+}
+
+void Code::replace(uint32_t i, StmtKind kind, std::initializer_list<std::string_view> args) {
+    kinds[i] = kind;
+    firstArg[i] = static_cast<uint32_t>(argStart.size());
+    argCounts[i] = static_cast<uint32_t>(args.size());
+    appendArgs(args);
+}
+
+void Code::replace(uint32_t i, StmtKind kind, const std::vector<std::string>& args) {
+    replace(i, kind, {});
+    argCounts[i] = static_cast<uint32_t>(args.size());
+    for (const auto& a : args) appendArg(a);
+}
+
+void Code::setTable(uint32_t i, std::shared_ptr<const JumpTable> table) {
+    size_t capacity = tables.capacity();
+    tableOf[i] = static_cast<uint32_t>(tables.size());
+    tables.push_back(std::move(table));
+    note(tables, capacity);
+}
+
+void Code::reserve(size_t statements, size_t args, size_t textBytes) {
+    auto grow = [this](auto& v, size_t n) {
+        size_t capacity = v.capacity();
+        v.reserve(n);
+        note(v, capacity);
+    };
+    grow(kinds, statements);
+    grow(lines, statements);
+    grow(nexts, statements);
+    grow(ends, statements);
+    grow(firstArg, statements);
+    grow(argCounts, statements);
+    grow(tableOf, statements);
+    grow(argStart, args);
+    grow(argLength, args);
+    grow(text, textBytes);
+}
+
+void Code::clear() {
+    *this = Code();
+}
+
+size_t Code::bytes() const {
+    size_t perStmt = sizeof(StmtKind) + sizeof(int32_t) + 5 * sizeof(uint32_t);
+    return kinds.capacity() * perStmt + argStart.capacity() * 2 * sizeof(uint32_t) + text.capacity() +
+           tables.capacity() * sizeof(tables[0]) + quickOf.capacity() * sizeof(uint32_t) +
+           quickSites.capacity() * sizeof(quickSites[0]);
+}
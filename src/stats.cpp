@@ -0,0 +1,62 @@
+#include "h/stats.h"
+#include "h/alloc.h"
+#include "h/statement.h"
+#include <sys/resource.h>
+
+Stats stats;
+
+void countCode(const Code& code) {
+    stats.codeStatements += code.size();
+    stats.codeBytes += code.bytes();
+    stats.codeAllocations += code.allocations();
+}
+
+void printStats(std::ostream& out) {
+    size_t quickened = stats.intCompares + stats.strCompares + stats.assigns + stats.loads + stats.intReturns +
+                       stats.constLocs;
+    out << "compile: " << stats.compileMs << " ms\n"
+        << "run: " << stats.runMs << " ms\n"
+        << "quickened sites: " << quickened << "\n"
+        << "  int compare: " << stats.intCompares << "\n"
+        << "  str compare: " << stats.strCompares << "\n"
+        << "  assign: " << stats.assigns << "\n"
+        << "  variable load: " << stats.loads << "\n"
+        << "  int return: " << stats.intReturns << "\n"
+        << "  constant loc: " << stats.constLocs << "\n"
+        << "generic sites: " << stats.genericSites << "\n"
+        << "guard failures: " << stats.guardFailures << "\n"
+        << "code: " << stats.codeStatements << " statements, " << stats.codeBytes << " bytes, "
+        << stats.codeAllocations << " allocations\n";
+    if (stats.irInstructions)
+        out << "ir: " << stats.irInstructions << " instructions, " << stats.irBlocks << " blocks, "
+            << stats.irFoldedValues << " folded values, " << stats.irFoldedBranches << " folded branches, "
+            << stats.irDeadStores << " dead stores\n";
+    if (stats.instances) out << "funS instances: " << stats.instances << "\n";
+    if (stats.profiled)
+        out << "profile: " << stats.profileReorderedChains << " chains reordered, " << stats.profileGenericReturns
+            << " returns started generic\n";
+    if (stats.incrementalUnits)
+        out << "incremental: " << stats.incrementalReplayed << " of " << stats.incrementalUnits
+            << " units replayed\n";
+    if (stats.memoHits || stats.memoMisses)
+        out << "memo: " << stats.memoHits << " hits, " << stats.memoMisses << " misses, " << stats.memoStored
+            << " stored\n";
+    if (stats.parallelThreads)
+        out << "parallel: " << stats.parallelCalls << " of " << stats.parallelUnits << " units on "
+            << stats.parallelThreads << " threads, parallelism " << stats.parallelism << "\n";
+    if (stats.outputWrites)
+        out << "output: " << stats.outputWrites << " buffers written, " << stats.outputStalls << " prints waited\n";
+    if (stats.readAheadChunks)
+        out << "read-ahead: " << stats.readAheadChunks << " chunks, " << stats.readAheadUring << " with io_uring\n";
+    if (stats.specializeBudget) {
+        out << "specializations: " << stats.specializations.size() << " (" << stats.specializedSites
+            << " call sites, " << stats.specializedStatements << " of " << stats.specializeBudget
+            << " statements)\n";
+        for (const auto& line : stats.specializations) out << "  " << line << "\n";
+    }
+    if (loAllocatorActive())
+        out << "allocator: lo, " << loAllocatorSpans() << " spans (" << loAllocatorSpans() * 64 / 1024
+            << " MB), " << loAllocatorTransfers() << " batch transfers\n";
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) out << "peak memory: " << usage.ru_maxrss / 1024 << " MB\n";
+}
@@ -0,0 +1,12 @@
+#include "h/text.h"
+
+bool textsShared = false;
+
+const std::string& Text::none() {
+    static const std::string none;
+    return none;
+}
+
+void shareTextAcrossThreads() {
+    textsShared = true;
+}
@@ -1,4 +1,6 @@
 #include "h/utils.h"
+#include <climits>
+#include <cstdlib>
 
 std::string trim(const std::string& str) {
     size_t first = str.find_first_not_of(" \t");
@@ -14,4 +16,13 @@ bool isStringLiteral(const std::string& value) {
 std::string stripQuotes(const std::string& s) {
     if (isStringLiteral(s)) return s.substr(1, s.size() - 2);
     return s;
-}
\ No newline at end of file
+}
+bool startsWith(const std::string& s, const std::string& prefix) {
+    return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+}
+
+std::string canonicalPath(const std::string& path) {
+    char buf[PATH_MAX];
+    if (realpath(path.c_str(), buf)) return buf;
+    return path;
+}
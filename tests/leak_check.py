@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+"""Runs the bench/gen_values.py workload under LeakSanitizer, serially and
+with --auto-parallel (where value counts are atomic), and fails on any
+leak report. Needs a build configured with -DLOMAKE_SANITIZE=ON.
+
+    python3 tests/leak_check.py ./build/lomake bench/gen_values.py
+"""
+import os
+import subprocess
+import sys
+import tempfile
+
+
+def main():
+    lomake, generator = sys.argv[1], sys.argv[2]
+    env = dict(os.environ, ASAN_OPTIONS="detect_leaks=1")
+    failed = 0
+    with tempfile.TemporaryDirectory() as out:
+        subprocess.run([sys.executable, generator, out, "--lines", "2000", "--width", "400"], check=True)
+        program = os.path.join(out, "values.lo")
+        for flags in ([], ["--engine=closure"], ["--auto-parallel", "--jobs", "4", "--stats"]):
+            run = subprocess.run([lomake] + flags + [program], capture_output=True, text=True, env=env,
+                                 timeout=600)
+            problems = []
+            if run.returncode != 0:
+                problems.append("exit code %d" % run.returncode)
+            if "LeakSanitizer" in run.stderr:
+                problems.append(run.stderr)
+            # the parallel run must actually share values across threads
+            if "--auto-parallel" in flags and "parallel: 0 " in run.stderr:
+                problems.append("no call ran on the pool")
+            if problems:
+                failed += 1
+                print("FAIL %s\n%s" % (" ".join(flags) or "serial", "\n".join(problems)))
+    print("%d failed" % failed)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+"""Runs every .lo program in a directory with and without --optimize and
+checks that stdout, stderr and the exit code agree. Each program's IR is
+also dumped, plain and optimized, which runs it through the verifier.
+NAME.in, when present, is fed to stdin.
+
+    python3 tests/optimize_diff.py ./build/lomake tests/programs
+"""
+import os
+import subprocess
+import sys
+
+
+def run(lomake, flags, path, stdin):
+    done = subprocess.run([lomake] + flags + [path], input=stdin, capture_output=True, text=True, timeout=60)
+    return done.stdout, done.stderr, done.returncode
+
+
+def main():
+    lomake, root = sys.argv[1], sys.argv[2]
+    failed = 0
+    for name in sorted(os.listdir(root)):
+        if not name.endswith(".lo"):
+            continue
+        path = os.path.join(root, name)
+        stdin = ""
+        if os.path.exists(path[:-3] + ".in"):
+            with open(path[:-3] + ".in") as f:
+                stdin = f.read()
+        problems = []
+        plain = run(lomake, [], path, stdin)
+        optimized = run(lomake, ["--optimize"], path, stdin)
+        for what, a, b in zip(("stdout", "stderr", "exit code"), plain, optimized):
+            if a != b:
+                problems.append("%s differs under --optimize:\n%s\n---\n%s" % (what, a, b))
+        for flags in (["--dump-ir"], ["--optimize", "--dump-ir"]):
+            err = run(lomake, flags, path, "")[1]
+            if "Invalid IR" in err:
+                problems.append(" ".join(flags) + ": " + err)
+        if problems:
+            failed += 1
+            print("FAIL %s\n%s" % (name, "\n".join(problems)))
+    print("%d failed" % failed)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+"""Runs every tests/programs/NAME.lo and compares what it prints with
+NAME.out (stdout) and NAME.err (stderr, absent when nothing is expected).
+A program with a NAME.err must exit with 1, any other with 0. NAME.in,
+when present, is fed to stdin.
+
+    python3 tests/run_programs.py ./build/lomake tests/programs
+"""
+import os
+import subprocess
+import sys
+
+
+def read(path):
+    if not os.path.exists(path):
+        return ""
+    with open(path) as f:
+        return f.read()
+
+
+def main():
+    lomake, root = sys.argv[1], sys.argv[2]
+    failed = 0
+    for name in sorted(os.listdir(root)):
+        if not name.endswith(".lo"):
+            continue
+        base = os.path.join(root, name[:-3])
+        run = subprocess.run([lomake, base + ".lo"], input=read(base + ".in"), capture_output=True,
+                             text=True, timeout=60)
+        want_err = read(base + ".err")
+        want_code = 1 if os.path.exists(base + ".err") else 0
+        problems = []
+        if run.stdout != read(base + ".out"):
+            problems.append("stdout:\n" + run.stdout)
+        if run.stderr != want_err:
+            problems.append("stderr:\n" + run.stderr)
+        if run.returncode != want_code:
+            problems.append("exit code %d, expected %d" % (run.returncode, want_code))
+        if problems:
+            failed += 1
+            print("FAIL %s\n%s" % (name, "\n".join(problems)))
+    print("%d failed" % failed)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())